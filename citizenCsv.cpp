@@ -0,0 +1,266 @@
+#include "citizenCsv.h"
+#include <new>			// std::bad_alloc
+#include <cstring>		// memchr, memmove
+#include <thread>		// std::thread
+#include <system_error>	// std::system_error
+#ifdef _WIN32
+#include <stdio.h>		// fopen, fread
+#else
+#include <fcntl.h>		// open
+#include <unistd.h>		// close
+#include <sys/mman.h>	// mmap
+#include <sys/stat.h>	// fstat
+#endif
+
+CitizenCsv::CitizenCsv(const char* path, int threads) :
+		_rows(NULL), _count(0) {
+#ifdef _WIN32
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		throw IOError();
+	}
+	long length = -1;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		length = ftell(file);
+	}
+	if (length < 0 || fseek(file, 0, SEEK_SET) != 0) {
+		fclose(file);
+		throw IOError();
+	}
+	char* data = NULL;
+	try {
+		data = new char[length > 0 ? length : 1];
+	} catch (std::bad_alloc& e) {
+		fclose(file);
+		throw;
+	}
+	if (fread(data, 1, length, file) != (size_t) length) {
+		delete[] data;
+		fclose(file);
+		throw IOError();
+	}
+	fclose(file);
+	try {
+		parse(data, length, threads);
+	} catch (...) {
+		delete[] data;
+		throw;
+	}
+	delete[] data;
+#else
+	int file = open(path, O_RDONLY);
+	if (file == -1) {
+		throw IOError();
+	}
+	struct stat status;
+	if (fstat(file, &status) == -1) {
+		close(file);
+		throw IOError();
+	}
+	if (status.st_size == 0) { // which cannot be mapped, and has no rows
+		close(file);
+		_rows = new Row[1];
+		return;
+	}
+	void* data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED) {
+		throw IOError();
+	}
+	try {
+		parse((const char*) data, status.st_size, threads);
+	} catch (...) {
+		munmap(data, status.st_size);
+		throw;
+	}
+	munmap(data, status.st_size);
+#endif
+}
+
+CitizenCsv::~CitizenCsv() {
+	delete[] _rows;
+}
+
+long long CitizenCsv::count() const {
+	return _count;
+}
+
+const CitizenCsv::Row* CitizenCsv::rows() const {
+	return _rows;
+}
+
+void CitizenCsv::parse(const char* data, size_t length, int threads) {
+	if (threads > (int) (length / MIN_CHUNK)) {
+		threads = length / MIN_CHUNK;
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	Chunk* chunks = new Chunk[threads];
+	// every chunk but the first begins after the end of a line
+	const char* end = data + length;
+	for (int c = 0; c < threads; ++c) {
+		const char* begin = data + length * c / threads;
+		if (c > 0) {
+			const char* newline = (const char*) memchr(begin - 1, '\n',
+					end - (begin - 1));
+			begin = newline ? newline + 1 : end;
+			if (begin < chunks[c - 1]._begin) {
+				begin = chunks[c - 1]._begin;
+			}
+			chunks[c - 1]._end = begin;
+		}
+		chunks[c]._begin = begin;
+		chunks[c]._header = c == 0;
+		chunks[c]._bad = false;
+	}
+	chunks[threads - 1]._end = end;
+	forEachChunk(countLines, chunks, threads);
+	long long lines = 0;
+	for (int c = 0; c < threads; ++c) {
+		lines += chunks[c]._lines;
+	}
+	try {
+		_rows = new Row[lines > 0 ? lines : 1];
+	} catch (std::bad_alloc& e) {
+		delete[] chunks;
+		throw;
+	}
+	Row* rows = _rows;
+	for (int c = 0; c < threads; ++c) {
+		chunks[c]._rows = rows;
+		rows += chunks[c]._lines;
+	}
+	forEachChunk(parseRows, chunks, threads);
+	// the empty lines and the header leave gaps after the rows of a chunk
+	for (int c = 0; c < threads; ++c) {
+		if (chunks[c]._bad) {
+			delete[] chunks;
+			delete[] _rows;
+			_rows = NULL;
+			throw BadCsv();
+		}
+		if (chunks[c]._rows != _rows + _count) {
+			memmove(_rows + _count, chunks[c]._rows,
+					chunks[c]._count * sizeof(Row));
+		}
+		_count += chunks[c]._count;
+	}
+	delete[] chunks;
+}
+
+void CitizenCsv::countLines(Chunk* chunk) {
+	long long lines = 0;
+	const char* p = chunk->_begin;
+	while (p < chunk->_end) {
+		const char* newline = (const char*) memchr(p, '\n', chunk->_end - p);
+		++lines;
+		if (!newline) {
+			break;
+		}
+		p = newline + 1;
+	}
+	chunk->_lines = lines;
+}
+
+// helping functions of parseRows to skip the spaces at @p, and to read the
+// number at @p, which must be within [-limit-1, limit]. They return false
+// if there is no such number.
+static const char* skipSpaces(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		++p;
+	}
+	return p;
+}
+
+static bool readNumber(const char*& p, const char* end,
+		unsigned long long limit, long long* number) {
+	bool negative = p < end && *p == '-';
+	if (negative) {
+		++p;
+	}
+	if (p == end || *p < '0' || *p > '9') {
+		return false;
+	}
+	unsigned long long value = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		unsigned long long digit = *p - '0';
+		if (value > (limit + negative - digit) / 10) {
+			return false;
+		}
+		value = value * 10 + digit;
+	}
+	*number = negative ? (long long) (0 - value) : (long long) value;
+	return true;
+}
+
+void CitizenCsv::parseRows(Chunk* chunk) {
+	long long count = 0;
+	const char* p = chunk->_begin;
+	const char* end = chunk->_end;
+	bool first = chunk->_header;
+	while (p < end) {
+		const char* newline = (const char*) memchr(p, '\n', end - p);
+		const char* lineEnd = newline ? newline : end;
+		if (lineEnd > p && lineEnd[-1] == '\r') {
+			--lineEnd;
+		}
+		p = skipSpaces(p, lineEnd);
+		if (p < lineEnd) {
+			long long citizen, city;
+			bool row = readNumber(p, lineEnd, 0x7fffffffffffffffULL, &citizen);
+			if (row) {
+				p = skipSpaces(p, lineEnd);
+				row = p < lineEnd && *p == ',';
+			}
+			if (row) {
+				p = skipSpaces(p + 1, lineEnd);
+				row = readNumber(p, lineEnd, 0x7fffffffULL, &city);
+			}
+			if (row) {
+				row = skipSpaces(p, lineEnd) == lineEnd;
+			}
+			if (row) {
+				chunk->_rows[count]._citizen = citizen;
+				chunk->_rows[count]._city = (int) city;
+				++count;
+			} else if (!first) {
+				chunk->_bad = true;
+				break;
+			}
+			first = false;
+		}
+		p = newline ? newline + 1 : end;
+	}
+	chunk->_count = count;
+}
+
+void CitizenCsv::forEachChunk(void (*work)(Chunk*), Chunk* chunks,
+		int count) {
+	std::thread* workers;
+	try {
+		workers = new std::thread[count > 1 ? count - 1 : 1];
+	} catch (std::bad_alloc& e) { // all the chunks on the calling thread
+		for (int c = 0; c < count; ++c) {
+			work(chunks + c);
+		}
+		return;
+	}
+	// the last chunk is worked on by the calling thread
+	for (int c = 0; c < count - 1; ++c) {
+		try {
+			workers[c] = std::thread(work, chunks + c);
+		} catch (std::system_error& e) {
+			work(chunks + c);
+		} catch (std::bad_alloc& e) {
+			work(chunks + c);
+		}
+	}
+	work(chunks + count - 1);
+	for (int c = 0; c < count - 1; ++c) {
+		if (workers[c].joinable()) {
+			workers[c].join();
+		}
+	}
+	delete[] workers;
+}
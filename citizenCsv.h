@@ -0,0 +1,87 @@
+#ifndef CITIZENCSV_H_
+#define CITIZENCSV_H_
+
+#include <stddef.h>		// size_t
+#include <exception>	// std::exception
+
+/*
+ * Class Citizen CSV
+ * A file of citizens to import (see ImportCitizens in library2.h), with a
+ * row of "citizenID,city" on every line. Spaces around the numbers, empty
+ * lines, a '\r' before the '\n' and a header (a first line which is not a
+ * row) are allowed.
+ *
+ * The file is mapped into memory (or read where mmap is missing) and split
+ * into a chunk per thread, cut at the ends of lines. Every thread counts the
+ * lines of its chunk, which gives the place of the chunk's rows in the
+ * array of all the rows, and then parses the chunk into its place, so the
+ * rows are kept in the order of the file. The file is unmapped once it is
+ * parsed.
+ */
+class CitizenCsv {
+public:
+	/* Exceptions thrown by the CSV */
+	class IOError: public std::exception {
+	};
+	class BadCsv: public std::exception {
+	};
+
+	struct Row {
+		long long _citizen;
+		int _city;
+	};
+
+	/* Parses the CSV at @path with up to @threads threads.
+	 * @throw IOError
+	 * @throw BadCsv if a line is not a row, or a number does not fit.
+	 * @throw std::bad_alloc
+	 * Time complexity : O(L/t) whereas L is the length of the file and t
+	 * is the number of threads.
+	 */
+	CitizenCsv(const char* path, int threads);
+	/* Destructor
+	 * Time complexity : O(1)
+	 */
+	~CitizenCsv();
+	/* Returns the number of rows, and the rows in the order of the file.
+	 * Time complexity : O(1)
+	 */
+	long long count() const;
+	const Row* rows() const;
+
+private:
+	/* A part of the file, which is parsed by one thread into @_rows.
+	 * @_lines is the number of lines of the chunk, which bounds its rows,
+	 * and @_count is the number of its rows.
+	 */
+	struct Chunk {
+		const char* _begin;
+		const char* _end;
+		Row* _rows;
+		long long _lines;
+		long long _count;
+		bool _header;	// whether the chunk may begin with a header
+		bool _bad;
+	};
+
+	static const size_t MIN_CHUNK = 1 << 20;
+
+	Row* _rows;
+	long long _count;
+
+	CitizenCsv(const CitizenCsv& csv);
+	CitizenCsv& operator=(const CitizenCsv& csv);
+	// helping function to parse the @length bytes of @data with up to
+	// @threads threads. O(length/t)
+	void parse(const char* data, size_t length, int threads);
+	// helping functions of the threads, to count the lines of @chunk and to
+	// parse its rows. O(chunk length)
+	static void countLines(Chunk* chunk);
+	static void parseRows(Chunk* chunk);
+	// helping function to call @work on the @count chunks at once, each on
+	// a thread of its own, or on the calling thread if a thread cannot be
+	// started, so it throws nothing. O(1) besides the work
+	static void forEachChunk(void (*work)(Chunk*), Chunk* chunks, int count);
+};
+
+#endif /* CITIZENCSV_H_ */
@@ -0,0 +1,528 @@
+#include "cityRanking.h"
+#include <new> // std::bad_alloc
+#include <thread> // std::thread
+#include <system_error> // std::system_error
+#include <utility> // std::swap
+
+void CityRanking::parallelRange(int from, int to, bool ascending,
+		int results[], int threads) const {
+	int count = to - from + 1;
+	if (threads > count / PARALLEL_SLICE) {
+		threads = count / PARALLEL_SLICE;
+	}
+	if (threads < 2) {
+		range(from, to, ascending, results);
+		return;
+	}
+	std::thread* workers;
+	try {
+		workers = new std::thread[threads - 1];
+	} catch (std::bad_alloc& e) {
+		range(from, to, ascending, results);
+		return;
+	}
+	// the slice t is the ranks from + count*t/threads onwards, and the last
+	// slice is written by the calling thread once the others are started
+	for (int t = 0; t < threads; ++t) {
+		int first = from + (int) ((long long) count * t / threads);
+		int last = from + (int) ((long long) count * (t + 1) / threads) - 1;
+		int* slice = results + (first - from);
+		if (t < threads - 1) {
+			try {
+				workers[t] = std::thread(&CityRanking::range, this, first,
+						last, ascending, slice);
+				continue;
+			} catch (std::system_error& e) {
+			} catch (std::bad_alloc& e) {
+			}
+		}
+		range(first, last, ascending, slice);
+	}
+	for (int t = 0; t < threads - 1; ++t) {
+		if (workers[t].joinable()) {
+			workers[t].join();
+		}
+	}
+	delete[] workers;
+}
+
+RankedCity::RankedCity() :
+		_id(-1), _size(0) {
+}
+
+RankedCity::RankedCity(int id, int size) :
+		_id(id), _size(size) {
+}
+
+bool operator<(const RankedCity& city1, const RankedCity& city2) {
+	if (city1._size != city2._size) {
+		return city1._size < city2._size;
+	}
+	return city1._id < city2._id;
+}
+
+bool operator>(const RankedCity& city1, const RankedCity& city2) {
+	return city2 < city1;
+}
+
+bool operator==(const RankedCity& city1, const RankedCity& city2) {
+	return city1._id == city2._id;
+}
+
+bool operator!=(const RankedCity& city1, const RankedCity& city2) {
+	return !(city1 == city2);
+}
+
+class FillSortedRanking {
+	const int* cities;
+	const int* sizes;
+	int index;
+public:
+	FillSortedRanking(const int cities[], const int sizes[]) :
+			cities(cities), sizes(sizes), index(0) {
+	}
+	void operator()(RankedCity& city) {
+		city = RankedCity(cities[index], sizes[cities[index]]);
+		++index;
+	}
+};
+
+class RankedCitiesToArray {
+	int* results;
+	int index;
+public:
+	RankedCitiesToArray(int results[]) :
+			results(results), index(0) {
+	}
+	void operator()(const RankedCity& city) {
+		results[index++] = city._id;
+	}
+};
+
+TreeRanking::TreeRanking(int n) :
+		_empty(n, true) {
+}
+
+int TreeRanking::idRange(int n, const int cities[]) {
+	int range = n;
+	for (int i = 0; i < n; ++i) {
+		range = cities[i] >= range ? cities[i] + 1 : range;
+	}
+	return range;
+}
+
+int TreeRanking::countSized(int n, const int cities[], const int sizes[]) {
+	int count = 0;
+	for (int i = 0; i < n; ++i) {
+		count += sizes[cities[i]] != 0;
+	}
+	return count;
+}
+
+TreeRanking::TreeRanking(int n, const int cities[], const int sizes[]) :
+		_empty(idRange(n, cities), false), _tree(countSized(n, cities, sizes)) {
+	int empty = n - _tree.size(); // which rank first
+	for (int i = 0; i < empty; ++i) {
+		_empty.insert(cities[i]);
+	}
+	FillSortedRanking fill(cities + empty, sizes);
+	_tree.inOrder(fill);
+}
+
+void TreeRanking::insert(int city, int size) {
+	if (city >= _empty.range()) {
+		int range = _empty.range();
+		_empty.resize(city >= 2 * range ? city + 1 : 2 * range);
+	}
+	if (size == 0) {
+		_empty.insert(city);
+	} else {
+		_tree.insert(RankedCity(city, size));
+	}
+}
+
+void TreeRanking::remove(int city, int size) {
+	if (size == 0) {
+		_empty.remove(city);
+	} else {
+		_tree.remove(RankedCity(city, size));
+	}
+}
+
+void TreeRanking::resize(int city, int oldSize, int newSize) {
+	replace(city, oldSize, city, newSize);
+}
+
+void TreeRanking::resize(int city1, int oldSize1, int newSize1, int city2,
+		int oldSize2, int newSize2) {
+	// only a city of size 0 that grows allocates (see replace), and it is
+	// undone without allocating, so such a city is resized first
+	if (oldSize1 != 0 || newSize1 == 0) {
+		std::swap(city1, city2);
+		std::swap(oldSize1, oldSize2);
+		std::swap(newSize1, newSize2);
+	}
+	resize(city1, oldSize1, newSize1);
+	try {
+		resize(city2, oldSize2, newSize2);
+	} catch (std::bad_alloc& e) {
+		resize(city1, newSize1, oldSize1);
+		throw;
+	}
+}
+
+void TreeRanking::replace(int oldCity, int oldSize, int city, int size) {
+	if (oldCity == city && oldSize == size) {
+		return;
+	}
+	if (oldSize != 0 && size != 0) {
+		_tree.replace(RankedCity(oldCity, oldSize), RankedCity(city, size));
+		return;
+	}
+	insert(city, size); // first, so a failed allocation changes nothing
+	remove(oldCity, oldSize);
+}
+
+void TreeRanking::reserve(int n) {
+	_tree.reserve(n); // the cities of size 0 are in the range of _empty
+}
+
+int TreeRanking::select(int k) const {
+	if (k < _empty.size()) {
+		return _empty.select(k);
+	}
+	return _tree.select(k - _empty.size() + 1)._id;
+}
+
+void TreeRanking::range(int from, int to, bool ascending,
+		int results[]) const {
+	// the ranks of the range from the smallest, of which the first @empty
+	// ranks are in the bitmap and the others in the tree
+	int low = ascending ? from : size() - 1 - to;
+	int high = ascending ? to : size() - 1 - from;
+	int empty = _empty.size();
+	if (high >= empty) {
+		int start = low > empty ? low : empty;
+		RankedCitiesToArray convert(results + (ascending ? start - low : 0));
+		if (ascending) {
+			_tree.inOrder(start - empty + 1, high - empty + 1, convert);
+		} else {
+			_tree.reverseInOrder(start - empty + 1, high - empty + 1, convert);
+		}
+	}
+	if (low < empty) {
+		int end = high < empty ? high : empty - 1;
+		int id = _empty.select(low);
+		for (int rank = low; rank <= end; ++rank) {
+			results[ascending ? rank - low : high - rank] = id;
+			id = _empty.next(id + 1);
+		}
+	}
+}
+
+int TreeRanking::size() const {
+	return _empty.size() + _tree.size();
+}
+
+size_t TreeRanking::memory() const {
+	return _empty.memory() + _tree.memory();
+}
+
+void TreeRanking::setStats(ContainerStats* stats) {
+	_tree.setStats(stats);
+}
+
+class IdsToArray {
+	int* results;
+	int index;
+public:
+	IdsToArray(int results[]) :
+			results(results), index(0) {
+	}
+	void operator()(int id) {
+		results[index++] = id;
+	}
+};
+
+BucketRanking::BucketRanking(int n) :
+		_size(n), _range(n), _counts(1, n), _dense(NULL), _sparse(NULL), _capacity(
+				1), _stats(&ContainerStats::global()) {
+	_dense = new RankedBitSet*[_capacity];
+	try {
+		_sparse = new Tree<int>*[_capacity];
+		_dense[0] = new RankedBitSet(n, true);
+	} catch (std::bad_alloc& e) {
+		delete[] _sparse;
+		delete[] _dense;
+		throw;
+	}
+	_sparse[0] = NULL;
+}
+
+BucketRanking::BucketRanking(int n, const int cities[], const int sizes[]) :
+		_size(n), _range(n), _counts(1, 0), _dense(NULL), _sparse(NULL), _capacity(
+				1), _stats(&ContainerStats::global()) {
+	_dense = new RankedBitSet*[_capacity];
+	try {
+		_sparse = new Tree<int>*[_capacity];
+		_dense[0] = new RankedBitSet(n, false);
+	} catch (std::bad_alloc& e) {
+		delete[] _sparse;
+		delete[] _dense;
+		throw;
+	}
+	_sparse[0] = NULL;
+	try {
+		for (int i = 0; i < n; ++i) {
+			add(cities[i], sizes[cities[i]]);
+		}
+	} catch (std::bad_alloc& e) {
+		for (int i = 0; i < _capacity; ++i) {
+			delete _dense[i];
+			delete _sparse[i];
+		}
+		delete[] _dense;
+		delete[] _sparse;
+		throw;
+	}
+}
+
+BucketRanking::~BucketRanking() {
+	for (int i = 0; i < _capacity; ++i) {
+		delete _dense[i];
+		delete _sparse[i];
+	}
+	delete[] _dense;
+	delete[] _sparse;
+}
+
+void BucketRanking::reserve(int size) {
+	if (size < _capacity) {
+		return;
+	}
+	int capacity = _capacity;
+	while (capacity <= size) {
+		capacity *= 2;
+	}
+	RankedBitSet** dense = new RankedBitSet*[capacity];
+	Tree<int>** sparse = NULL;
+	try {
+		sparse = new Tree<int>*[capacity];
+		_counts.resize(capacity);
+	} catch (std::bad_alloc& e) {
+		delete[] sparse;
+		delete[] dense;
+		throw;
+	}
+	for (int i = 0; i < capacity; ++i) {
+		dense[i] = i < _capacity ? _dense[i] : NULL;
+		sparse[i] = i < _capacity ? _sparse[i] : NULL;
+	}
+	delete[] _dense;
+	delete[] _sparse;
+	_dense = dense;
+	_sparse = sparse;
+	_capacity = capacity;
+}
+
+class InsertToBitSet {
+	RankedBitSet& set;
+public:
+	InsertToBitSet(RankedBitSet& set) :
+			set(set) {
+	}
+	void operator()(int id) {
+		set.insert(id);
+	}
+};
+
+void BucketRanking::makeDense(int size) {
+	RankedBitSet* dense = new RankedBitSet(_range, false);
+	try {
+		InsertToBitSet insert(*dense);
+		_sparse[size]->inOrder(insert);
+	} catch (std::bad_alloc& e) {
+		delete dense;
+		throw;
+	}
+	delete _sparse[size];
+	_sparse[size] = NULL;
+	_dense[size] = dense;
+}
+
+void BucketRanking::makeSparse(int size) {
+	Tree<int>* sparse = new Tree<int>();
+	sparse->setStats(_stats);
+	try {
+		for (int id = _dense[size]->next(0); id != -1;
+				id = _dense[size]->next(id + 1)) {
+			sparse->insert(id);
+		}
+	} catch (std::bad_alloc& e) {
+		delete sparse;
+		throw;
+	}
+	delete _dense[size];
+	_dense[size] = NULL;
+	_sparse[size] = sparse;
+}
+
+void BucketRanking::add(int city, int size) {
+	reserve(size);
+	if (_dense[size]) {
+		_dense[size]->insert(city);
+	} else {
+		if (!_sparse[size]) {
+			_sparse[size] = new Tree<int>();
+			_sparse[size]->setStats(_stats);
+		}
+		_sparse[size]->insert(city);
+	}
+	_counts.add(size, 1);
+	if (_sparse[size] && (long long) _sparse[size]->size() * 64 >= _range) {
+		try {
+			makeDense(size);
+		} catch (std::bad_alloc& e) {
+			// the form of a bucket is only a matter of speed, so a failed
+			// allocation keeps the bucket as it is
+		}
+	}
+}
+
+void BucketRanking::remove(int city, int size) {
+	if (_dense[size]) {
+		_dense[size]->remove(city);
+	} else {
+		_sparse[size]->remove(city);
+	}
+	_counts.add(size, -1);
+	if (size > 0 && _dense[size]
+			&& (long long) _dense[size]->size() * 128 < _range) {
+		try {
+			makeSparse(size);
+		} catch (std::bad_alloc& e) {
+			// as in add
+		}
+	}
+}
+
+void BucketRanking::insert(int city, int size) {
+	if (city >= _range) {
+		int range = city >= 2 * _range ? city + 1 : 2 * _range;
+		for (int i = 0; i < _capacity; ++i) {
+			if (_dense[i]) {
+				_dense[i]->resize(range);
+			}
+		}
+		_range = range;
+	}
+	add(city, size);
+	++_size;
+}
+
+void BucketRanking::resize(int city, int oldSize, int newSize) {
+	if (oldSize == newSize) {
+		return;
+	}
+	add(city, newSize); // first, so a failed allocation changes nothing
+	remove(city, oldSize);
+}
+
+void BucketRanking::resize(int city1, int oldSize1, int newSize1,
+		int city2, int oldSize2, int newSize2) {
+	if (oldSize1 == newSize1) {
+		resize(city2, oldSize2, newSize2);
+		return;
+	}
+	if (oldSize2 == newSize2) {
+		resize(city1, oldSize1, newSize1);
+		return;
+	}
+	// both cities are added to their new buckets before either is removed,
+	// since only adding allocates
+	add(city1, newSize1);
+	try {
+		add(city2, newSize2);
+	} catch (std::bad_alloc& e) {
+		remove(city1, newSize1);
+		throw;
+	}
+	remove(city1, oldSize1);
+	remove(city2, oldSize2);
+}
+
+int BucketRanking::findBucket(int& k) const {
+	int size = _counts.find(k);
+	k -= _counts.prefix(size - 1);
+	return size;
+}
+
+int BucketRanking::bucketSize(int size) const {
+	return _counts.prefix(size) - _counts.prefix(size - 1);
+}
+
+int BucketRanking::select(int k) const {
+	int size = findBucket(k);
+	if (_dense[size]) {
+		return _dense[size]->select(k);
+	}
+	return _sparse[size]->select(k + 1);
+}
+
+void BucketRanking::range(int from, int to, bool ascending,
+		int results[]) const {
+	// every step writes the part of the range that is in one bucket
+	for (int rank = from; rank <= to;) {
+		int k = ascending ? rank : _size - 1 - rank;
+		int size = findBucket(k);
+		int count = ascending ? bucketSize(size) - k : k + 1;
+		if (count > to - rank + 1) {
+			count = to - rank + 1;
+		}
+		int* bucketResults = results + (rank - from);
+		if (_dense[size]) {
+			int id = _dense[size]->select(k);
+			for (int i = 0; i < count; ++i) {
+				bucketResults[i] = id;
+				id = ascending ?
+						_dense[size]->next(id + 1) :
+						_dense[size]->previous(id - 1);
+			}
+		} else {
+			IdsToArray convert(bucketResults);
+			if (ascending) {
+				_sparse[size]->inOrder(k + 1, k + count, convert);
+			} else {
+				_sparse[size]->reverseInOrder(k - count + 2, k + 1, convert);
+			}
+		}
+		rank += count;
+	}
+}
+
+int BucketRanking::size() const {
+	return _size;
+}
+
+size_t BucketRanking::memory() const {
+	size_t memory = _counts.memory()
+			+ _capacity * (sizeof(RankedBitSet*) + sizeof(Tree<int>*));
+	for (int i = 0; i < _capacity; ++i) {
+		if (_dense[i]) {
+			memory += sizeof(RankedBitSet) + _dense[i]->memory();
+		}
+		if (_sparse[i]) {
+			memory += sizeof(Tree<int>) + _sparse[i]->memory();
+		}
+	}
+	return memory;
+}
+
+void BucketRanking::setStats(ContainerStats* stats) {
+	_stats = stats;
+	for (int i = 0; i < _capacity; ++i) {
+		if (_sparse[i]) {
+			_sparse[i]->setStats(stats);
+		}
+	}
+}
@@ -0,0 +1,229 @@
+#ifndef CITYRANKING_H_
+#define CITYRANKING_H_
+
+#include "tree.h"
+#include "fenwickTree.h"
+#include "rankedBitSet.h"
+
+/*
+ * Class City Ranking
+ * Ranks the cities of the planet by their sizes, where cities of equal size
+ * are ranked by their IDs. This is the interface of the ranking engines the
+ * Planet may be initialized with (see library2.h):
+ * TreeRanking keeps the cities in an AVL tree. Every change of size removes
+ * the city from the tree and inserts it again. The cities of size 0 are kept
+ * in a bitmap instead.
+ * BucketRanking keeps a bucket of cities for every size, which suits sizes
+ * that change by small steps: a change of size only moves the city between
+ * two buckets.
+ */
+class CityRanking {
+public:
+	/* Destructor
+	 * Time complexity : O(n)
+	 */
+	virtual ~CityRanking() {
+	}
+	/* Adds the city @city of size @size to the ranking. The cities are
+	 * expected to be numbered 0 to n-1 in the order they are added.
+	 * Time complexity : O(log n) amortized
+	 */
+	virtual void insert(int city, int size) = 0;
+	/* Changes the size of @city from @oldSize to @newSize.
+	 * @throw std::bad_alloc, in which case the ranking is not changed.
+	 * Time complexity : O(log n), see the engines
+	 */
+	virtual void resize(int city, int oldSize, int newSize) = 0;
+	/* Changes the sizes of two different cities at once, @city1 from
+	 * @oldSize1 to @newSize1 and @city2 from @oldSize2 to @newSize2, e.g.
+	 * the cities between which a citizen relocates.
+	 * @throw std::bad_alloc, in which case the ranking is not changed.
+	 * Time complexity : O(log n), see the engines
+	 */
+	virtual void resize(int city1, int oldSize1, int newSize1, int city2,
+			int oldSize2, int newSize2) = 0;
+	/* Returns the city ranked k-th (0-based) from the smallest.
+	 * Time complexity : O(log n)
+	 */
+	virtual int select(int k) const = 0;
+	/* Writes to @results the cities ranked @from to @to (0-based,
+	 * inclusive), ranked from the smallest if @ascending is true or from the
+	 * largest otherwise, the @from-th city first.
+	 * Time complexity : O(log n + k), see the engines
+	 */
+	virtual void range(int from, int to, bool ascending,
+			int results[]) const = 0;
+	/* The same as range, where the range is split into up to @threads slices
+	 * of at least PARALLEL_SLICE cities, which are written at once by
+	 * threads of their own. Every slice finds its first city by its rank, so
+	 * it writes its part of @results independently of the others. A slice
+	 * whose thread cannot be started is written by the calling thread.
+	 * Time complexity : O(log n + k/t) with t threads, see range
+	 */
+	void parallelRange(int from, int to, bool ascending, int results[],
+			int threads) const;
+	/* Returns the number of cities in the ranking.
+	 * Time complexity : O(1)
+	 */
+	virtual int size() const = 0;
+	/* Returns the number of bytes allocated by the ranking, not counting the
+	 * ranking object itself.
+	 * Time complexity : O(1), see the engines
+	 */
+	virtual size_t memory() const = 0;
+	/* Makes the trees of the ranking count their work in @stats rather than
+	 * in the counters of the process (see stats.h).
+	 * Time complexity : O(1), see the engines
+	 */
+	virtual void setStats(ContainerStats* stats) = 0;
+
+	static const int PARALLEL_SLICE = 1 << 16;
+};
+
+/* Class RankedCity:
+ * A city in the TreeRanking, ordered by @_size primarily and @_id secondary.
+ */
+class RankedCity {
+public:
+	RankedCity();
+	RankedCity(int id, int size);
+	friend bool operator<(const RankedCity& city1, const RankedCity& city2);
+	friend bool operator==(const RankedCity& city1, const RankedCity& city2);
+	friend class TreeRanking;
+	friend class RankedCitiesToArray;
+private:
+	int _id;
+	int _size;
+};
+
+bool operator>(const RankedCity& city1, const RankedCity& city2);
+bool operator!=(const RankedCity& city1, const RankedCity& city2);
+
+/*
+ * Class Tree Ranking
+ * The cities of size 0, which rank first, are kept in a RankedBitSet of their
+ * IDs, and the other cities in an AVL tree. Thus a ranking of n new cities is
+ * made in O(n/64) with no nodes at all, and a city takes a node only while
+ * its size is not 0.
+ * The cities need not be numbered 0 to n-1, so the ranking may rank any set
+ * of IDs, e.g. the capitals of the kingdoms by their populations.
+ * Every operation takes O(log n), and range takes O(log n + k).
+ */
+class TreeRanking: public CityRanking {
+public:
+	/* Initializes a ranking of @n cities of size 0.
+	 * Time complexity : O(n/64)
+	 */
+	explicit TreeRanking(int n);
+	/* Initializes a ranking of the @n cities of @cities, which are already
+	 * ranked by size, whereas sizes[i] is the size of the city i.
+	 * Time complexity : O(n log n) at most, O(n) if no size is 0.
+	 */
+	TreeRanking(int n, const int cities[], const int sizes[]);
+	virtual void insert(int city, int size);
+	virtual void resize(int city, int oldSize, int newSize);
+	virtual void resize(int city1, int oldSize1, int newSize1, int city2,
+			int oldSize2, int newSize2);
+	/* Removes @city of size @size from the ranking.
+	 * Time complexity : O(log n)
+	 */
+	void remove(int city, int size);
+	/* Replaces @oldCity of size @oldSize with @city of size @size, e.g. the
+	 * capital of a kingdom whose capital or population changed. Nothing is
+	 * allocated unless @oldSize is 0 and @size is not.
+	 * @throw std::bad_alloc, in which case the ranking is not changed.
+	 * Time complexity : O(log n)
+	 */
+	void replace(int oldCity, int oldSize, int city, int size);
+	/* Makes room for @n cities of IDs already in the range of the ranking,
+	 * so that inserting them allocates nothing.
+	 * @throw std::bad_alloc, in which case the ranking is not changed.
+	 * Time complexity : O(n)
+	 */
+	void reserve(int n);
+	virtual int select(int k) const;
+	virtual void range(int from, int to, bool ascending, int results[]) const;
+	virtual int size() const;
+	virtual size_t memory() const;
+	virtual void setStats(ContainerStats* stats);
+private:
+	RankedBitSet _empty;	// the cities of size 0
+	Tree<RankedCity> _tree;	// the other cities
+
+	TreeRanking(const TreeRanking& ranking);
+	TreeRanking& operator=(const TreeRanking& ranking);
+	// helping functions to return the range of the IDs of @cities, and the
+	// number of them whose size is not 0. O(n)
+	static int idRange(int n, const int cities[]);
+	static int countSized(int n, const int cities[], const int sizes[]);
+};
+
+/*
+ * Class Bucket Ranking
+ * The buckets are ranked by a Fenwick tree over the number of cities of
+ * every size, so the bucket of a rank is found in O(log s), whereas s is the
+ * largest size. Inside a bucket the cities are ranked by their IDs, and the
+ * bucket is stored according to its density:
+ * A dense bucket, which holds at least 1/64 of the cities, is a RankedBitSet
+ * over all the IDs. The bucket of size 0 is always dense.
+ * A sparse bucket is an AVL tree of the IDs of its cities.
+ * Since the cities of most sizes are few, the trees are small, and most of
+ * the cities are in dense buckets whose updates touch a few cache lines
+ * rather than a path of tree nodes. A bucket changes its form when its
+ * density passes 1/64 or drops below 1/128, so O(n/128) updates separate two
+ * changes of a bucket, which take O(n) each.
+ * resize takes O(log s + log n) amortized, and range takes O(log n) for
+ * every bucket it visits plus O(1) amortized for every city it writes.
+ */
+class BucketRanking: public CityRanking {
+public:
+	/* Initializes a ranking of @n cities of size 0.
+	 * Time complexity : O(n)
+	 */
+	explicit BucketRanking(int n);
+	/* Initializes a ranking of the @n cities of @cities, which are already
+	 * ranked by size, whereas sizes[i] is the size of the city i.
+	 * Time complexity : O(n log n) at most, O(n) if all the sizes are 0.
+	 */
+	BucketRanking(int n, const int cities[], const int sizes[]);
+	virtual ~BucketRanking();
+	virtual void insert(int city, int size);
+	virtual void resize(int city, int oldSize, int newSize);
+	virtual void resize(int city1, int oldSize1, int newSize1, int city2,
+			int oldSize2, int newSize2);
+	virtual int select(int k) const;
+	virtual void range(int from, int to, bool ascending, int results[]) const;
+	virtual int size() const;
+	/* Time complexity : O(s), whereas s is the largest size */
+	virtual size_t memory() const;
+	/* Time complexity : O(s), whereas s is the largest size */
+	virtual void setStats(ContainerStats* stats);
+private:
+	int _size;
+	int _range;					// the range of the IDs in dense buckets
+	FenwickTree<int> _counts;	// the number of cities of every size
+	RankedBitSet** _dense;		// the dense bucket of every size, or NULL
+	Tree<int>** _sparse;		// the sparse bucket of every size, or NULL
+	int _capacity;				// the number of sizes in the arrays above
+	ContainerStats* _stats;		// of the sparse buckets, see setStats
+
+	BucketRanking(const BucketRanking& ranking);
+	BucketRanking& operator=(const BucketRanking& ranking);
+	// helping functions to add a city to / remove it from its bucket.
+	// O(log s + log n) amortized
+	void add(int city, int size);
+	void remove(int city, int size);
+	// helping functions to change the form of the bucket of @size. O(n)
+	void makeDense(int size);
+	void makeSparse(int size);
+	// helping function to make room for the buckets of sizes up to @size.
+	// O(s) amortized
+	void reserve(int size);
+	// helping function to return the size of the bucket ranked @k (0-based),
+	// and to set @k to the rank inside the bucket. O(log s)
+	int findBucket(int& k) const;
+	// helping function to return the number of cities of @size. O(log s)
+	int bucketSize(int size) const;
+};
+
+#endif /* CITYRANKING_H_ */
@@ -0,0 +1,122 @@
+#include "concurrentUnionFind.h"
+
+ConcurrentUnionFind::ConcurrentUnionFind(int n) :
+		n(n), base(n > 0 ? n : 1), capacity(base) {
+	segments[0] = newLazyArray<std::atomic<int> >(base); // the singletons
+	for (int s = 1; s < SEGMENTS; s++) {
+		segments[s] = NULL;
+	}
+}
+
+int ConcurrentUnionFind::findRoot(int x, int& word) {
+	int parent = load(x, std::memory_order_acquire);
+	while (parent >= 0) {
+		int grandparent = load(parent, std::memory_order_acquire);
+		if (grandparent < 0) {
+			word = grandparent;
+			return parent;
+		}
+		// path halving, losing the race to another thread is harmless
+		int expected = parent ^ encode(x);
+		at(x).compare_exchange_weak(expected, grandparent ^ encode(x),
+				std::memory_order_release, std::memory_order_relaxed);
+		x = grandparent;
+		parent = load(x, std::memory_order_acquire);
+	}
+	word = parent;
+	return x;
+}
+
+int ConcurrentUnionFind::Find(int x) {
+	checkIndex(x);
+	int word;
+	return findRoot(x, word);
+}
+
+int ConcurrentUnionFind::Label(int x) {
+	checkIndex(x);
+	int word;
+	findRoot(x, word);
+	return decode(word);
+}
+
+int ConcurrentUnionFind::Union(int x, int y, int label) {
+	checkIndex(x);
+	checkIndex(y);
+	if (label < 0) {
+		throw IllegalLabel();
+	}
+	while (true) {
+		int wordX, wordY;
+		int rootX = findRoot(x, wordX);
+		int rootY = findRoot(y, wordY);
+		if (rootX == rootY) {
+			return -1;
+		}
+		int child = rootX, parent = rootY, childWord = wordX;
+		int parentWord = wordY;
+		if (linkUnder(rootY, rootX)) {
+			child = rootY, parent = rootX, childWord = wordY;
+			parentWord = wordX;
+		}
+		// label the surviving root first, so that the set whose label
+		// changes observes it at a single point (see the class comment)
+		if (parentWord != encode(label)
+				&& !compareExchange(parent, parentWord, encode(label))) {
+			continue;
+		}
+		if (compareExchange(child, childWord, parent)) {
+			return parent;
+		}
+	}
+}
+
+void ConcurrentUnionFind::SetLabel(int x, int label) {
+	checkIndex(x);
+	if (label < 0) {
+		throw IllegalLabel();
+	}
+	while (true) {
+		int word;
+		int root = findRoot(x, word);
+		if (compareExchange(root, word, encode(label))) {
+			return;
+		}
+	}
+}
+
+int ConcurrentUnionFind::Add() {
+	int x = n.load(std::memory_order_relaxed);
+	if (x == capacity) {
+		int s = 1;
+		while (segments[s]) {
+			++s;
+		}
+		segments[s] = newLazyArray<std::atomic<int> >(capacity);
+		capacity *= 2;
+	}
+	store(x, encode(x), std::memory_order_relaxed);
+	// publishes the new word (and segment) to the readers of n
+	n.store(x + 1, std::memory_order_release);
+	return x;
+}
+
+void ConcurrentUnionFind::Restore(const int* parents, const int* labels) {
+	int size = n.load(std::memory_order_relaxed);
+	for (int i = 0; i < size; i++) {
+		if (parents[i] == i && labels[i] < 0) {
+			throw IllegalLabel();
+		}
+	}
+	for (int i = 0; i < size; i++) {
+		store(i, parents[i] == i ? encode(labels[i]) : parents[i],
+				std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+ConcurrentUnionFind::~ConcurrentUnionFind() {
+	for (int s = 0; s < SEGMENTS; s++) {
+		deleteLazyArray(segments[s]);
+	}
+}
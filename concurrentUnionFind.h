@@ -0,0 +1,178 @@
+#ifndef CONCURRENTUNIONFIND_H_
+#define CONCURRENTUNIONFIND_H_
+
+#include <stdlib.h>		// NULL
+#include <atomic>		// std::atomic
+#include <exception>	// std::exception
+#include "prefetch.h"
+#include "lazyArray.h"
+
+/*
+ * Class Concurrent Union Find:
+ * A lock-free Union Find over N elements in which every set carries an
+ * integer label (e.g. the capital of a kingdom).
+ * Find(x) : Given an index x, returns the root of the set to which x belongs.
+ * Label(x) : Given an index x, returns the label of the set to which x belongs.
+ * Union(x, y, label) : Merges the sets of x and y and labels the merged set.
+ * SetLabel(x, label) : Changes the label of the set to which x belongs.
+ *
+ * Every element holds a single atomic word: the index of its parent, or
+ * -(label + 1) if the element is a root. Thus a reader that reaches a root
+ * reads the set's label in the same load, with no further synchronization.
+ * Find and Label perform path halving with CAS; a failed CAS is harmless since
+ * any ancestor of an element is a valid parent for it, so readers never block
+ * each other nor the writers.
+ * Union links the two roots with a CAS that fails if either stopped being a
+ * root, in which case it retries, so concurrent unions never lose a link.
+ * Roots are linked by a fixed pseudo-random priority of their indices, which
+ * together with path halving keeps the paths O(log n) long in expectation.
+ * Add() appends a singleton. The words are stored in segments of doubling
+ * sizes that are never moved, so Add never disturbs concurrent readers.
+ * Every word is stored XORed with encode(x), so that a word of zero bytes is
+ * a root labeled x, and the segments are allocated as lazy arrays (see
+ * lazyArray.h): the n singletons are made in O(1), and only the pages of the
+ * elements that are linked or relabeled are ever mapped.
+ * Labels are linearizable as long as the calls changing them (Union and
+ * SetLabel) are serialized by the caller and Union's label is the label of one
+ * of the two merged sets: only the set whose label changes observes the
+ * change, and it does so in a single atomic write.
+ */
+class ConcurrentUnionFind {
+public:
+	/* Initializes a ConcurrentUnionFind with n singletons, element x labeled x.
+	 * Time Complexity: O(1).
+	 */
+	explicit ConcurrentUnionFind(int n);
+	/* Returns the index of the root of the set to which element x belongs.
+	 * @throw IndexOutOfBounds
+	 * Time Complexity: O(log n) expected.
+	 */
+	int Find(int x);
+	/* Returns the label of the set to which element x belongs.
+	 * @throw IndexOutOfBounds
+	 * Time Complexity: O(log n) expected.
+	 */
+	int Label(int x);
+	/* Merges the sets of x and y and labels the merged set with label.
+	 * Returns the root of the merged set, or -1 if x and y were already in
+	 * the same set (in which case nothing changes).
+	 * @throw IndexOutOfBounds
+	 * @throw IllegalLabel
+	 * Time Complexity: O(log n) expected.
+	 */
+	int Union(int x, int y, int label);
+	/* Changes the label of the set to which element x belongs.
+	 * @throw IndexOutOfBounds
+	 * @throw IllegalLabel
+	 * Time Complexity: O(log n) expected.
+	 */
+	void SetLabel(int x, int label);
+	/* Adds a new element n, labeled n, and returns its index. Like Union and
+	 * SetLabel, Add must be serialized with the other calls changing the
+	 * structure, but may run concurrently with Find and Label.
+	 * Time Complexity: O(1) amortized.
+	 */
+	int Add();
+	/* Replaces the sets by the sets given by parents and labels: element x
+	 * becomes a root labeled labels[x] if parents[x] is x, or a son of
+	 * parents[x] otherwise. Unlike the other changes, Restore may not run
+	 * concurrently with Find and Label.
+	 * @throw IllegalLabel
+	 * Time Complexity: O(n).
+	 */
+	void Restore(const int* parents, const int* labels);
+	/* Hints the processor to load the word of element x into the cache.
+	 * Time Complexity: O(1)
+	 */
+	void Prefetch(int x) const;
+	/* Returns the number of bytes allocated by the segments. Their pages are
+	 * only mapped once used (see lazyArray.h), so this is an upper bound.
+	 * Time Complexity: O(1)
+	 */
+	size_t memory() const;
+	/* class Destructor
+	 * Time complexity: O(1)
+	 */
+	~ConcurrentUnionFind();
+
+	/* Exceptions thrown by ConcurrentUnionFind */
+	class IndexOutOfBounds: public std::exception {
+	};
+	class IllegalLabel: public std::exception {
+	};
+
+private:
+	static const int SEGMENTS = 32;
+	std::atomic<int> n;			// number of elements
+	int base;					// size of the first segment
+	int capacity;				// total size of the allocated segments
+	/* The word of every element: its parent index, or -(label+1) for roots,
+	 * XORed with encode(x) for element x (see load below). Segment 0 holds the first @base words, and segment s>0 holds the words
+	 * [base*2^(s-1), base*2^s).
+	 */
+	std::atomic<int>* segments[SEGMENTS];
+
+	ConcurrentUnionFind(const ConcurrentUnionFind& unionFind);
+	ConcurrentUnionFind& operator=(const ConcurrentUnionFind& unionFind);
+
+	static int encode(int label) {
+		return -label - 1;
+	}
+	static int decode(int word) {
+		return -word - 1;
+	}
+	// the linking priority of element x, a fixed scramble of its index.
+	static unsigned int priority(int x) {
+		unsigned int h = (unsigned int) x * 2654435761u;
+		return h ^ (h >> 16);
+	}
+	// returns true if a root x should be linked under a root y.
+	static bool linkUnder(int x, int y) {
+		unsigned int px = priority(x), py = priority(y);
+		return px < py || (px == py && x < y);
+	}
+	std::atomic<int>& at(int x) const {
+		if (x < base) {
+			return segments[0][x];
+		}
+		int s = 1, start = base;
+		while (x - start >= start) {
+			start *= 2;
+			++s;
+		}
+		return segments[s][x - start];
+	}
+	// helping functions to load, store and compare-and-swap the word of
+	// element x, which is stored XORed with encode(x). O(1)
+	int load(int x, std::memory_order order) const {
+		return at(x).load(order) ^ encode(x);
+	}
+	void store(int x, int word, std::memory_order order) {
+		at(x).store(word ^ encode(x), order);
+	}
+	bool compareExchange(int x, int expected, int desired) {
+		int stored = expected ^ encode(x);
+		return at(x).compare_exchange_strong(stored, desired ^ encode(x));
+	}
+	void checkIndex(int x) const {
+		if (x < 0 || x >= n.load(std::memory_order_acquire)) {
+			throw IndexOutOfBounds();
+		}
+	}
+	/* Walks from x to its root while halving the path, and returns the root.
+	 * @word is set to the root's word (its encoded label).
+	 */
+	int findRoot(int x, int& word);
+};
+
+inline void ConcurrentUnionFind::Prefetch(int x) const {
+	if (x >= 0 && x < n.load(std::memory_order_relaxed)) {
+		PREFETCH(&at(x));
+	}
+}
+
+inline size_t ConcurrentUnionFind::memory() const {
+	return capacity * sizeof(std::atomic<int>);
+}
+
+#endif /* CONCURRENTUNIONFIND_H_ */
@@ -0,0 +1,172 @@
+#ifndef DYNAMICARRAY_H_
+#define DYNAMICARRAY_H_
+
+#include <stdlib.h>		// NULL
+#include <exception>	// std::exception
+
+/*
+ * Class Dynamic Array
+ * A contiguous array that grows (and shrinks) by doubling, so adding or
+ * removing an element at its end takes O(1) amortized time.
+ */
+template<class T>
+class DynamicArray {
+public:
+
+	/* Exceptions thrown by the array */
+	class ArrayIsEmpty: public std::exception {
+	};
+	class IndexOutOfBounds: public std::exception {
+	};
+
+	/* Empty constructor : initializes an empty array
+	 * Time complexity : O(1)
+	 */
+	DynamicArray();
+	/* Destructor : deletes the data of the array
+	 * Time complexity : O(n)
+	 */
+	~DynamicArray();
+	/* Adds @data to the end of the array.
+	 * Time complexity : O(1) amortized
+	 */
+	void pushBack(const T& data);
+	/* Makes room for @size elements, so that adding elements up to @size
+	 * allocates nothing. The array grows by doubling as in pushBack.
+	 * @throw std::bad_alloc, in which case the array is not changed.
+	 * Time complexity : O(1) amortized
+	 */
+	void reserve(int size);
+	/* Removes the last element of the array. Unless @shrink is false, the
+	 * array shrinks by half once a quarter of it is used, so removing
+	 * allocates nothing with @shrink false, e.g. to undo where nothing may
+	 * fail.
+	 * @throw ArrayIsEmpty
+	 * Time complexity : O(1) amortized
+	 */
+	void popBack(bool shrink = true);
+	/* Returns the last element of the array.
+	 * @throw ArrayIsEmpty
+	 * Time complexity : O(1)
+	 */
+	T& back();
+	/* Returns the element in index @i.
+	 * @throw IndexOutOfBounds
+	 * Time complexity : O(1)
+	 */
+	T& operator[](int i);
+	const T& operator[](int i) const;
+	/* Returns the number of elements in the array.
+	 * Time complexity : O(1)
+	 */
+	int size() const;
+	/* Returns the number of bytes allocated by the array, not counting the
+	 * array object itself.
+	 * Time complexity : O(1)
+	 */
+	size_t memory() const;
+	/* Removes all the elements of the array.
+	 * Time complexity : O(n)
+	 */
+	void clear();
+
+private:
+	T* _data;
+	int _size, _capacity;
+
+	DynamicArray(const DynamicArray& array);
+	DynamicArray& operator=(const DynamicArray& array);
+	// A helping function that moves the elements to an array of @newCapacity.
+	// Time complexity : O(n)
+	void reallocate(int newCapacity);
+};
+
+template<class T>
+DynamicArray<T>::DynamicArray() :
+		_data(NULL), _size(0), _capacity(0) {
+}
+
+template<class T>
+DynamicArray<T>::~DynamicArray() {
+	delete[] _data;
+}
+
+template<class T>
+void DynamicArray<T>::reallocate(int newCapacity) {
+	T* newData = newCapacity > 0 ? new T[newCapacity] : NULL;
+	for (int i = 0; i < _size; ++i) {
+		newData[i] = _data[i];
+	}
+	delete[] _data;
+	_data = newData;
+	_capacity = newCapacity;
+}
+
+template<class T>
+void DynamicArray<T>::pushBack(const T& data) {
+	if (_size == _capacity) {
+		reallocate(_capacity ? _capacity * 2 : 2);
+	}
+	_data[_size++] = data;
+}
+
+template<class T>
+void DynamicArray<T>::reserve(int size) {
+	if (size > _capacity) {
+		reallocate(size > 2 * _capacity ? size : 2 * _capacity);
+	}
+}
+
+template<class T>
+void DynamicArray<T>::popBack(bool shrink) {
+	if (_size == 0) {
+		throw ArrayIsEmpty();
+	}
+	--_size;
+	if (shrink && _size == _capacity / 4) {
+		reallocate(_capacity / 2);
+	}
+}
+
+template<class T>
+T& DynamicArray<T>::back() {
+	if (_size == 0) {
+		throw ArrayIsEmpty();
+	}
+	return _data[_size - 1];
+}
+
+template<class T>
+T& DynamicArray<T>::operator[](int i) {
+	if (i < 0 || i >= _size) {
+		throw IndexOutOfBounds();
+	}
+	return _data[i];
+}
+
+template<class T>
+const T& DynamicArray<T>::operator[](int i) const {
+	if (i < 0 || i >= _size) {
+		throw IndexOutOfBounds();
+	}
+	return _data[i];
+}
+
+template<class T>
+inline int DynamicArray<T>::size() const {
+	return _size;
+}
+
+template<class T>
+void DynamicArray<T>::clear() {
+	delete[] _data;
+	_data = NULL;
+	_size = _capacity = 0;
+}
+
+template<class T>
+inline size_t DynamicArray<T>::memory() const {
+	return _capacity * sizeof(T);
+}
+
+#endif /* DYNAMICARRAY_H_ */
@@ -0,0 +1,153 @@
+#ifndef EPOCHPOINTER_H_
+#define EPOCHPOINTER_H_
+
+#include <stdlib.h>		// NULL
+#include <atomic>		// std::atomic
+#include "dynamicArray.h"
+
+/*
+ * Class Epoch Pointer
+ * A pointer to immutable data which a writer replaces (publish) while
+ * readers keep using the data they found, without locks. The replaced data
+ * is deleted once no reader can still use it, which is found by epochs:
+ * every reader counts itself in the counter of the epoch in which it
+ * started, and the data replaced in epoch e is deleted when the epoch
+ * advances from e+1 to e+2, which publish does only when no reader of epoch
+ * e is left. Readers that start later find the newer data, so three
+ * counters (and lists of replaced data) are used in turn.
+ * Readers never wait: they only start again if the epoch advanced between
+ * reading it and counting themselves, before using the data. The calls to
+ * publish must be serialized by the caller.
+ */
+template<class T>
+class EpochPointer {
+public:
+	class Reader;
+
+	/* Empty constructor : initializes a NULL pointer.
+	 * Time complexity : O(1)
+	 */
+	EpochPointer();
+	/* Destructor : deletes the current and the replaced data. No reader may
+	 * be left.
+	 * Time complexity : O(r) whereas r is the number of replaced data.
+	 */
+	~EpochPointer();
+	/* Replaces the data by @data, which the pointer owns from now on.
+	 * Time complexity : O(1) amortized, plus the deletion of the data
+	 * replaced two epochs before.
+	 */
+	void publish(T* data);
+
+private:
+	static const int EPOCHS = 3;
+	/* A counter of readers, padded to a cache line of its own. */
+	struct Counter {
+		std::atomic<int> _readers;
+		char _padding[64 - sizeof(std::atomic<int>)];
+	};
+
+	std::atomic<T*> _current;
+	std::atomic<long long> _epoch;
+	Counter _active[EPOCHS];		// readers of every epoch (mod 3)
+	DynamicArray<T*> _retired[EPOCHS];	// data replaced in every epoch
+
+	EpochPointer(const EpochPointer& pointer);
+	EpochPointer& operator=(const EpochPointer& pointer);
+	// helping function to advance the epoch if no reader of the previous
+	// epoch is left. O(1) plus the deletions.
+	void advance();
+};
+
+/*
+ * Class Reader
+ * Reads the data of the pointer, which stays valid for the lifetime of the
+ * reader.
+ */
+template<class T>
+class EpochPointer<T>::Reader {
+public:
+	explicit Reader(EpochPointer& pointer);
+	~Reader();
+	/* Returns the data, or NULL if none was published.
+	 * Time complexity : O(1)
+	 */
+	const T* get() const {
+		return _data;
+	}
+private:
+	EpochPointer& _pointer;
+	int _counter;
+	const T* _data;
+
+	Reader(const Reader& reader);
+	Reader& operator=(const Reader& reader);
+};
+
+template<class T>
+EpochPointer<T>::EpochPointer() :
+		_current(NULL), _epoch(0) {
+	for (int i = 0; i < EPOCHS; ++i) {
+		_active[i]._readers.store(0, std::memory_order_relaxed);
+	}
+}
+
+template<class T>
+EpochPointer<T>::~EpochPointer() {
+	delete _current.load();
+	for (int i = 0; i < EPOCHS; ++i) {
+		for (int j = 0; j < _retired[i].size(); ++j) {
+			delete _retired[i][j];
+		}
+	}
+}
+
+template<class T>
+void EpochPointer<T>::publish(T* data) {
+	T* old = _current.exchange(data);
+	if (old) {
+		// the readers of this epoch may have found it, the next ones do not
+		_retired[_epoch.load() % EPOCHS].pushBack(old);
+	}
+	advance();
+}
+
+template<class T>
+void EpochPointer<T>::advance() {
+	long long epoch = _epoch.load();
+	int previous = (epoch + EPOCHS - 1) % EPOCHS;
+	if (_active[previous]._readers.load() != 0) {
+		return;
+	}
+	// the readers of the epoch before the previous one left when the epoch
+	// last advanced, so no reader holds the data replaced in the previous
+	// epoch
+	DynamicArray<T*>& retired = _retired[previous];
+	for (int j = 0; j < retired.size(); ++j) {
+		delete retired[j];
+	}
+	retired.clear();
+	_epoch.store(epoch + 1);
+}
+
+template<class T>
+EpochPointer<T>::Reader::Reader(EpochPointer& pointer) :
+		_pointer(pointer), _counter(0), _data(NULL) {
+	while (true) {
+		long long epoch = _pointer._epoch.load();
+		_counter = epoch % EPOCHS;
+		_pointer._active[_counter]._readers.fetch_add(1);
+		if (_pointer._epoch.load() == epoch) {
+			break;
+		}
+		_pointer._active[_counter]._readers.fetch_sub(1);
+	}
+	_data = _pointer._current.load();
+}
+
+template<class T>
+EpochPointer<T>::Reader::~Reader() {
+	_pointer._active[_counter]._readers.fetch_sub(1, std::memory_order_release);
+}
+
+#endif /* EPOCHPOINTER_H_ */
@@ -0,0 +1,167 @@
+#ifndef FENWICKTREE_H_
+#define FENWICKTREE_H_
+
+#include <stdlib.h>		// NULL
+#include <exception>	// std::exception
+
+/*
+ * Class Fenwick Tree (Binary Indexed Tree)
+ * Stores n non-negative values, indexed 0 to n-1, and supports changing a
+ * value and computing the sum of a prefix of the values in O(log n).
+ * find(k) returns the index in which the prefix sums pass k, which makes the
+ * tree an order-statistic structure when the values are counts.
+ */
+template<class T>
+class FenwickTree {
+public:
+
+	/* Exceptions thrown by the tree */
+	class IndexOutOfBounds: public std::exception {
+	};
+
+	/* Constructor : initializes a tree of @n values, all equal to @value.
+	 * Time complexity : O(n)
+	 */
+	FenwickTree(int n, const T& value);
+	/* Destructor : deletes the data of the tree
+	 * Time complexity : O(1)
+	 */
+	~FenwickTree();
+	/* Adds @diff to the value in index @i.
+	 * @throw IndexOutOfBounds
+	 * Time complexity : O(log n)
+	 */
+	void add(int i, const T& diff);
+	/* Returns the sum of the values in indices 0 to @i, or 0 if @i<0.
+	 * @throw IndexOutOfBounds
+	 * Time complexity : O(log n)
+	 */
+	T prefix(int i) const;
+	/* Returns the smallest index i such that prefix(i) > @k, or n if there
+	 * is no such index. Since the values are non-negative this is the index
+	 * of the element ranked @k (0-based) when the values are counts.
+	 * Time complexity : O(log n)
+	 */
+	int find(T k) const;
+	/* Changes the number of values to @n, the new values are 0 and values
+	 * in indices n or above are dropped.
+	 * Time complexity : O(n + the current number of values)
+	 */
+	void resize(int n);
+	/* Returns the number of values in the tree.
+	 * Time complexity : O(1)
+	 */
+	int size() const;
+	/* Returns the number of bytes allocated by the tree, not counting the
+	 * tree object itself.
+	 * Time complexity : O(1)
+	 */
+	size_t memory() const;
+
+private:
+	T* _data;	// _data[i-1] is the sum of the values (i - lowbit(i), i]
+	int _size;
+
+	FenwickTree(const FenwickTree& tree);
+	FenwickTree& operator=(const FenwickTree& tree);
+	static int lowbit(int i) {
+		return i & -i;
+	}
+	// A helping function that turns the array of values @data into a tree of
+	// @n values in place, or back if @build is false. O(n)
+	static void convert(T* data, int n, bool build);
+};
+
+template<class T>
+FenwickTree<T>::FenwickTree(int n, const T& value) :
+		_data(new T[n > 0 ? n : 1]), _size(n) {
+	for (int i = 0; i < n; ++i) {
+		_data[i] = value;
+	}
+	convert(_data, n, true);
+}
+
+template<class T>
+FenwickTree<T>::~FenwickTree() {
+	delete[] _data;
+}
+
+template<class T>
+void FenwickTree<T>::convert(T* data, int n, bool build) {
+	if (build) {
+		for (int i = 1; i <= n; ++i) {
+			if (i + lowbit(i) <= n) {
+				data[i + lowbit(i) - 1] += data[i - 1];
+			}
+		}
+	} else { // undoes the above, from the last index to the first
+		for (int i = n; i >= 1; --i) {
+			if (i + lowbit(i) <= n) {
+				data[i + lowbit(i) - 1] -= data[i - 1];
+			}
+		}
+	}
+}
+
+template<class T>
+void FenwickTree<T>::add(int i, const T& diff) {
+	if (i < 0 || i >= _size) {
+		throw IndexOutOfBounds();
+	}
+	for (++i; i <= _size; i += lowbit(i)) {
+		_data[i - 1] += diff;
+	}
+}
+
+template<class T>
+T FenwickTree<T>::prefix(int i) const {
+	if (i >= _size) {
+		throw IndexOutOfBounds();
+	}
+	T sum = T();
+	for (++i; i > 0; i -= lowbit(i)) {
+		sum += _data[i - 1];
+	}
+	return sum;
+}
+
+template<class T>
+int FenwickTree<T>::find(T k) const {
+	int step = 1;
+	while (step * 2 <= _size) {
+		step *= 2;
+	}
+	int i = 0; // the prefix (0, i] has a sum of at most k
+	for (; step > 0; step /= 2) {
+		if (i + step <= _size && !(k < _data[i + step - 1])) {
+			i += step;
+			k -= _data[i - 1];
+		}
+	}
+	return i;
+}
+
+template<class T>
+void FenwickTree<T>::resize(int n) {
+	T* data = new T[n > 0 ? n : 1];
+	convert(_data, _size, false);
+	for (int i = 0; i < n; ++i) {
+		data[i] = i < _size ? _data[i] : T();
+	}
+	convert(data, n, true);
+	delete[] _data;
+	_data = data;
+	_size = n;
+}
+
+template<class T>
+inline int FenwickTree<T>::size() const {
+	return _size;
+}
+
+template<class T>
+inline size_t FenwickTree<T>::memory() const {
+	return (_size > 0 ? _size : 1) * sizeof(T);
+}
+
+#endif /* FENWICKTREE_H_ */
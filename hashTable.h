@@ -1,12 +1,17 @@
 #ifndef HASHTABLE_H_
 #define HASHTABLE_H_
 
+#include <chrono>		// std::chrono::steady_clock
+#include <new>			// std::bad_alloc
 #include "tree.h"
+#include "stats.h"
 
 /* Class HashTable
  * This data structure maps keys to values using a Modulo as the hash function
  * dynamic allocation for the array, Chain Hashing technique along with and
  * AVL Trees as the chains in each slot (bucket).
+ * The trees are stored in the array itself, so an empty slot costs the size
+ * of an empty Tree and no allocation.
  */
 template<class T>
 class HashTable {
@@ -23,6 +28,11 @@ public:
 	 * Time complexity : O(1)
 	 */
 	HashTable();
+	/* Constructor : initializes an empty new hash table with room for
+	 * @size elements, which are inserted with no reallocation.
+	 * Time complexity : O(size)
+	 */
+	explicit HashTable(size_t size);
 	/* Destructor: clears the objects in the table and deletes the data
 	 * Time complexity : O(n)
 	 */
@@ -32,6 +42,12 @@ public:
 	 * Time Complexity: O(1) amortized in average.
 	 */
 	void insert(const T& data);
+	/* Makes room for @size elements, which are then inserted with no
+	 * reallocation.
+	 * @throw std::bad_alloc, in which case the table is not changed.
+	 * Time Complexity: O(n + size) if the table grows, O(1) otherwise.
+	 */
+	void reserve(size_t size);
 	/* Removes an element from the Hash Table.
 	 * @throw ElementNotFound
 	 * @throw TableIsEmpty
@@ -42,20 +58,48 @@ public:
 	 * Time Complexity: O(1) in average, O(log n) in worst case.
 	 */
 	T* find(const T& data) const;
+	/* Hints the processor to load the memory that find(@data) will need,
+	 * one level at a time: @level 0 loads the slot of @data in the table,
+	 * which holds its chain, and level 1 the first node of the chain.
+	 * Each level reads the memory loaded by the previous one, so the levels
+	 * should be issued in order with other work in between, which lets the
+	 * cache misses of many independent lookups overlap.
+	 * Time Complexity: O(1)
+	 */
+	void prefetch(const T& data, int level) const;
 	/* Returns the number of elements in the Hash Table
 	 * Time Complexity: O(1)
 	 */
 	size_t size() const;
+	/* Returns the number of bytes allocated by the Hash Table, not counting
+	 * the table object itself.
+	 * Time Complexity: O(table size)
+	 */
+	size_t memory() const;
+	/* Makes the table and its chains count their work in @stats rather than
+	 * in the counters of the process (see stats.h). It does nothing without
+	 * WET2_STATS.
+	 * Time Complexity: O(table size)
+	 */
+	void setStats(ContainerStats* stats);
+	/* A template method that calls the Function on all the elements of the
+	 * table, in no particular order.
+	 * Time Complexity: O(n + table size)
+	 */
+	template<class Function>
+	void forEach(Function& function) const;
 
 private:
 
 	size_t _size, _tableSize;
-	Tree<T> **_table;
+	Tree<T> *_table;
+#ifdef WET2_STATS
+	ContainerStats* _stats; // see setStats
+#endif
 
-	void initializeTable(Tree<T>* _table[], int size);
-	void deleteTable(Tree<T>* _table[], int size);
 	template<class HashFunction>
 	int hash(const T& data, HashFunction& hashFucntion) const ;
+	// keeps the table as it was if it throws std::bad_alloc
 	void realocateTable(size_t newSize);
 	class InsertToNewTable;
 	class Modulo;
@@ -77,52 +121,60 @@ private:
 
 template<class T>
 HashTable<T>::HashTable() :
-		_size(0), _tableSize(2), _table(new Tree<T>*[_tableSize]) {
-	initializeTable(_table, _tableSize);
+		_size(0), _tableSize(2), _table(new Tree<T> [_tableSize]) {
+	STATS(_stats = &ContainerStats::global());
 }
 
 template<class T>
-void HashTable<T>::initializeTable(Tree<T>* table[], int size) {
-	for (int i = 0; i < size; ++i) {
-		table[i] = new Tree<T>();
-	}
-}
-
-template<class T>
-void HashTable<T>::deleteTable(Tree<T>* table[], int size) {
-	for (int i = 0; i < size; ++i) {
-		delete table[i];
-	}
-	delete[] table;
+HashTable<T>::HashTable(size_t size) :
+		_size(0), _tableSize(size < 1 ? 2 : 2 * size), _table(
+				new Tree<T> [_tableSize]) {
+	STATS(_stats = &ContainerStats::global());
 }
 
 template<class T>
 HashTable<T>::~HashTable() {
-	deleteTable(_table, _tableSize);
+	delete[] _table;
 }
 
 template<class T>
 void HashTable<T>::insert(const T& data) {
 	try {
 		HashTable<T>::Modulo modulo(_tableSize);
-		_table[hash(data, modulo)]->insert(data);
+		_table[hash(data, modulo)].insert(data);
 		_size++;
-		if (_size == _tableSize) {
-			realocateTable(_tableSize * 2);
+		if (_size >= _tableSize) {
+			try {
+				realocateTable(_tableSize * 2);
+			} catch (std::bad_alloc& e) {
+				// growing only keeps the chains short, so a failed
+				// allocation keeps the table, and the next insert retries
+			}
 		}
 	} catch (typename Tree<T>::ElementAlreadyExists &e) {
 		throw ElementAlreadyExists();
 	}
 }
 
+template<class T>
+void HashTable<T>::reserve(size_t size) {
+	if (size >= _tableSize) {
+		realocateTable(2 * size);
+	}
+}
+
 template<class T>
 void HashTable<T>::remove(const T& data) {
 	try {
 		HashTable<T>::Modulo modulo(_tableSize);
-		_table[this->hash(data, modulo)]->remove(data);
+		_table[this->hash(data, modulo)].remove(data);
 		_size--;
-		if (_size == _tableSize / 4) {
-			realocateTable(_tableSize / 2);
+		if (_size == _tableSize / 4 && _tableSize > 2) {
+			try {
+				realocateTable(_tableSize / 2);
+			} catch (std::bad_alloc& e) {
+				// as in insert
+			}
 		}
 	} catch (typename Tree<T>::ElementNotFound &e) {
 		throw ElementNotFound();
@@ -134,10 +186,14 @@ void HashTable<T>::remove(const T& data) {
 template<class T>
 T* HashTable<T>::find(const T& data) const {
 	HashTable<T>::Modulo modulo(_tableSize);
-	Tree<T> *tree = _table[this->hash(data, modulo)];
+	Tree<T> *tree = _table + this->hash(data, modulo);
+	if (tree->size() == 0) { // most slots are empty or hold a single element
+		return NULL;
+	}
 	try {
-		if (tree->find(data)->getData() == data) {
-			return &(tree->find(data)->getData());
+		T& found = tree->find(data)->getData();
+		if (found == data) {
+			return &found;
 		}
 	} catch (typename Tree<T>::TreeIsEmpty &e) {
 		return NULL;
@@ -145,11 +201,39 @@ T* HashTable<T>::find(const T& data) const {
 	return NULL;
 }
 
+template<class T>
+void HashTable<T>::prefetch(const T& data, int level) const {
+	HashTable<T>::Modulo modulo(_tableSize);
+	Tree<T>* slot = _table + this->hash(data, modulo);
+	if (level == 0) {
+		PREFETCH(slot);
+	} else {
+		slot->prefetch();
+	}
+}
+
 template<class T>
 size_t HashTable<T>::size() const {
 	return _size;
 }
 
+template<class T>
+size_t HashTable<T>::memory() const {
+	size_t memory = _tableSize * sizeof(Tree<T>);
+	for (size_t i = 0; i < _tableSize; ++i) {
+		memory += _table[i].memory();
+	}
+	return memory;
+}
+
+template<class T>
+template<class Function>
+void HashTable<T>::forEach(Function& function) const {
+	for (size_t i = 0; i < _tableSize; ++i) {
+		_table[i].inOrder(function);
+	}
+}
+
 template<class T>
 template<class HashFunction>
 int HashTable<T>::hash(const T& data, HashFunction& hashFucntion) const {
@@ -158,17 +242,55 @@ int HashTable<T>::hash(const T& data, HashFunction& hashFucntion) const {
 
 template<class T>
 void HashTable<T>::realocateTable(size_t newSize) {
-	Tree<T>** newTable = new Tree<T>*[newSize];
-	initializeTable(newTable, newSize);
-	Tree<T>** oldTable = _table;
+#ifdef WET2_STATS
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+#endif
+	Tree<T>* newTable = new Tree<T> [newSize];
+#ifdef WET2_STATS
+	for (size_t i = 0; i < newSize; ++i) {
+		newTable[i].setStats(_stats);
+	}
+#endif
+	Tree<T>* oldTable = _table;
 	size_t oldSize = _tableSize;
+	size_t size = _size;
 	_table = newTable;
 	_tableSize = newSize;
-	for (unsigned int i = 0; i < oldSize; ++i) {
-		InsertToNewTable insertFunc(this);
-		oldTable[i]->inOrder(insertFunc);
+	_size = 0; // counted again by the insertions
+	try {
+		for (unsigned int i = 0; i < oldSize; ++i) {
+			InsertToNewTable insertFunc(this);
+			oldTable[i].inOrder(insertFunc);
+		}
+	} catch (std::bad_alloc& e) { // the old table is kept as it was
+		delete[] newTable;
+		_table = oldTable;
+		_tableSize = oldSize;
+		_size = size;
+		throw;
+	}
+	_size = size;
+	delete[] oldTable;
+#ifdef WET2_STATS
+	ContainerStats& stats = *_stats;
+	stats._hashReallocations.add(1);
+	stats._hashReallocationNanoseconds.add(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - start).count());
+#endif
+}
+
+template<class T>
+void HashTable<T>::setStats(ContainerStats* stats) {
+#ifdef WET2_STATS
+	_stats = stats;
+	for (size_t i = 0; i < _tableSize; ++i) {
+		_table[i].setStats(stats);
 	}
-	deleteTable(oldTable, oldSize);
+#else
+	(void) stats;
+#endif
 }
 
 template<class T>
@@ -0,0 +1,31 @@
+#ifndef LAZYARRAY_H_
+#define LAZYARRAY_H_
+
+#include <stdlib.h>		// calloc, free
+#include <new>			// std::bad_alloc
+
+/*
+ * newLazyArray<T>(n) allocates an array of n objects of T whose bytes are all
+ * zero, and deleteLazyArray frees it. The memory comes from calloc, which
+ * takes large blocks directly from the system as pages that are mapped (and
+ * zeroed) only when they are first written, so allocating a huge array takes
+ * O(1) and its untouched parts cost no memory. T must be a type that may be
+ * copied byte by byte and whose objects of zero bytes are meaningful, as no
+ * constructor is run.
+ * @throw std::bad_alloc
+ */
+template<class T>
+T* newLazyArray(size_t n) {
+	void* data = calloc(n > 0 ? n : 1, sizeof(T));
+	if (!data) {
+		throw std::bad_alloc();
+	}
+	return (T*) data;
+}
+
+template<class T>
+void deleteLazyArray(T* data) {
+	free((void*) data);
+}
+
+#endif /* LAZYARRAY_H_ */
@@ -13,9 +13,66 @@ void* Init(int n) {
 	}
 }
 
+void* InitWithRanking(int n, RankingType ranking) {
+	try {
+		Planet* DS = new Planet(n, ranking);
+		return (void*) DS;
+	} catch (std::bad_alloc& e) {
+		return NULL;
+	}
+}
+
+void* LoadSnapshot(const char* path) {
+	if (!path) {
+		return NULL;
+	}
+	try {
+		Snapshot snapshot(path);
+		Planet* DS = new Planet(snapshot);
+		return (void*) DS;
+	} catch (...) {
+		return NULL;
+	}
+}
+
+void* Recover(const char* snapshotPath, const char* logPath) {
+	if (!snapshotPath || !logPath) {
+		return NULL;
+	}
+	Planet* DS = NULL;
+	try {
+		Snapshot snapshot(snapshotPath);
+		DS = new Planet(snapshot);
+		if (DS->ReplayLog(logPath) != SUCCESS) {
+			delete DS;
+			return NULL;
+		}
+		return (void*) DS;
+	} catch (...) {
+		delete DS;
+		return NULL;
+	}
+}
+
+StatusType AddCity(void* DS, int* city) {
+	CHECK_NULL(DS);
+	if (!city) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->AddCity(city);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
 StatusType AddCitizen(void* DS, int citizenID) {
 	CHECK_NULL(DS);
 	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
 		return ((Planet*) DS)->AddCitizen(citizenID);
 	} catch (std::bad_alloc& e) {
 		return ALLOCATION_ERROR;
@@ -27,6 +84,7 @@ StatusType AddCitizen(void* DS, int citizenID) {
 StatusType MoveToCity(void* DS, int citizenID, int city) {
 	CHECK_NULL(DS);
 	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
 		return ((Planet*) DS)->MoveToCity(citizenID, city);
 	} catch (std::bad_alloc& e) {
 		return ALLOCATION_ERROR;
@@ -35,9 +93,66 @@ StatusType MoveToCity(void* DS, int citizenID, int city) {
 	}
 }
 
+StatusType RemoveCitizen(void* DS, int citizenID) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->RemoveCitizen(citizenID);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType MoveToCityBatch(void* DS, const int citizenIDs[], const int cities[],
+		int count, StatusType statuses[]) {
+	CHECK_NULL(DS);
+	if (!citizenIDs || !cities || count < 0 || !statuses) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->MoveToCityBatch(citizenIDs, cities, count,
+				statuses);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType RelocateCitizen(void* DS, int citizenID, int city) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->RelocateCitizen(citizenID, city);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType ImportCitizens(void* DS, const char* path, long long* rows) {
+	CHECK_NULL(DS);
+	if (!path || !rows) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->ImportCitizens(path, rows);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
 StatusType JoinKingdoms(void* DS, int city1, int city2) {
 	CHECK_NULL(DS);
 	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
 		return ((Planet*) DS)->JoinKingdoms(city1, city2);
 	} catch (std::bad_alloc& e) {
 		return ALLOCATION_ERROR;
@@ -52,6 +167,104 @@ StatusType GetCapital(void* DS, int citizenID, int* capital) {
 		return INVALID_INPUT;
 	}
 	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetCapital(citizenID, capital);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetCapitalBatch(void* DS, const int citizenIDs[], int count,
+		int capitals[], StatusType statuses[]) {
+	CHECK_NULL(DS);
+	if (!citizenIDs || count < 0 || !capitals || !statuses) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetCapitalBatch(citizenIDs, count, capitals,
+				statuses);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType AddCitizen64(void* DS, long long citizenID) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->AddCitizen(citizenID);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType MoveToCity64(void* DS, long long citizenID, int city) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->MoveToCity(citizenID, city);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType RemoveCitizen64(void* DS, long long citizenID) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->RemoveCitizen(citizenID);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType MoveToCityBatch64(void* DS, const long long citizenIDs[],
+		const int cities[], int count, StatusType statuses[]) {
+	CHECK_NULL(DS);
+	if (!citizenIDs || !cities || count < 0 || !statuses) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->MoveToCityBatch(citizenIDs, cities, count,
+				statuses);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType RelocateCitizen64(void* DS, long long citizenID, int city) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->RelocateCitizen(citizenID, city);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetCapital64(void* DS, long long citizenID, int* capital) {
+	CHECK_NULL(DS);
+	if (!capital || citizenID < 0) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
 		return ((Planet*) DS)->GetCapital(citizenID, capital);
 	} catch (std::bad_alloc& e) {
 		return ALLOCATION_ERROR;
@@ -60,12 +273,30 @@ StatusType GetCapital(void* DS, int citizenID, int* capital) {
 	}
 }
 
+StatusType GetCapitalBatch64(void* DS, const long long citizenIDs[], int count,
+		int capitals[], StatusType statuses[]) {
+	CHECK_NULL(DS);
+	if (!citizenIDs || count < 0 || !capitals || !statuses) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetCapitalBatch(citizenIDs, count, capitals,
+				statuses);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
 StatusType SelectCity(void* DS, int k, int* city) {
 	CHECK_NULL(DS);
 	if (k < 0 || !city) {
 		return INVALID_INPUT;
 	}
 	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
 		return ((Planet*) DS)->SelectCity(k, city);
 	} catch (std::bad_alloc& e) {
 		return ALLOCATION_ERROR;
@@ -80,6 +311,7 @@ StatusType GetCitiesBySize(void* DS, int results[]) {
 		return INVALID_INPUT;
 	}
 	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
 		return ((Planet*) DS)->GetCitiesBySize(results);
 	} catch (std::bad_alloc& e) {
 		return ALLOCATION_ERROR;
@@ -88,6 +320,438 @@ StatusType GetCitiesBySize(void* DS, int results[]) {
 	}
 }
 
+StatusType GetTopCities(void* DS, int k, int results[]) {
+	CHECK_NULL(DS);
+	if (!results) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetTopCities(k, results);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetCitiesInRankRange(void* DS, int from, int to, int ascending,
+		int results[]) {
+	CHECK_NULL(DS);
+	if (!results) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetCitiesInRankRange(from, to,
+				ascending != 0, results);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetKingdomCities(void* DS, int city, int cities[], int* count) {
+	CHECK_NULL(DS);
+	if (!cities || !count) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetKingdomCities(city, cities, count);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetKingdomSize(void* DS, int city, int* size) {
+	CHECK_NULL(DS);
+	if (!size) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetKingdomSize(city, size);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetKingdomPopulation(void* DS, int city, int* population) {
+	CHECK_NULL(DS);
+	if (!population) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetKingdomPopulation(city, population);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetCityResidents(void* DS, int city, int offset,
+		long long residents[], int max, int* count) {
+	CHECK_NULL(DS);
+	if (!residents || !count) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetCityResidents(city, offset, residents, max,
+				count);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetNumberOfKingdoms(void* DS, int* count) {
+	CHECK_NULL(DS);
+	if (!count) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetNumberOfKingdoms(count);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType SelectKingdom(void* DS, int k, int* capital) {
+	CHECK_NULL(DS);
+	if (k < 0 || !capital) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->SelectKingdom(k, capital);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetKingdomsByPopulation(void* DS, int results[], int* count) {
+	CHECK_NULL(DS);
+	if (!results || !count) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetKingdomsByPopulation(results, count);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType SelectCityInKingdom(void* DS, int city, int k, int* result) {
+	CHECK_NULL(DS);
+	if (!result) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->SelectCityInKingdom(city, k, result);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetKingdomCitiesBySize(void* DS, int city, int results[],
+		int* count) {
+	CHECK_NULL(DS);
+	if (!results || !count) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetKingdomCitiesBySize(city, results, count);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetChangesSince(void* DS, long long version, int cities[],
+		int* count, long long* newVersion) {
+	CHECK_NULL(DS);
+	if (!cities || !count || !newVersion) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetChangesSince(version, cities, count,
+				newVersion);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType SaveSnapshot(void* DS, const char* path) {
+	CHECK_NULL(DS);
+	if (!path) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->SaveSnapshot(path);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType StartLog(void* DS, const char* path, int groupSize,
+		int groupMilliseconds) {
+	CHECK_NULL(DS);
+	if (!path) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->StartLog(path, groupSize, groupMilliseconds);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType FlushLog(void* DS) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->FlushLog();
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType StopLog(void* DS) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->StopLog();
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType PublishRanking(void* DS, long long* version) {
+	CHECK_NULL(DS);
+	if (!version) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->PublishRanking(version);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType SetPublishInterval(void* DS, int interval) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->SetPublishInterval(interval);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+/* The published ranking is read without the lock of the planet. */
+StatusType SelectPublishedCity(void* DS, int k, int* city, long long* version) {
+	CHECK_NULL(DS);
+	if (!city || !version) {
+		return INVALID_INPUT;
+	}
+	try {
+		return ((Planet*) DS)->SelectPublishedCity(k, city, version);
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetPublishedCitiesBySize(void* DS, int results[], int* count,
+		long long* version) {
+	CHECK_NULL(DS);
+	if (!results || !count || !version) {
+		return INVALID_INPUT;
+	}
+	try {
+		return ((Planet*) DS)->GetPublishedCitiesBySize(results, count,
+				version);
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetPublishedRank(void* DS, int city, int* rank, long long* version) {
+	CHECK_NULL(DS);
+	if (!rank || !version) {
+		return INVALID_INPUT;
+	}
+	try {
+		return ((Planet*) DS)->GetPublishedRank(city, rank, version);
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType CountPublishedCitiesBelow(void* DS, int size, int* count,
+		long long* version) {
+	CHECK_NULL(DS);
+	if (!count || !version) {
+		return INVALID_INPUT;
+	}
+	try {
+		return ((Planet*) DS)->CountPublishedCitiesBelow(size, count, version);
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType MakeThreadSafe(void* DS) {
+	CHECK_NULL(DS);
+	try {
+		return ((Planet*) DS)->MakeThreadSafe();
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType SubscribeCapitalChanges(void* DS, CapitalCallback callback,
+		void* context, int* subscription) {
+	CHECK_NULL(DS);
+	if (!callback || !subscription) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->SubscribeCapitalChanges(callback, context,
+				subscription);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType UnsubscribeCapitalChanges(void* DS, int subscription) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->UnsubscribeCapitalChanges(subscription);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType GetStats(void* DS, PlanetStats* stats) {
+	CHECK_NULL(DS);
+	if (!stats) {
+		return INVALID_INPUT;
+	}
+	try {
+		ReadWriteLock::Shared lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->GetStats(stats);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType BeginTransaction(void* DS) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->BeginTransaction();
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType CommitTransaction(void* DS) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->CommitTransaction();
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType RollbackTransaction(void* DS) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->RollbackTransaction();
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType CompactCities(void* DS) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->CompactCities();
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
+StatusType SetCompactionThreshold(void* DS, int percent) {
+	CHECK_NULL(DS);
+	try {
+		ReadWriteLock::Exclusive lock(((Planet*) DS)->GetLock());
+		return ((Planet*) DS)->SetCompactionThreshold(percent);
+	} catch (std::bad_alloc& e) {
+		return ALLOCATION_ERROR;
+	} catch (...) {
+		return FAILURE;
+	}
+}
+
 void Quit(void** DS) {
 	if (!DS || !*DS)
 		return;
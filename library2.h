@@ -33,13 +33,62 @@ typedef enum {
 } StatusType;
 
 
+/* City Ranking Engines
+ * ----------------------------------- */
+typedef enum {
+	RANKING_TREE = 0,
+	RANKING_BUCKETS = 1
+
+} RankingType;
+
+
+/* Statistics of the Data Structure, see GetStats
+ * ----------------------------------- */
+typedef struct {
+	long long rotations;				/* rotations made by the AVL trees */
+	long long finds;					/* searches of the AVL trees */
+	long long findDepth;				/* nodes visited by all the searches */
+	long long maxFindDepth;				/* nodes visited by the deepest search */
+} TreeStats;
+
+typedef struct {
+	int countersEnabled;				/* whether the counters below were compiled in */
+	/* the counters of this data structure, where the tree counters are those of the parts below together */
+	long long treeRotations;			/* rotations made by the AVL trees */
+	long long treeFinds;				/* searches of the AVL trees */
+	long long treeFindDepth;			/* nodes visited by all the searches */
+	long long treeMaxFindDepth;			/* nodes visited by the deepest search */
+	long long hashReallocations;		/* times the hash tables were resized */
+	long long hashReallocationNanoseconds;	/* time spent resizing them */
+	long long unionFinds;				/* Find calls of the kingdoms' union-find */
+	long long unionFindPathLength;		/* parents followed by all of them, before path compression */
+	long long unionFindMaxPathLength;	/* parents followed by the longest one */
+	/* the tree counters of every part of this data structure */
+	TreeStats citizensTrees;			/* the chains of the hash table of the citizens */
+	TreeStats rankingTrees;				/* the rankings of the cities by size, of the kingdoms by population and within every kingdom */
+	/* the bytes allocated by every part of this data structure */
+	long long citizensBytes;			/* the hash table of the citizens */
+	long long citiesBytes;				/* the arrays of the cities and their resident lists */
+	long long kingdomsBytes;			/* the union-finds of the kingdoms and their rankings of cities */
+	long long citiesRankingBytes;		/* the ranking of the cities by size */
+	long long kingdomsRankingBytes;		/* the ranking of the kingdoms by population */
+} PlanetStats;
+
+
+/* Capital Change Notifications, see SubscribeCapitalChanges
+ * ----------------------------------- */
+typedef void (*CapitalCallback)(void* context, int kingdom, int oldCapital, int newCapital,
+		long long version);
+
+
 
 /* Required Interface for the Data Structure
  * -----------------------------------------*/
 
 
 
-/* Description:   Initializes the planet with n cities.
+/* Description:   Initializes the planet with n cities. A city takes memory only from its first use,
+ *                so Init takes a few milliseconds even for 10^8 cities.
  * Input:         n - Number of cities in the planet.
  * Output:        None.
  * Return Values: A pointer to a new instance of the data structure - as a void* pointer.
@@ -47,6 +96,59 @@ typedef enum {
 void*       Init(int n);
 
 
+/* Description:   Initializes the planet with n cities, ranked by size with the given engine.
+ *                RANKING_TREE (what Init uses) keeps the cities in an AVL tree. RANKING_BUCKETS keeps a
+ *                bucket of cities for every size, which is faster when cities change by few citizens at
+ *                a time, as they do with MoveToCity.
+ * Input:         n - Number of cities in the planet.
+ *                ranking - The ranking engine.
+ * Output:        None.
+ * Return Values: A pointer to a new instance of the data structure - as a void* pointer.
+ */
+void*       InitWithRanking(int n, RankingType ranking);
+
+
+/* Description:   Initializes the planet from a snapshot file written by SaveSnapshot. The file is
+ *                mapped into memory and checked, and the planet copies its arrays: the kingdoms, the
+ *                capitals and the rankings are built from them in linear time, and every citizen is
+ *                inserted into the hash table, so loading takes O(n + m) with m citizens, without
+ *                replaying the updates or sorting.
+ * Input:         path - The path of the snapshot file.
+ * Output:        None.
+ * Return Values: A pointer to a new instance of the data structure - as a void* pointer, or NULL if
+ *                path==NULL, the file cannot be read or is not a valid snapshot, or in case of an
+ *                allocation error.
+ */
+void*       LoadSnapshot(const char* path);
+
+
+/* Description:   Recovers the planet after a crash: restores it from a snapshot file as LoadSnapshot,
+ *                and replays the updates recorded after the snapshot in a log written by StartLog,
+ *                up to the last group of records that was completely flushed. The log may begin
+ *                before the snapshot (e.g. a log started right after Init, with a snapshot saved
+ *                later), but it must hold every update made after the snapshot.
+ *                Logging is not started again; call StartLog with the same log to keep adding to it.
+ * Input:         snapshotPath - The path of the snapshot file.
+ *                logPath - The path of the log.
+ * Output:        None.
+ * Return Values: A pointer to a new instance of the data structure - as a void* pointer, or NULL if
+ *                a path is NULL, either file cannot be read or is not valid, the log misses updates
+ *                made after the snapshot, or in case of an allocation error.
+ */
+void*       Recover(const char* snapshotPath, const char* logPath);
+
+
+/* Description:   A new city is added to the planet, as a kingdom of its own.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        city - The ID of the new city, which is the number of cities before the addition.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL or city==NULL.
+ *                FAILURE - If a transaction is in progress or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   AddCity(void* DS, int* city);
+
+
 /* Description:   A citizen was added to the planet.
  * Input:         DS - A pointer to the data structure.
  *                citizenID - The ID of the citizen.
@@ -72,6 +174,55 @@ StatusType   AddCitizen(void* DS, int citizenID);
 StatusType   MoveToCity(void* DS, int citizenID, int city);
 
 
+/* Description:   A citizen with ID citizenID leaves the planet, and the city in which the citizen lived shrinks.
+ * Input:         DS - A pointer to the data structure.
+ *                citizenID - The ID of the citizen.
+ * Output:        None.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL or citizenID<0.
+ *                FAILURE - If there is no citizen in the planet with this ID, a transaction is in progress or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   RemoveCitizen(void* DS, int citizenID);
+
+
+/* Description:   Moves count citizens to cities, as if MoveToCity was called for each of them in order.
+ *                Every city is repositioned once however many citizens moved into it, so this is
+ *                considerably faster than calling MoveToCity count times.
+ *                The capitals end up as after the calls, but their changes are coalesced: every city
+ *                that grows makes at most one change of its kingdom's capital, from the capital before
+ *                the batch to the one after it, so the subscribers (see SubscribeCapitalChanges) are
+ *                called once per city rather than once per move, and the capitals a kingdom had only
+ *                in between, and their versions (see GetChangesSince), are never seen.
+ * Input:         DS - A pointer to the data structure.
+ *                citizenIDs - The identifiers of the citizens.
+ *                cities - The city of the i-th citizen.
+ *                count - The number of moves.
+ * Output:        statuses - An array of size count where the Return Value of MoveToCity for the i-th
+ *                move will be written. After an allocation error the moves into the cities which were
+ *                not yet repositioned are undone, and every move of their citizens has the status
+ *                ALLOCATION_ERROR, so the planet is as if only the other moves were made.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL, count<0 or any of the arrays is NULL.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   MoveToCityBatch(void* DS, const int citizenIDs[], const int cities[], int count, StatusType statuses[]);
+
+
+/* Description:   A citizen with ID citizenID moves to live in city, leaving the city in which the citizen lived, if any.
+ * Input:         DS - A pointer to the data structure.
+ *                citizenID - The ID of the citizen.
+ *                city - The ID of the city.
+ * Output:        None.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL, citizenID<0 or city is an illegal city number.
+ *                FAILURE - If there is no citizen in the planet with this ID, a transaction is in progress or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   RelocateCitizen(void* DS, int citizenID, int city);
+
+
 /* Description:   Joins two kingdoms of city1 and city2 together.
  *				  This can happen only if the cities are the kingdoms' capitals.
  * Input:         DS - A pointer to the data structure.
@@ -101,6 +252,62 @@ StatusType   JoinKingdoms(void* DS, int city1, int city2);
 StatusType   GetCapital(void* DS, int citizenID, int* capital);
 
 
+/* Description:   Returns the capitals of the kingdoms in which count citizens live, as if GetCapital
+ *                was called for each of them. Independent lookups are interleaved, so this is
+ *                considerably faster than calling GetCapital count times.
+ * Input:         DS - A pointer to the data structure.
+ *                citizenIDs - The identifiers of the citizens.
+ *                count - The number of citizens.
+ * Output:        capitals - An array of size count where the capital of the i-th citizen will be written.
+ *                statuses - An array of size count where the Return Value of GetCapital for the i-th
+ *                citizen will be written. capitals[i] is valid only if statuses[i]==SUCCESS.
+ * Return Values: INVALID_INPUT - If DS==NULL, count<0 or any of the arrays is NULL.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetCapitalBatch(void* DS, const int citizenIDs[], int count, int capitals[], StatusType statuses[]);
+
+
+/* Description:   The calls of the citizens with 64-bit citizen IDs. Each one does the same as the call
+ *                of the same name without the 64 suffix, to which it is equivalent for IDs that fit
+ *                an int, so both kinds of calls may be mixed on the same citizens. A citizen takes
+ *                no more memory for a 64-bit ID than for an int one.
+ * Input:         DS - A pointer to the data structure.
+ *                citizenID, citizenIDs - The 64-bit IDs of the citizens.
+ *                city, cities, count - As in the call without the suffix.
+ * Output:        capital, capitals, statuses - As in the call without the suffix.
+ * Return Values: As in the call without the suffix.
+ */
+StatusType   AddCitizen64(void* DS, long long citizenID);
+StatusType   MoveToCity64(void* DS, long long citizenID, int city);
+StatusType   RemoveCitizen64(void* DS, long long citizenID);
+StatusType   MoveToCityBatch64(void* DS, const long long citizenIDs[], const int cities[], int count, StatusType statuses[]);
+StatusType   RelocateCitizen64(void* DS, long long citizenID, int city);
+StatusType   GetCapital64(void* DS, long long citizenID, int* capital);
+StatusType   GetCapitalBatch64(void* DS, const long long citizenIDs[], int count, int capitals[], StatusType statuses[]);
+
+
+/* Description:   Imports a CSV file with a row of "citizenID,city" on every line (a header line, empty lines
+ *                and spaces around the numbers are allowed), as if AddCitizen64(citizenID) and then
+ *                MoveToCity64(citizenID, city) were called for every row in order, ignoring their errors.
+ *                The file is parsed by a thread per core and every city that grows is resized once, so
+ *                the import is much faster than the calls, and the planet ends up exactly as after them.
+ *                The subscribers to the changes of the capitals are called once for every city that grows
+ *                and changes its kingdom's capital. After an allocation error the citizens who moved into
+ *                the cities which were not resized yet move back (all of them, if many cities grew), so
+ *                only part of the rows is imported.
+ * Input:         DS - A pointer to the data structure.
+ *                path - The path of the file.
+ * Output:        rows - The number of rows in the file.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL, path==NULL or rows==NULL.
+ *                FAILURE - If the file cannot be read or has a line which is not a row, in which case nothing
+ *                is imported, if a transaction is in progress or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   ImportCitizens(void* DS, const char* path, long long* rows);
+
+
 /* Description:   Returns the city ranked in the k-th place when all the cities in the planet are ordered by size.
  * Input:         DS - A pointer to the data structure.
  *                k - The rank.
@@ -122,6 +329,416 @@ StatusType   SelectCity(void* DS, int k, int* city);
  */
 StatusType   GetCitiesBySize(void* DS, int results[]);
 
+
+/* Description:   Returns the k largest cities, from the largest one.
+ * Input:         DS - A pointer to the data structure.
+ *                k - The number of cities.
+ * Output:        results - An array of size k where the cities will be written.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL, k<0 or results==NULL.
+ *                FAILURE - If k>n or in case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetTopCities(void* DS, int k, int results[]);
+
+
+/* Description:   Returns the cities ranked from-th to to-th (0-based, inclusive) by size, ranked from the
+ *                smallest as in SelectCity if ascending is not 0, or from the largest otherwise.
+ * Input:         DS - A pointer to the data structure.
+ *                from, to - The range of ranks.
+ *                ascending - The direction of the ranking.
+ * Output:        results - An array of size to-from+1 where the cities will be written, the from-th first.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL, from<0, to<from or results==NULL.
+ *                FAILURE - If to>=n or in case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetCitiesInRankRange(void* DS, int from, int to, int ascending, int results[]);
+
+
+/* Description:   Returns the cities of the kingdom to which city belongs.
+ * Input:         DS - A pointer to the data structure.
+ *                city - The identifier of a city in the kingdom.
+ * Output:        cities - An array of size n where the cities of the kingdom will be written.
+ *                count - The number of cities written to cities.
+ * Return Values: INVALID_INPUT - If DS==NULL, cities==NULL, count==NULL or city is an illegal city number.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetKingdomCities(void* DS, int city, int cities[], int* count);
+
+
+/* Description:   Returns the number of cities in the kingdom to which city belongs.
+ * Input:         DS - A pointer to the data structure.
+ *                city - The identifier of a city in the kingdom.
+ * Output:        size - The number of cities in the kingdom.
+ * Return Values: INVALID_INPUT - If DS==NULL, size==NULL or city is an illegal city number.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetKingdomSize(void* DS, int city, int* size);
+
+
+/* Description:   Returns the number of citizens living in the kingdom to which city belongs.
+ * Input:         DS - A pointer to the data structure.
+ *                city - The identifier of a city in the kingdom.
+ * Output:        population - The number of citizens in the kingdom.
+ * Return Values: INVALID_INPUT - If DS==NULL, population==NULL or city is an illegal city number.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetKingdomPopulation(void* DS, int city, int* population);
+
+
+/* Description:   Returns a page of the citizens living in city: the offset-th to the (offset+max-1)-th
+ *                citizens of the city's resident list. The list is in no particular order, and it only
+ *                changes when a citizen joins or leaves the city, so reading it page after page (until
+ *                fewer than max citizens are returned) gives every resident once if the city does not
+ *                change meanwhile. The time is proportional to the page, not to the planet.
+ * Input:         DS - A pointer to the data structure.
+ *                city - The identifier of the city.
+ *                offset - The place in the list of the first citizen to return.
+ *                max - The number of citizens that fit in residents.
+ * Output:        residents - The IDs of the citizens.
+ *                count - The number of citizens written to residents.
+ * Return Values: INVALID_INPUT - If DS==NULL, residents==NULL, count==NULL, offset<0, max<0 or city is an
+ *                illegal city number.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetCityResidents(void* DS, int city, int offset, long long residents[], int max, int* count);
+
+
+/* Description:   Returns the number of kingdoms in the planet.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        count - The number of kingdoms.
+ * Return Values: INVALID_INPUT - If DS==NULL or count==NULL.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetNumberOfKingdoms(void* DS, int* count);
+
+
+/* Description:   Returns the capital of the kingdom ranked in the k-th place when all the kingdoms
+ *                in the planet are ordered by population (and by their capitals for equal populations).
+ * Input:         DS - A pointer to the data structure.
+ *                k - The rank.
+ * Output:        capital - The identifier of the k-th kingdom's capital.
+ * Return Values: INVALID_INPUT - If DS==NULL, k<0 or capital==NULL.
+ *                FAILURE - If there is no kingdom in the required rank or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   SelectKingdom(void* DS, int k, int* capital);
+
+
+/* Description:   Returns the capitals of all the kingdoms ranked by the kingdoms' populations.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        results - An array of size n where the capitals will be written.
+ *                count - The number of kingdoms written to results.
+ * Return Values: INVALID_INPUT - If DS==NULL, results==NULL or count==NULL.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetKingdomsByPopulation(void* DS, int results[], int* count);
+
+
+/* Description:   Returns the city ranked in the k-th place when the cities of the kingdom to which
+ *                city belongs are ordered from the largest to the smallest (ties by ID), thus the
+ *                capital is ranked in the 0-th place.
+ * Input:         DS - A pointer to the data structure.
+ *                city - The identifier of a city in the kingdom.
+ *                k - The rank.
+ * Output:        result - The identifier of the k-th city.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL, result==NULL, k<0 or city is an illegal city number.
+ *                FAILURE - If there is no city in the required rank.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   SelectCityInKingdom(void* DS, int city, int k, int* result);
+
+
+/* Description:   Returns the cities of the kingdom to which city belongs, from the largest to the smallest.
+ * Input:         DS - A pointer to the data structure.
+ *                city - The identifier of a city in the kingdom.
+ * Output:        results - An array of size n where the cities of the kingdom will be written.
+ *                count - The number of cities written to results.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL, results==NULL, count==NULL or city is an illegal city number.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetKingdomCitiesBySize(void* DS, int city, int results[], int* count);
+
+
+/* Description:   Returns the cities whose size or capital changed since version, each one once, so that
+ *                a copy of the ranking can be kept up to date. When the capital of a kingdom changes,
+ *                all the cities of the kingdom are returned. Only the last changes are kept, so a copy
+ *                that is too old should read the whole ranking again (see GetCitiesBySize).
+ *                MoveToCityBatch and ImportCitizens make one change for every city that grows,
+ *                however many citizens moved into it.
+ * Input:         DS - A pointer to the data structure.
+ *                version - The version returned by the previous call, or -1 to only read the current
+ *                version.
+ * Output:        cities - An array of size n where the changed cities will be written.
+ *                count - The number of cities written to cities.
+ *                newVersion - The current version.
+ * Return Values: INVALID_INPUT - If DS==NULL, cities==NULL, count==NULL, newVersion==NULL, version<-1
+ *                or version is newer than the current version.
+ *                FAILURE - If some of the changes since version are no longer kept, or in case of
+ *                any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetChangesSince(void* DS, long long version, int cities[], int* count,
+		long long* newVersion);
+
+
+/* Description:   Writes the planet to a snapshot file in a compact binary format, from which
+ *                LoadSnapshot restores it. The file at path is replaced only once the snapshot is
+ *                completely written and flushed to the disk.
+ * Input:         DS - A pointer to the data structure.
+ *                path - The path of the snapshot file.
+ * Output:        None.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL or path==NULL.
+ *                FAILURE - If a transaction is in progress, the file cannot be written or in case
+ *                of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   SaveSnapshot(void* DS, const char* path);
+
+
+/* Description:   Starts recording every successful update of the planet in a write-ahead log, from
+ *                which Recover restores the planet. The records (16 bytes each) are written and
+ *                flushed to the disk (fsync) together once groupSize of them are waiting, or once the
+ *                oldest waiting record is groupMilliseconds old (watched by a thread of the log, so
+ *                even the last update of a burst waits no longer), so a crash loses at most the
+ *                waiting records. JoinKingdoms calls made during a
+ *                transaction are recorded once it is committed.
+ *                If the log exists, it must end with the last update of the planet (e.g. the planet
+ *                was recovered from it), and the records are added to it.
+ *                If a record cannot be written, the update is still made but returns FAILURE, and
+ *                the record is written again with the next group. The memory for every record is
+ *                taken before the update is counted; only if there is no memory for it even then is
+ *                the record lost, after which the updates return FAILURE until StopLog is called.
+ * Input:         DS - A pointer to the data structure.
+ *                path - The path of the log.
+ *                groupSize - The number of records flushed together, or 1 to flush every update.
+ *                groupMilliseconds - The time a record may wait to be flushed, or 0 for no limit.
+ * Output:        None.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL or path==NULL.
+ *                FAILURE - If a log was already started, the log cannot be opened, it does not end
+ *                with the last update, or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   StartLog(void* DS, const char* path, int groupSize, int groupMilliseconds);
+
+
+/* Description:   Flushes the waiting records of the log to the disk.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        None.
+ * Return Values: INVALID_INPUT - If DS==NULL.
+ *                FAILURE - If no log was started, the records cannot be written or in case of any
+ *                other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   FlushLog(void* DS);
+
+
+/* Description:   Flushes the log and stops recording the updates. Quit stops the log as well.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        None.
+ * Return Values: INVALID_INPUT - If DS==NULL.
+ *                FAILURE - If no log was started, the waiting records cannot be written (they are
+ *                lost) or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   StopLog(void* DS);
+
+
+/* Description:   Starts a what-if transaction. Until it is committed or rolled back, JoinKingdoms
+ *                calls can be undone, and all the queries reflect them.
+ *                The other updates (e.g. AddCitizen) fail during a transaction.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        None.
+ * Return Values: INVALID_INPUT - If DS==NULL.
+ *                FAILURE - If a transaction is already in progress or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   BeginTransaction(void* DS);
+
+
+/* Description:   Ends the current transaction while keeping the kingdoms joined during it.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        None.
+ * Return Values: INVALID_INPUT - If DS==NULL.
+ *                FAILURE - If there is no transaction in progress or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   CommitTransaction(void* DS);
+
+
+/* Description:   Ends the current transaction and undoes all the kingdoms joined during it,
+ *                restoring their capitals.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        None.
+ * Return Values: INVALID_INPUT - If DS==NULL.
+ *                FAILURE - If there is no transaction in progress or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   RollbackTransaction(void* DS);
+
+
+/* Description:   Renumbers the cities internally so that the cities of every kingdom are stored
+ *                contiguously, which speeds up operations on whole kingdoms.
+ *                The identifiers of the cities do not change.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        None.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL.
+ *                FAILURE - If a transaction is in progress or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   CompactCities(void* DS);
+
+
+/* Description:   Makes JoinKingdoms compact the cities by itself once the cities joined into
+ *                non-contiguous kingdoms since the last compaction reach percent percents of n.
+ * Input:         DS - A pointer to the data structure.
+ *                percent - The threshold, or 0 to never compact automatically (the default).
+ * Output:        None.
+ * Return Values: INVALID_INPUT - If DS==NULL or percent<0.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   SetCompactionThreshold(void* DS, int percent);
+
+
+/* Description:   Publishes an immutable copy of the ranking of the cities by size, which the
+ *                Published queries below read without any lock, so that long readers neither block
+ *                the updates nor wait for them. The previous copy is freed once its last reader is
+ *                done.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        version - The version of the planet which the copy holds, as GetChangesSince
+ *                counts it.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL or version==NULL.
+ *                FAILURE - In case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   PublishRanking(void* DS, long long* version);
+
+
+/* Description:   Makes the updates publish the ranking by themselves (as PublishRanking) once the
+ *                sizes of the cities changed interval times since it was last published, and
+ *                publishes it now. Each publication takes O(n).
+ * Input:         DS - A pointer to the data structure.
+ *                interval - The number of changes, or 0 to publish only by PublishRanking (the
+ *                default).
+ * Output:        None.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL or interval<0.
+ *                FAILURE - In case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   SetPublishInterval(void* DS, int interval);
+
+
+/* Description:   The queries of the published ranking, which may be called concurrently with any
+ *                other call but Quit, with no lock. Each returns the version of the copy it read,
+ *                which tells how stale it is (GetChangesSince from that version returns the cities
+ *                changed since).
+ *                SelectPublishedCity - The city ranked in the k-th place, as SelectCity.
+ *                GetPublishedCitiesBySize - All the cities ranked by size, as GetCitiesBySize, and
+ *                their number.
+ *                GetPublishedRank - The rank of city, in the order of SelectCity.
+ *                CountPublishedCitiesBelow - The number of cities of less than size citizens.
+ * Input:         DS - A pointer to the data structure.
+ *                k, city, size - As described above.
+ * Output:        city, results, count, rank - The answer.
+ *                version - The version of the copy.
+ * Return Values: INVALID_INPUT - If DS==NULL, a pointer is NULL, k<0, city<0 or size<0.
+ *                FAILURE - If no ranking was published, k or city are not in the published ranking,
+ *                or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   SelectPublishedCity(void* DS, int k, int* city, long long* version);
+StatusType   GetPublishedCitiesBySize(void* DS, int results[], int* count, long long* version);
+StatusType   GetPublishedRank(void* DS, int city, int* rank, long long* version);
+StatusType   CountPublishedCitiesBelow(void* DS, int size, int* count, long long* version);
+
+
+/* Description:   Makes the data structure safe to use from several threads at once. The calls which
+ *                only read it (SelectCity, GetCitiesBySize, GetTopCities, GetCitiesInRankRange,
+ *                GetCapital, GetCapitalBatch, their 64-bit versions, GetCityResidents and GetStats) run
+ *                concurrently with each other, while every other call runs alone: it waits for the
+ *                running calls to end, and the calls made while it waits wait for it.
+ *                MakeThreadSafe itself must be called before DS is shared between threads, and Quit
+ *                after all the threads are done with it.
+ * Input:         DS - A pointer to the data structure.
+ * Output:        None.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL.
+ *                FAILURE - If DS is already thread-safe or in case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   MakeThreadSafe(void* DS);
+
+/* Description:   Registers a callback that is called whenever the capital of a kingdom changes, so
+ *                that clients are told of the changes instead of polling GetCapital. A capital
+ *                changes when a city of the kingdom grows past it or it shrinks below another city
+ *                (MoveToCity, MoveToCityBatch, RemoveCitizen, RelocateCitizen), when the kingdom is
+ *                joined into another whose capital is kept (JoinKingdoms), and when a transaction
+ *                is rolled back. MoveToCityBatch and ImportCitizens coalesce the changes: they call
+ *                the callback at most once for every city that grows, with the net change of its
+ *                kingdom's capital, rather than once for every move. The callback gets:
+ *                context - The context given here, as is.
+ *                kingdom - A city of the kingdom whose capital changed (every citizen of the
+ *                kingdom whose capital was oldCapital now has newCapital).
+ *                oldCapital, newCapital - The capital before and after the change.
+ *                version - The version after the change, as GetChangesSince returns it.
+ *                The callback is called during the update, while DS is locked if it is
+ *                thread-safe, so it must be quick and must not call any function on DS.
+ * Input:         DS - A pointer to the data structure.
+ *                callback - The function to call.
+ *                context - A pointer to pass to the callback.
+ * Output:        subscription - The identifier of the subscription, for UnsubscribeCapitalChanges.
+ * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+ *                INVALID_INPUT - If DS==NULL, callback==NULL or subscription==NULL.
+ *                FAILURE - In case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   SubscribeCapitalChanges(void* DS, CapitalCallback callback, void* context, int* subscription);
+
+
+/* Description:   Cancels a subscription made by SubscribeCapitalChanges. Its callback is not called
+ *                after UnsubscribeCapitalChanges returns.
+ * Input:         DS - A pointer to the data structure.
+ *                subscription - The identifier of the subscription.
+ * Output:        None.
+ * Return Values: INVALID_INPUT - If DS==NULL or there is no such subscription.
+ *                FAILURE - In case of any other error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   UnsubscribeCapitalChanges(void* DS, int subscription);
+
+
+/* Description:   Returns the structural counters of the containers and the memory used by every part
+ *                of the data structure. The counters cost nothing unless the library is compiled with
+ *                WET2_STATS defined, and otherwise stay 0 (countersEnabled tells which). They count
+ *                the work of this data structure alone since Init, every part in counters of its own
+ *                (citizensTrees and rankingTrees), so compare two calls to measure an interval. The memory is the bytes allocated; the arrays of the cities are
+ *                allocated at their capacity but their pages take memory only once used (see Init),
+ *                so citiesBytes and kingdomsBytes are upper bounds.
+ *                GetStats only reads the data structure, as GetCapital (see MakeThreadSafe).
+ * Input:         DS - A pointer to the data structure.
+ * Output:        stats - The statistics.
+ * Return Values: INVALID_INPUT - If DS==NULL or stats==NULL.
+ *                FAILURE - In case of an error.
+ *                SUCCESS - Otherwise.
+ */
+StatusType   GetStats(void* DS, PlanetStats* stats);
+
 /* Description:   Quits and deletes the database.
  *                The variable pointed by DS should be set to NULL.
  * Input:         DS - A pointer to the data structure.
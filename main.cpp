@@ -1,8 +1,17 @@
 #include "hashTable.h"
 #include "tree.h"
 #include "unionFind.h"
+#include "concurrentUnionFind.h"
+#include "library2.h"
+#include "cityRanking.h"
 
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <mutex>
 using std::cout;
 using std::cin;
 using std::endl;
@@ -77,3 +86,1889 @@ int treeMain() {
 	*/
 	return 0;
 }
+
+/* Stress test of ConcurrentUnionFind:
+ * 1. Several threads union random pairs concurrently while readers record
+ *    pairs they saw in the same set. In the end the sets must equal the ones
+ *    a sequential UnionFind builds from the same unions, and every recorded
+ *    pair must still be in the same set (sets never split).
+ * 2. A single writer merges sets labeling them with the larger of their two
+ *    labels, so labels only grow. Every reader must see the label of a fixed
+ *    element never decrease (a decrease is a non-linearizable read).
+ */
+int concurrentUFMain() {
+	const int n = 100000, threads = 4, unions = 50000, samples = 1000;
+	ConcurrentUnionFind uf(n);
+	int* pairs = new int[2 * threads * unions];
+	int* seen = new int[2 * threads * samples];
+	std::thread* workers = new std::thread[2 * threads];
+	bool ok = true;
+
+	for (int i = 0; i < 2 * threads * unions; i++) {
+		pairs[i] = rand() % n;
+	}
+	for (int t = 0; t < threads; t++) {
+		workers[t] = std::thread([&, t]() {
+			for (int i = 0; i < unions; i++) {
+				int x = pairs[2 * (t * unions + i)];
+				int y = pairs[2 * (t * unions + i) + 1];
+				uf.Union(x, y, x);
+			}
+		});
+		workers[threads + t] = std::thread([&, t]() {
+			unsigned int seed = t;
+			int found = 0;
+			while (found < samples) {
+				int x = rand_r(&seed) % n, y = rand_r(&seed) % n;
+				if (uf.Find(x) == uf.Find(y)) {
+					seen[2 * (t * samples + found)] = x;
+					seen[2 * (t * samples + found) + 1] = y;
+					found++;
+				}
+			}
+		});
+	}
+	for (int t = 0; t < 2 * threads; t++) {
+		workers[t].join();
+	}
+	int* data = new int[n];
+	UnionFind<int> sequential(n, data);
+	for (int i = 0; i < threads * unions; i++) {
+		int x = sequential.Find(pairs[2 * i]);
+		int y = sequential.Find(pairs[2 * i + 1]);
+		sequential.Union(x, y);
+	}
+	for (int i = 0; i < n && ok; i++) {
+		int x = rand() % n;
+		ok = (uf.Find(i) == uf.Find(x))
+				== (sequential.Find(i) == sequential.Find(x));
+	}
+	for (int i = 0; i < threads * samples && ok; i++) {
+		ok = uf.Find(seen[2 * i]) == uf.Find(seen[2 * i + 1]);
+	}
+	cout << "concurrent unions: " << (ok ? "SUCCESS" : "FAILURE") << endl;
+
+	ConcurrentUnionFind labeled(n);
+	std::atomic<bool> done(false);
+	std::atomic<bool> monotonic(true);
+	for (int t = 0; t < threads; t++) {
+		workers[t] = std::thread([&, t]() {
+			int x = t, last = -1;
+			while (!done.load()) {
+				int label = labeled.Label(x);
+				if (label < last) {
+					monotonic.store(false);
+				}
+				last = label;
+			}
+		});
+	}
+	for (int i = 0; i < threads * unions; i++) {
+		int x = pairs[2 * i], y = pairs[2 * i + 1];
+		int labelX = labeled.Label(x), labelY = labeled.Label(y);
+		labeled.Union(x, y, labelX > labelY ? labelX : labelY);
+	}
+	done.store(true);
+	for (int t = 0; t < threads; t++) {
+		workers[t].join();
+	}
+	cout << "linearizable labels: "
+			<< (monotonic.load() ? "SUCCESS" : "FAILURE") << endl;
+
+	delete[] data;
+	delete[] workers;
+	delete[] seen;
+	delete[] pairs;
+	return ok && monotonic.load() ? 0 : 1;
+}
+
+/* Measures the throughput of GetCapital as the number of reading threads
+ * grows, while one thread keeps joining kingdoms.
+ */
+int getCapitalBenchMain() {
+	const int n = 1000000, citizens = 1000000, queries = 2000000;
+	void* DS = Init(n);
+	for (int i = 0; i < citizens; i++) {
+		AddCitizen(DS, i);
+		MoveToCity(DS, i, rand() % n);
+	}
+	for (int threads = 1; threads <= 8; threads *= 2) {
+		std::atomic<bool> done(false);
+		std::thread joiner([&]() {
+			int city = 0;
+			while (!done.load() && city + 1 < n) {
+				int capital1, capital2;
+				GetCapital(DS, city, &capital1);
+				GetCapital(DS, city + 1, &capital2);
+				JoinKingdoms(DS, capital1, capital2);
+				city += 2;
+			}
+		});
+		std::thread* readers = new std::thread[threads];
+		std::chrono::steady_clock::time_point start =
+				std::chrono::steady_clock::now();
+		for (int t = 0; t < threads; t++) {
+			readers[t] = std::thread([&, t]() {
+				unsigned int seed = t;
+				int capital;
+				for (int i = 0; i < queries; i++) {
+					GetCapital(DS, rand_r(&seed) % citizens, &capital);
+				}
+			});
+		}
+		for (int t = 0; t < threads; t++) {
+			readers[t].join();
+		}
+		double seconds = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+		done.store(true);
+		joiner.join();
+		delete[] readers;
+		cout << threads << " threads: " << threads * queries / seconds
+				<< " GetCapital/s" << endl;
+	}
+	Quit(&DS);
+	return 0;
+}
+
+/* Compares the throughput of GetCapitalBatch with single GetCapital calls
+ * on a planet that is much larger than the cache.
+ */
+int getCapitalBatchBenchMain() {
+	const int n = 2000000, citizens = 4000000, queries = 4000000;
+	const int batch = 1024;
+	void* DS = Init(n);
+	for (int i = 0; i < citizens; i++) {
+		AddCitizen(DS, i);
+		MoveToCity(DS, i, rand() % n);
+	}
+	for (int i = 0; i + 1 < n; i += 2) {
+		int capital1, capital2;
+		GetCapital(DS, i, &capital1);
+		GetCapital(DS, i + 1, &capital2);
+		JoinKingdoms(DS, capital1, capital2);
+	}
+	int* ids = new int[queries];
+	int* capitals = new int[queries];
+	StatusType* statuses = new StatusType[queries];
+	for (int i = 0; i < queries; i++) {
+		ids[i] = rand() % citizens;
+	}
+
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	for (int i = 0; i < queries; i++) {
+		statuses[i] = GetCapital(DS, ids[i], capitals + i);
+	}
+	double single = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < queries; i += batch) {
+		int count = (i + batch < queries) ? batch : queries - i;
+		GetCapitalBatch(DS, ids + i, count, capitals + i, statuses + i);
+	}
+	double batched = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	cout << "GetCapital: " << queries / single << "/s, GetCapitalBatch: "
+			<< queries / batched << "/s" << endl;
+
+	delete[] statuses;
+	delete[] capitals;
+	delete[] ids;
+	Quit(&DS);
+	return 0;
+}
+
+// replays a MoveToCity-dominated trace on a planet ranked by @ranking, and
+// returns the time it took in seconds.
+static double rankingTrace(RankingType ranking, int n, int citizens,
+		const int* cities, int queries) {
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	void* DS = InitWithRanking(n, ranking);
+	long long checksum = 0;
+	for (int i = 0; i < citizens; i++) {
+		AddCitizen(DS, i);
+		MoveToCity(DS, i, cities[i]);
+		if (i % (citizens / queries) == 0) {
+			int city;
+			SelectCity(DS, i % n, &city);
+			checksum += city;
+		}
+	}
+	for (int i = 0; i < citizens; i += 4) { // some citizens move again
+		RelocateCitizen(DS, i, cities[citizens - 1 - i]);
+	}
+	Quit(&DS);
+	double seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	cout << (ranking == RANKING_TREE ? "tree" : "buckets") << ": "
+			<< seconds << "s (checksum " << checksum << ")" << endl;
+	return seconds;
+}
+
+int rankingBenchMain() {
+	const int n = 1000000, citizens = 4000000, queries = 100000;
+	int* cities = new int[citizens];
+	for (int i = 0; i < citizens; i++) { // a few large cities, many small
+		cities[i] = (rand() % 4 == 0) ? rand() % 100 : rand() % n;
+	}
+	double tree = rankingTrace(RANKING_TREE, n, citizens, cities, queries);
+	double buckets = rankingTrace(RANKING_BUCKETS, n, citizens, cities,
+			queries);
+	cout << "buckets/tree speedup: " << tree / buckets << endl;
+	delete[] cities;
+	return 0;
+}
+
+/* Compares restoring a planet from a snapshot with replaying the commands
+ * that built it.
+ */
+int snapshotBenchMain() {
+	const int n = 1000000, citizens = 4000000;
+	const char* path = "snapshotBench.snap";
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	void* DS = Init(n);
+	for (int i = 0; i < citizens; i++) {
+		AddCitizen(DS, i);
+		MoveToCity(DS, i, rand() % n);
+	}
+	for (int i = 0; i + 1 < n; i += 2) {
+		int capital1, capital2;
+		GetCapital(DS, i, &capital1);
+		GetCapital(DS, i + 1, &capital2);
+		JoinKingdoms(DS, capital1, capital2);
+	}
+	double replay = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	if (SaveSnapshot(DS, path) != SUCCESS) {
+		cout << "SaveSnapshot failed" << endl;
+		Quit(&DS);
+		return 1;
+	}
+	double save = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	void* restored = LoadSnapshot(path);
+	double load = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	cout << "replay: " << replay << "s, SaveSnapshot: " << save
+			<< "s, LoadSnapshot: " << load << "s" << endl;
+	Quit(&restored);
+	Quit(&DS);
+	remove(path);
+	return 0;
+}
+
+/* Returns the time of @citizens citizens added and moved to random cities,
+ * logged to @path in groups of @groupSize records (or not logged if @path is
+ * NULL).
+ */
+static double logTrace(const char* path, int groupSize, int n, int citizens) {
+	void* DS = Init(n);
+	if (path && StartLog(DS, path, groupSize, 0) != SUCCESS) {
+		Quit(&DS);
+		return -1;
+	}
+	srand(1);
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	for (int i = 0; i < citizens; i++) {
+		AddCitizen(DS, i);
+		MoveToCity(DS, i, rand() % n);
+	}
+	if (path) {
+		StopLog(DS);
+	}
+	double time = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	Quit(&DS);
+	return time;
+}
+
+int writeAheadLogBenchMain() {
+	const int n = 100000, citizens = 20000;
+	const char* snapshotPath = "logBench.snap";
+	const char* logPath = "logBench.log";
+	cout << "updates per second:" << endl;
+	cout << "in memory: " << 2 * citizens / logTrace(NULL, 0, n, citizens)
+			<< endl;
+	const int groupSizes[] = { 1, 16, 256, 4096 };
+	for (int i = 0; i < 4; i++) {
+		remove(logPath);
+		cout << "logged, groups of " << groupSizes[i] << ": "
+				<< 2 * citizens / logTrace(logPath, groupSizes[i], n, citizens)
+				<< endl;
+	}
+	// recovery replays the log written after an empty snapshot
+	remove(logPath);
+	void* DS = Init(n);
+	SaveSnapshot(DS, snapshotPath);
+	StartLog(DS, logPath, 4096, 0);
+	for (int i = 0; i < 10 * citizens; i++) {
+		AddCitizen(DS, i);
+		MoveToCity(DS, i, rand() % n);
+	}
+	Quit(&DS);
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	void* recovered = Recover(snapshotPath, logPath);
+	double recover = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	cout << "Recover of " << 20 * citizens << " updates: " << recover << "s"
+			<< (recovered ? "" : " (failed)") << endl;
+	Quit(&recovered);
+	remove(snapshotPath);
+	remove(logPath);
+	return 0;
+}
+
+/* Returns the calls per second of @threads threads making a 95/5 mix of
+ * reads (GetCapital and SelectCity) and writes (RelocateCitizen, and a few
+ * JoinKingdoms) on @DS, all behind one mutex if @serialize is true.
+ */
+static double mixTrace(void* DS, int threads, bool serialize, int n,
+		int citizens, int calls) {
+	std::mutex global;
+	std::thread* workers = new std::thread[threads];
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; t++) {
+		workers[t] = std::thread([&, t]() {
+			unsigned int seed = t + 1;
+			int result;
+			for (int i = 0; i < calls; i++) {
+				int kind = rand_r(&seed) % 100;
+				int citizen = rand_r(&seed) % citizens;
+				int city = rand_r(&seed) % n;
+				std::unique_lock<std::mutex> lock(global, std::defer_lock);
+				if (serialize) {
+					lock.lock();
+				}
+				if (kind < 70) {
+					GetCapital(DS, citizen, &result);
+				} else if (kind < 95) {
+					SelectCity(DS, city, &result);
+				} else if (kind < 99) {
+					RelocateCitizen(DS, citizen, city);
+				} else {
+					int capital;
+					GetCapital(DS, citizen, &capital);
+					GetCapital(DS, (citizen + 1) % citizens, &result);
+					JoinKingdoms(DS, capital, result);
+				}
+			}
+		});
+	}
+	for (int t = 0; t < threads; t++) {
+		workers[t].join();
+	}
+	double seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	delete[] workers;
+	return threads * calls / seconds;
+}
+
+/* Compares a thread-safe planet (see MakeThreadSafe) with a planet behind
+ * one global mutex, on a 95/5 read/write mix.
+ */
+int threadSafeBenchMain() {
+	const int n = 100000, citizens = 400000, calls = 500000;
+	for (int threads = 1; threads <= 8; threads *= 2) {
+		for (int safe = 0; safe < 2; safe++) {
+			void* DS = Init(n);
+			for (int i = 0; i < citizens; i++) {
+				AddCitizen(DS, i);
+				MoveToCity(DS, i, rand() % n);
+			}
+			if (safe) {
+				MakeThreadSafe(DS);
+			}
+			double rate = mixTrace(DS, threads, !safe, n, citizens, calls);
+			cout << threads << " threads, "
+					<< (safe ? "MakeThreadSafe: " : "global mutex: ") << rate
+					<< " calls/s" << endl;
+			Quit(&DS);
+		}
+	}
+	return 0;
+}
+
+/* Compares the queries of the published ranking with the live ones, after
+ * an update made the cached ranking of the cities stale.
+ */
+int publishedRankingBenchMain() {
+	const int n = 1000000, citizens = 2000000, queries = 2000000;
+	void* DS = Init(n);
+	for (int i = 0; i < citizens; i++) {
+		AddCitizen(DS, i);
+		MoveToCity(DS, i, rand() % n);
+	}
+	long long version;
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	PublishRanking(DS, &version);
+	double publish = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	RelocateCitizen(DS, 0, 0);
+	int city, sum = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < queries; i++) {
+		SelectCity(DS, rand() % n, &city);
+		sum += city;
+	}
+	double live = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < queries; i++) {
+		SelectPublishedCity(DS, rand() % n, &city, &version);
+		sum += city;
+	}
+	double published = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < queries; i++) {
+		GetPublishedRank(DS, rand() % n, &city, &version);
+		sum += city;
+	}
+	double rank = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	cout << "PublishRanking: " << publish << "s" << endl;
+	cout << "SelectCity: " << queries / live << "/s" << endl;
+	cout << "SelectPublishedCity: " << queries / published << "/s" << endl;
+	cout << "GetPublishedRank: " << queries / rank << "/s (" << (sum & 1) << ")"
+			<< endl;
+	Quit(&DS);
+	return 0;
+}
+
+int initBenchMain() {
+	const int touched = 1000000;
+	for (int n = 1000000; n <= 100000000; n *= 10) {
+		for (int engine = 0; engine < 2; engine++) {
+			RankingType ranking = engine ? RANKING_BUCKETS : RANKING_TREE;
+			std::chrono::steady_clock::time_point start =
+					std::chrono::steady_clock::now();
+			void* DS = InitWithRanking(n, ranking);
+			double init = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start).count();
+			start = std::chrono::steady_clock::now();
+			for (int i = 0; i < touched; i++) { // the first use of the cities
+				AddCitizen(DS, i);
+				MoveToCity(DS, i, rand() % n);
+			}
+			double use = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start).count();
+			cout << "n=" << n << (engine ? " buckets" : " tree") << ": Init "
+					<< init << "s, " << touched << " moves " << use << "s"
+					<< endl;
+			Quit(&DS);
+		}
+	}
+	return 0;
+}
+
+// the resident memory of the process in bytes, or 0 where /proc is missing
+static long residentBytes() {
+	long pages = 0, resident = 0;
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm) {
+		if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+			resident = 0;
+		}
+		fclose(statm);
+	}
+	return resident * 4096;
+}
+
+int citizenIdBenchMain() {
+	const int citizens = 4000000, n = 1000;
+	void* planets[2]; // both kept until the end, so the memory is not reused
+	for (int wide = 0; wide < 2; wide++) {
+		long before = residentBytes();
+		void* DS = planets[wide] = Init(n);
+		std::chrono::steady_clock::time_point start =
+				std::chrono::steady_clock::now();
+		for (int i = 0; i < citizens; i++) {
+			// 64-bit IDs as a registry hands them out: a time stamp above
+			// a sequence number, which leaves the low bits alike
+			long long id = wide ? ((long long) (1000000 + i) << 22) : i;
+			AddCitizen64(DS, id);
+			MoveToCity64(DS, id, i % n);
+		}
+		double add = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+		long memory = residentBytes() - before;
+		start = std::chrono::steady_clock::now();
+		long long sum = 0;
+		for (int i = 0; i < citizens; i++) {
+			int j = rand() % citizens, capital = 0;
+			GetCapital64(DS, wide ? ((long long) (1000000 + j) << 22) : j,
+					&capital);
+			sum += capital;
+		}
+		double lookup = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+		cout << (wide ? "64-bit IDs: " : "int IDs: ") << citizens / add
+				<< " adds/s, " << citizens / lookup << " GetCapital/s, "
+				<< double(memory) / citizens << " bytes per citizen ("
+				<< (sum & 1) << ")" << endl;
+	}
+	Quit(&planets[0]);
+	Quit(&planets[1]);
+	return 0;
+}
+
+// compile with and without WET2_STATS to compare the cost of the counters
+int statsBenchMain() {
+	const int n = 50000, citizens = 500000;
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	void* DS = Init(n);
+	for (int i = 0; i < citizens; i++) {
+		AddCitizen(DS, i);
+		MoveToCity(DS, i, rand() % n);
+	}
+	for (int i = 0; i < n / 2; i++) {
+		int capital1 = 0, capital2 = 0;
+		GetCapital(DS, rand() % citizens, &capital1);
+		GetCapital(DS, rand() % citizens, &capital2);
+		JoinKingdoms(DS, capital1, capital2);
+	}
+	for (int i = 0; i < citizens; i++) {
+		int capital = 0;
+		GetCapital(DS, rand() % citizens, &capital);
+		RelocateCitizen(DS, rand() % citizens, rand() % n);
+	}
+	double time = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	PlanetStats stats;
+	GetStats(DS, &stats);
+	cout << "workload: " << time << "s, counters "
+			<< (stats.countersEnabled ? "on" : "off") << endl;
+	cout << "tree: " << stats.treeRotations << " rotations, "
+			<< stats.treeFinds << " finds of average depth "
+			<< double(stats.treeFindDepth) / (stats.treeFinds + !stats.treeFinds)
+			<< " (deepest " << stats.treeMaxFindDepth << ")" << endl;
+	cout << "tree finds: citizens " << stats.citizensTrees.finds
+			<< ", rankings " << stats.rankingTrees.finds << "; rotations: citizens "
+			<< stats.citizensTrees.rotations << ", rankings "
+			<< stats.rankingTrees.rotations << endl;
+	cout << "hash table: " << stats.hashReallocations << " reallocations in "
+			<< stats.hashReallocationNanoseconds / 1e9 << "s" << endl;
+	cout << "union find: " << stats.unionFinds << " finds of average path "
+			<< double(stats.unionFindPathLength)
+					/ (stats.unionFinds + !stats.unionFinds) << " (longest "
+			<< stats.unionFindMaxPathLength << ")" << endl;
+	cout << "bytes: citizens " << stats.citizensBytes << ", cities "
+			<< stats.citiesBytes << ", kingdoms " << stats.kingdomsBytes
+			<< ", cities ranking " << stats.citiesRankingBytes
+			<< ", kingdoms ranking " << stats.kingdomsRankingBytes << endl;
+	Quit(&DS);
+	return 0;
+}
+
+// reads every resident of a city of 1000 citizens, in pages, on planets of
+// growing populations, which should take the same time on all of them
+int residentsBenchMain() {
+	const int n = 1000, pageSize = 64, rounds = 100000;
+	for (int citizens = 10000; citizens <= 1000000; citizens *= 10) {
+		void* DS = Init(n);
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(DS, i);
+			MoveToCity(DS, i, i < 1000 ? 0 : 1 + i % (n - 1));
+		}
+		long long page[pageSize];
+		long long sum = 0;
+		std::chrono::steady_clock::time_point start =
+				std::chrono::steady_clock::now();
+		for (int r = 0; r < rounds; r++) {
+			int offset = 0, count = 0;
+			do {
+				GetCityResidents(DS, 0, offset, page, pageSize, &count);
+				for (int j = 0; j < count; j++) {
+					sum += page[j];
+				}
+				offset += count;
+			} while (count == pageSize);
+		}
+		double time = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+		cout << citizens << " citizens: " << time / rounds * 1e6
+				<< " us per listing (" << (sum & 1) << ")" << endl;
+		Quit(&DS);
+	}
+	return 0;
+}
+
+// builds the ranking of GetCitiesBySize after every change of a size, with
+// as many threads as the machine has cores
+int citiesBySizeBenchMain() {
+	const int n = 4000000, citizens = 2000000, rounds = 5;
+	void* DS = Init(n);
+	for (int i = 0; i < citizens; i++) {
+		AddCitizen(DS, i);
+		MoveToCity(DS, i, rand() % n);
+	}
+	int* results = new int[n];
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++) {
+		AddCitizen(DS, citizens + r);
+		MoveToCity(DS, citizens + r, r);
+		GetCitiesBySize(DS, results);
+	}
+	double time = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	cout << std::thread::hardware_concurrency() << " cores: "
+			<< time / rounds * 1e3 << " ms per ranking of " << n
+			<< " cities (" << (results[n - 1] & 1) << ")" << endl;
+	delete[] results;
+	Quit(&DS);
+	return 0;
+}
+
+// writes a CSV of citizens and imports it, against replaying its rows by
+// AddCitizen and MoveToCity
+int importBenchMain() {
+	const int n = 1000000, rows = 5000000;
+	const char* path = "import_bench.csv";
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		return 1;
+	}
+	long long* citizens = new long long[rows];
+	int* cities = new int[rows];
+	for (int i = 0; i < rows; i++) {
+		citizens[i] = ((long long) rand() << 16) ^ rand();
+		cities[i] = rand() % n;
+		fprintf(file, "%lld,%d\n", citizens[i], cities[i]);
+	}
+	fclose(file);
+	for (int import = 0; import < 2; import++) {
+		void* DS = Init(n);
+		std::chrono::steady_clock::time_point start =
+				std::chrono::steady_clock::now();
+		if (import) {
+			long long count = 0;
+			ImportCitizens(DS, path, &count);
+		} else {
+			for (int i = 0; i < rows; i++) {
+				AddCitizen64(DS, citizens[i]);
+				MoveToCity64(DS, citizens[i], cities[i]);
+			}
+		}
+		double time = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+		int capital = 0;
+		GetCapital64(DS, citizens[0], &capital);
+		cout << (import ? "ImportCitizens: " : "replay: ") << time << "s ("
+				<< capital << ")" << endl;
+		Quit(&DS);
+	}
+	remove(path);
+	delete[] citizens;
+	delete[] cities;
+	return 0;
+}
+
+// makes random moves on two planets, by MoveToCityBatch on one and by
+// MoveToCity on the other, where some citizens are unknown and some cities
+// do not exist, and checks that the statuses, the capitals and the ranking
+// of the cities agree, with every ranking engine
+int moveToCityBatchMain() {
+	const int n = 1000, citizens = 5000, batches = 10, moves = 2000;
+	int* citizenIDs = new int[moves];
+	int* cities = new int[moves];
+	StatusType* statuses = new StatusType[moves];
+	int* batchRanking = new int[n];
+	int* sequentialRanking = new int[n];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* batch = InitWithRanking(n, RankingType(ranking));
+		void* sequential = InitWithRanking(n, RankingType(ranking));
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(batch, i);
+			AddCitizen(sequential, i);
+		}
+		for (int i = 0; i < n / 4; i++) {
+			int city1 = rand() % n, city2 = rand() % n;
+			JoinKingdoms(batch, city1, city2);
+			JoinKingdoms(sequential, city1, city2);
+		}
+		bool ok = true;
+		for (int b = 0; b < batches && ok; b++) {
+			for (int i = 0; i < moves; i++) {
+				citizenIDs[i] = rand() % (citizens + citizens / 10)
+						- citizens / 20;
+				cities[i] = rand() % (n + n / 10) - n / 20;
+			}
+			ok = MoveToCityBatch(batch, citizenIDs, cities, moves, statuses)
+					== SUCCESS;
+			for (int i = 0; i < moves && ok; i++) {
+				ok = MoveToCity(sequential, citizenIDs[i], cities[i])
+						== statuses[i];
+			}
+		}
+		for (int i = 0; i < citizens && ok; i++) {
+			int batchCapital = -1, sequentialCapital = -1;
+			ok = GetCapital(batch, i, &batchCapital)
+					== GetCapital(sequential, i, &sequentialCapital)
+					&& batchCapital == sequentialCapital;
+		}
+		GetCitiesBySize(batch, batchRanking);
+		GetCitiesBySize(sequential, sequentialRanking);
+		for (int i = 0; i < n && ok; i++) {
+			ok = batchRanking[i] == sequentialRanking[i];
+		}
+		cout << "batch moves (" << (ranking == RANKING_TREE ? "tree" : "buckets")
+				<< "): " << (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&batch);
+		Quit(&sequential);
+	}
+	delete[] citizenIDs;
+	delete[] cities;
+	delete[] statuses;
+	delete[] batchRanking;
+	delete[] sequentialRanking;
+	return 0;
+}
+
+// ranks cities of random sizes with every ranking engine and checks that
+// parallelRange writes what range does, with 1, 4 and 7 threads
+int parallelRangeMain() {
+	const int n = 7 * CityRanking::PARALLEL_SLICE + 1000;
+	const int threads[] = { 1, 4, 7 };
+	int* expected = new int[n];
+	int* results = new int[n];
+	CityRanking* rankings[] = { new TreeRanking(n), new BucketRanking(n) };
+	for (int r = 0; r < 2; r++) {
+		for (int i = 0; i < n; i++) {
+			rankings[r]->resize(i, 0, rand() % 4 ? rand() % 64 : rand() % n);
+		}
+		bool ok = true;
+		for (int ascending = 0; ascending < 2; ascending++) {
+			// all the cities, and a range that starts in the middle
+			for (int from = 0; from < n; from += n / 3) {
+				rankings[r]->range(from, n - 1, ascending, expected);
+				for (int t = 0; t < 3; t++) {
+					rankings[r]->parallelRange(from, n - 1, ascending, results,
+							threads[t]);
+					for (int i = 0; i < n - from && ok; i++) {
+						ok = results[i] == expected[i];
+					}
+				}
+			}
+		}
+		cout << "parallel range (" << (r == 0 ? "tree" : "buckets") << "): "
+				<< (ok ? "SUCCESS" : "FAILURE") << endl;
+		delete rankings[r];
+	}
+	delete[] expected;
+	delete[] results;
+	return 0;
+}
+
+// writes a CSV of citizens with a header, empty lines, repeated citizens
+// and cities that do not exist, imports it into a planet and replays its
+// rows by AddCitizen64 and MoveToCity64 on another, and checks that the
+// capitals, the ranking of the cities and their residents agree. A short
+// CSV grows few cities and a long one all of them, with every ranking engine.
+int importCitizensMain() {
+	const int n = 1000, lengths[] = { 50, 20000 };
+	const long long stride = 1LL << 40; // IDs beyond 32 bits
+	const char* path = "import_check.csv";
+	int* importedRanking = new int[n];
+	int* replayedRanking = new int[n];
+	long long* importedResidents = new long long[n];
+	long long* replayedResidents = new long long[n];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		for (int l = 0; l < 2; l++) {
+			const int rows = lengths[l], citizens = rows / 2 + 1;
+			void* imported = InitWithRanking(n, RankingType(ranking));
+			void* replayed = InitWithRanking(n, RankingType(ranking));
+			// citizens who live in cities before the import
+			for (int i = 0; i < citizens; i += 3) {
+				int city = rand() % n;
+				AddCitizen64(imported, i * stride);
+				MoveToCity64(imported, i * stride, city);
+				AddCitizen64(replayed, i * stride);
+				MoveToCity64(replayed, i * stride, city);
+			}
+			for (int i = 0; i < n / 4; i++) {
+				int city1 = rand() % n, city2 = rand() % n;
+				JoinKingdoms(imported, city1, city2);
+				JoinKingdoms(replayed, city1, city2);
+			}
+			FILE* file = fopen(path, "w");
+			if (!file) {
+				Quit(&imported);
+				Quit(&replayed);
+				return 1;
+			}
+			fprintf(file, "citizen,city\n");
+			for (int i = 0; i < rows; i++) {
+				long long citizen = (rand() % citizens) * stride;
+				int city = rand() % (n + n / 10) - n / 20;
+				fprintf(file, i % 100 ? "%lld,%d\n" : "%lld, %d\n\n", citizen,
+						city);
+				AddCitizen64(replayed, citizen);
+				MoveToCity64(replayed, citizen, city);
+			}
+			fclose(file);
+			long long count = 0;
+			bool ok = ImportCitizens(imported, path, &count) == SUCCESS
+					&& count == rows;
+			for (int i = 0; i < citizens && ok; i++) {
+				int importedCapital = -1, replayedCapital = -1;
+				ok = GetCapital64(imported, i * stride, &importedCapital)
+						== GetCapital64(replayed, i * stride, &replayedCapital)
+						&& importedCapital == replayedCapital;
+			}
+			GetCitiesBySize(imported, importedRanking);
+			GetCitiesBySize(replayed, replayedRanking);
+			for (int c = 0; c < n && ok; c++) {
+				ok = importedRanking[c] == replayedRanking[c];
+			}
+			for (int c = 0; c < n && ok; c++) {
+				int importedCount = 0, replayedCount = 0;
+				GetCityResidents(imported, c, 0, importedResidents, n,
+						&importedCount);
+				GetCityResidents(replayed, c, 0, replayedResidents, n,
+						&replayedCount);
+				ok = importedCount == replayedCount;
+				for (int i = 0; i < importedCount && ok; i++) {
+					ok = importedResidents[i] == replayedResidents[i];
+				}
+			}
+			cout << "import of " << rows << " rows ("
+					<< (ranking == RANKING_TREE ? "tree" : "buckets") << "): "
+					<< (ok ? "SUCCESS" : "FAILURE") << endl;
+			Quit(&imported);
+			Quit(&replayed);
+		}
+	}
+	remove(path);
+	delete[] importedRanking;
+	delete[] replayedRanking;
+	delete[] importedResidents;
+	delete[] replayedResidents;
+	return 0;
+}
+
+// a naive model of a planet for the checks below: every city keeps a label
+// of its kingdom, and every query scans all the cities
+class PlanetModel {
+public:
+	int n;
+	int citizens;
+	int* kingdom;	// the label of the kingdom of every city
+	int* size;		// the number of citizens of every city
+	int* home;		// the city of every citizen, -1 if none
+	PlanetModel(int n, int citizens) :
+			n(n), citizens(citizens), kingdom(new int[n]), size(new int[n]),
+			home(new int[citizens]) {
+		for (int c = 0; c < n; c++) {
+			kingdom[c] = c;
+			size[c] = 0;
+		}
+		for (int i = 0; i < citizens; i++) {
+			home[i] = -1;
+		}
+	}
+	~PlanetModel() {
+		delete[] kingdom;
+		delete[] size;
+		delete[] home;
+	}
+	// the largest city of the kingdom, the smallest one of equal sizes
+	int capital(int city) const {
+		int capital = -1;
+		for (int c = 0; c < n; c++) {
+			if (kingdom[c] == kingdom[city]
+					&& (capital == -1 || size[c] > size[capital])) {
+				capital = c;
+			}
+		}
+		return capital;
+	}
+	int population(int city) const {
+		int population = 0;
+		for (int c = 0; c < n; c++) {
+			population += kingdom[c] == kingdom[city] ? size[c] : 0;
+		}
+		return population;
+	}
+	int cities(int city) const {
+		int count = 0;
+		for (int c = 0; c < n; c++) {
+			count += kingdom[c] == kingdom[city];
+		}
+		return count;
+	}
+	void join(int city1, int city2) {
+		int label = kingdom[city2];
+		for (int c = 0; c < n; c++) {
+			kingdom[c] = kingdom[c] == label ? kingdom[city1] : kingdom[c];
+		}
+	}
+	// MoveToCity of the citizen, and its status
+	StatusType move(int citizen, int city) {
+		if (home[citizen] != -1 && home[citizen] != city) {
+			return FAILURE;
+		}
+		size[city] += home[citizen] == -1;
+		home[citizen] = city;
+		return SUCCESS;
+	}
+	// RelocateCitizen of the citizen
+	void relocate(int citizen, int city) {
+		leave(citizen);
+		size[city]++;
+		home[citizen] = city;
+	}
+	// the citizen leaves its city, if any, as by RemoveCitizen
+	void leave(int citizen) {
+		if (home[citizen] != -1) {
+			size[home[citizen]]--;
+			home[citizen] = -1;
+		}
+	}	// AddCity, which returns the new city
+	int addCity() {
+		int* newKingdom = new int[n + 1];
+		int* newSize = new int[n + 1];
+		for (int c = 0; c < n; c++) {
+			newKingdom[c] = kingdom[c];
+			newSize[c] = size[c];
+		}
+		delete[] kingdom;
+		delete[] size;
+		kingdom = newKingdom;
+		size = newSize;
+		kingdom[n] = n;
+		size[n] = 0;
+		return n++;
+	}
+};
+
+// joins random kingdoms of cities of random sizes, by their capitals and by
+// other cities, and checks that GetKingdomCities lists every city of the
+// kingdom exactly once, as GetKingdomSize counts them
+int kingdomCitiesMain() {
+	const int n = 300, citizens = 2000;
+	void* planet = Init(n);
+	PlanetModel model(n, citizens);
+	int* cities = new int[n];
+	int* seen = new int[n];
+	for (int i = 0; i < citizens; i++) {
+		int city = rand() % n;
+		AddCitizen(planet, i);
+		MoveToCity(planet, i, city);
+		model.move(i, city);
+	}
+	bool ok = true;
+	for (int round = 0; round < n && ok; round++) {
+		int city1 = rand() % n, city2 = rand() % n;
+		if (rand() % 4) { // mostly capitals, which may be of one kingdom
+			city1 = model.capital(city1);
+			city2 = model.capital(city2);
+		}
+		bool joins = city1 == model.capital(city1)
+				&& city2 == model.capital(city2)
+				&& model.kingdom[city1] != model.kingdom[city2];
+		ok = JoinKingdoms(planet, city1, city2) == (joins ? SUCCESS : FAILURE);
+		if (joins) {
+			model.join(city1, city2);
+		}
+		for (int c = 0; c < n; c++) {
+			seen[c] = 0;
+		}
+		int city = rand() % n, count = -1, size = -1;
+		ok = ok && GetKingdomCities(planet, city, cities, &count) == SUCCESS
+				&& GetKingdomSize(planet, city, &size) == SUCCESS
+				&& count == model.cities(city) && size == count;
+		for (int i = 0; i < count && ok; i++) {
+			ok = cities[i] >= 0 && cities[i] < n && !seen[cities[i]]++
+					&& model.kingdom[cities[i]] == model.kingdom[city];
+		}
+	}
+	cout << "kingdom cities: " << (ok ? "SUCCESS" : "FAILURE") << endl;
+	Quit(&planet);
+	delete[] cities;
+	delete[] seen;
+	return 0;
+}
+
+// moves citizens into random cities and joins random kingdoms, and checks
+// the number of kingdoms, their populations, and GetKingdomsByPopulation and
+// SelectKingdom against the model after every update, with every ranking
+// engine
+int kingdomsByPopulationMain() {
+	const int n = 300, citizens = 3000;
+	int* capitals = new int[n];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* planet = InitWithRanking(n, RankingType(ranking));
+		PlanetModel model(n, citizens);
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(planet, i);
+		}
+		bool ok = true;
+		for (int round = 0; round < 2 * n && ok; round++) {
+			for (int i = 0; i < 5 && ok; i++) {
+				int citizen = rand() % citizens, city = rand() % n;
+				ok = MoveToCity(planet, citizen, city)
+						== model.move(citizen, city);
+			}
+			if (round % 2) {
+				int city1 = model.capital(rand() % n);
+				int city2 = model.capital(rand() % n);
+				if (model.kingdom[city1] != model.kingdom[city2]) {
+					ok = ok && JoinKingdoms(planet, city1, city2) == SUCCESS;
+					model.join(city1, city2);
+				}
+			}
+			// the capitals of the model, ranked as GetKingdomsByPopulation
+			int kingdoms = 0, count = -1;
+			for (int c = 0; c < n; c++) {
+				kingdoms += model.capital(c) == c;
+			}
+			ok = ok && GetNumberOfKingdoms(planet, &count) == SUCCESS
+					&& count == kingdoms
+					&& GetKingdomsByPopulation(planet, capitals, &count)
+							== SUCCESS && count == kingdoms;
+			for (int k = 0; k < count && ok; k++) {
+				int capital = -1;
+				ok = capitals[k] >= 0 && capitals[k] < n
+						&& model.capital(capitals[k]) == capitals[k]
+						&& SelectKingdom(planet, k, &capital) == SUCCESS
+						&& capital == capitals[k];
+				if (ok && k > 0) {
+					int previous = model.population(capitals[k - 1]);
+					int population = model.population(capitals[k]);
+					ok = previous < population || (previous == population
+							&& capitals[k - 1] < capitals[k]);
+				}
+			}
+			int capital = -1, city = rand() % n, population = -1;
+			ok = ok && SelectKingdom(planet, count, &capital) == FAILURE
+					&& GetKingdomPopulation(planet, city, &population)
+							== SUCCESS
+					&& population == model.population(city);
+		}
+		cout << "kingdoms by population ("
+				<< (ranking == RANKING_TREE ? "tree" : "buckets") << "): "
+				<< (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&planet);
+	}
+	delete[] capitals;
+	return 0;
+}
+
+// joins random kingdoms in transactions, of which some are committed and
+// the others rolled back, and checks the planet against the model during
+// every transaction and against a replica, which made only the committed
+// joins, after it. The other updates must fail during a transaction.
+int transactionMain() {
+	const int n = 200, citizens = 2000, transactions = 100;
+	int* saved = new int[n];
+	int* joins = new int[2 * n];
+	int* capitals = new int[n];
+	int* replicaCapitals = new int[n];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* planet = InitWithRanking(n, RankingType(ranking));
+		void* replica = InitWithRanking(n, RankingType(ranking));
+		PlanetModel model(n, citizens);
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(planet, i);
+			AddCitizen(replica, i);
+		}
+		bool ok = true;
+		for (int t = 0; t < transactions && ok; t++) {
+			for (int i = 0; i < 20; i++) {
+				int citizen = rand() % citizens, city = rand() % n;
+				MoveToCity(planet, citizen, city);
+				MoveToCity(replica, citizen, city);
+				model.move(citizen, city);
+			}
+			for (int c = 0; c < n; c++) {
+				saved[c] = model.kingdom[c];
+			}
+			int city = -1, count = 0;
+			ok = BeginTransaction(planet) == SUCCESS
+					&& BeginTransaction(planet) == FAILURE
+					&& MoveToCity(planet, 0, 0) == FAILURE
+					&& RemoveCitizen(planet, 0) == FAILURE
+					&& AddCity(planet, &city) == FAILURE;
+			for (int j = rand() % 10; j > 0 && ok; j--) {
+				int city1 = model.capital(rand() % n);
+				int city2 = model.capital(rand() % n);
+				if (model.kingdom[city1] == model.kingdom[city2]) {
+					continue;
+				}
+				ok = JoinKingdoms(planet, city1, city2) == SUCCESS;
+				model.join(city1, city2);
+				joins[count++] = city1;
+				joins[count++] = city2;
+				for (int i = 0; i < 50 && ok; i++) {
+					int citizen = rand() % citizens, home = model.home[citizen];
+					int capital = -1, population = -1;
+					city = rand() % n;
+					ok = GetCapital(planet, citizen, &capital)
+							== (home == -1 ? FAILURE : SUCCESS)
+							&& (home == -1 || capital == model.capital(home))
+							&& GetKingdomPopulation(planet, city, &population)
+									== SUCCESS
+							&& population == model.population(city);
+				}
+			}
+			if (rand() % 2) {
+				ok = ok && CommitTransaction(planet) == SUCCESS;
+				for (int j = 0; j < count && ok; j += 2) {
+					ok = JoinKingdoms(replica, joins[j], joins[j + 1])
+							== SUCCESS;
+				}
+			} else {
+				ok = ok && RollbackTransaction(planet) == SUCCESS;
+				for (int c = 0; c < n; c++) {
+					model.kingdom[c] = saved[c];
+				}
+			}
+			ok = ok && CommitTransaction(planet) == FAILURE
+					&& RollbackTransaction(planet) == FAILURE;
+			for (int i = 0; i < citizens && ok; i++) {
+				int capital = -1, replicaCapital = -1;
+				ok = GetCapital(planet, i, &capital)
+						== GetCapital(replica, i, &replicaCapital)
+						&& capital == replicaCapital;
+			}
+			int kingdoms = -1, replicaKingdoms = -1;
+			ok = ok && GetKingdomsByPopulation(planet, capitals, &kingdoms)
+					== SUCCESS
+					&& GetKingdomsByPopulation(replica, replicaCapitals,
+							&replicaKingdoms) == SUCCESS
+					&& kingdoms == replicaKingdoms;
+			for (int k = 0; k < kingdoms && ok; k++) {
+				ok = capitals[k] == replicaCapitals[k];
+			}
+			for (int c = 0; c < n && ok; c++) {
+				int size = -1, population = -1;
+				ok = GetKingdomSize(planet, c, &size) == SUCCESS
+						&& size == model.cities(c)
+						&& GetKingdomPopulation(planet, c, &population)
+								== SUCCESS
+						&& population == model.population(c);
+			}
+		}
+		cout << "transactions (" << (ranking == RANKING_TREE ? "tree" : "buckets")
+				<< "): " << (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&planet);
+		Quit(&replica);
+	}
+	delete[] saved;
+	delete[] joins;
+	delete[] capitals;
+	delete[] replicaCapitals;
+	return 0;
+}
+
+// makes the same random updates on a planet that compacts its cities, by
+// itself and by CompactCities, and on one that never does, and checks that
+// the renumbering changes no answer: the capitals, the rankings of the
+// cities and within the kingdoms, and the cities and residents of every
+// kingdom, which may be listed in another order
+int compactionMain() {
+	const int n = 300, citizens = 3000, rounds = 300;
+	const int capacity = 2 * n; // with the cities that are added
+	int* cities = new int[capacity];
+	int* otherCities = new int[capacity];
+	int* marks = new int[capacity > citizens ? capacity : citizens];
+	long long* residents = new long long[citizens];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* compacted = InitWithRanking(n, RankingType(ranking));
+		void* other = InitWithRanking(n, RankingType(ranking));
+		SetCompactionThreshold(compacted, 5);
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(compacted, i);
+			AddCitizen(other, i);
+		}
+		int size = n;
+		bool ok = true;
+		for (int round = 0; round < rounds && ok; round++) {
+			for (int i = 0; i < 20 && ok; i++) {
+				int citizen = rand() % citizens, city = rand() % size;
+				if (rand() % 2) {
+					ok = MoveToCity(compacted, citizen, city)
+							== MoveToCity(other, citizen, city);
+				} else {
+					ok = RelocateCitizen(compacted, citizen, city)
+							== RelocateCitizen(other, citizen, city);
+				}
+			}
+			int kingdoms = 0, capital1 = -1, capital2 = -1;
+			GetNumberOfKingdoms(other, &kingdoms);
+			SelectKingdom(other, rand() % kingdoms, &capital1);
+			SelectKingdom(other, rand() % kingdoms, &capital2);
+			ok = ok && JoinKingdoms(compacted, capital1, capital2)
+					== JoinKingdoms(other, capital1, capital2);
+			if (round % 50 == 0 && size < capacity) {
+				int city = -1, otherCity = -1;
+				ok = ok && AddCity(compacted, &city) == SUCCESS
+						&& AddCity(other, &otherCity) == SUCCESS
+						&& city == size && otherCity == size;
+				size++;
+			}
+			if (round % 30 == 0) {
+				ok = ok && CompactCities(compacted) == SUCCESS;
+			}
+			for (int i = 0; i < citizens && ok; i++) {
+				int capital = -1, otherCapital = -1;
+				ok = GetCapital(compacted, i, &capital)
+						== GetCapital(other, i, &otherCapital)
+						&& capital == otherCapital;
+			}
+			GetCitiesBySize(compacted, cities);
+			GetCitiesBySize(other, otherCities);
+			for (int c = 0; c < size && ok; c++) {
+				ok = cities[c] == otherCities[c];
+			}
+			int city = rand() % size, count = -1, otherCount = -1;
+			ok = ok && GetKingdomCitiesBySize(compacted, city, cities, &count)
+					== SUCCESS
+					&& GetKingdomCitiesBySize(other, city, otherCities,
+							&otherCount) == SUCCESS && count == otherCount;
+			for (int k = 0; k < count && ok; k++) {
+				int result = -1;
+				ok = cities[k] == otherCities[k]
+						&& SelectCityInKingdom(compacted, city, k, &result)
+								== SUCCESS && result == cities[k];
+			}
+			// the cities of the kingdom, in any order
+			for (int c = 0; c < size; c++) {
+				marks[c] = 0;
+			}
+			ok = ok && GetKingdomCities(compacted, city, cities, &count)
+					== SUCCESS
+					&& GetKingdomCities(other, city, otherCities, &otherCount)
+							== SUCCESS && count == otherCount;
+			for (int i = 0; i < count && ok; i++) {
+				ok = cities[i] >= 0 && cities[i] < size
+						&& marks[cities[i]]++ == 0;
+			}
+			for (int i = 0; i < count && ok; i++) {
+				ok = marks[otherCities[i]]-- == 1;
+			}
+			// the residents of a city, in any order
+			for (int i = 0; i < citizens; i++) {
+				marks[i] = 0;
+			}
+			ok = ok && GetCityResidents(compacted, city, 0, residents, citizens,
+					&count) == SUCCESS;
+			for (int i = 0; i < count && ok; i++) {
+				ok = residents[i] >= 0 && residents[i] < citizens
+						&& marks[residents[i]]++ == 0;
+			}
+			ok = ok && GetCityResidents(other, city, 0, residents, citizens,
+					&otherCount) == SUCCESS && count == otherCount;
+			for (int i = 0; i < count && ok; i++) {
+				ok = marks[residents[i]]-- == 1;
+			}
+		}
+		cout << "compaction (" << (ranking == RANKING_TREE ? "tree" : "buckets")
+				<< "): " << (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&compacted);
+		Quit(&other);
+	}
+	delete[] cities;
+	delete[] otherCities;
+	delete[] marks;
+	delete[] residents;
+	return 0;
+}
+
+// moves citizens and joins kingdoms at random, querying the ranking of the
+// cities of some kingdoms (which builds it) and not of others, so that the
+// joins merge built rankings, built and unbuilt ones, and unbuilt ones, and
+// checks GetKingdomCitiesBySize and SelectCityInKingdom against the model
+int kingdomRankingMain() {
+	const int n = 300, citizens = 3000, rounds = 600;
+	int* results = new int[n];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* planet = InitWithRanking(n, RankingType(ranking));
+		PlanetModel model(n, citizens);
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(planet, i);
+		}
+		bool ok = true;
+		for (int round = 0; round < rounds && ok; round++) {
+			for (int i = 0; i < 10 && ok; i++) {
+				int citizen = rand() % citizens, city = rand() % n;
+				ok = MoveToCity(planet, citizen, city)
+						== model.move(citizen, city);
+			}
+			int city1 = model.capital(rand() % n);
+			int city2 = model.capital(rand() % n);
+			if (model.kingdom[city1] != model.kingdom[city2]) {
+				ok = ok && JoinKingdoms(planet, city1, city2) == SUCCESS;
+				model.join(city1, city2);
+			}
+			if (rand() % 3) {
+				continue;
+			}
+			// the k-th city is the one of which k cities rank first
+			int city = rand() % n, count = -1, result = -1;
+			ok = ok && GetKingdomCitiesBySize(planet, city, results, &count)
+					== SUCCESS && count == model.cities(city)
+					&& SelectCityInKingdom(planet, city, count, &result)
+							== FAILURE;
+			for (int k = 0; k < count && ok; k++) {
+				int c = results[k], rank = 0;
+				ok = c >= 0 && c < n && model.kingdom[c] == model.kingdom[city]
+						&& SelectCityInKingdom(planet, city, k, &result)
+								== SUCCESS && result == c;
+				for (int d = 0; d < n && ok; d++) {
+					bool first = model.size[d] > model.size[c]
+							|| (model.size[d] == model.size[c] && d < c);
+					rank += first && model.kingdom[d] == model.kingdom[city];
+				}
+				ok = ok && rank == k;
+			}
+			ok = ok && (count == 0 || results[0] == model.capital(city));
+		}
+		cout << "kingdom rankings ("
+				<< (ranking == RANKING_TREE ? "tree" : "buckets") << "): "
+				<< (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&planet);
+	}
+	delete[] results;
+	return 0;
+}
+
+// moves, relocates and removes citizens at random, mostly those of the
+// capitals so that capitals shrink and their kingdoms pick other ones, and
+// checks the capitals, the populations, the residents and GetCitiesBySize
+// against the model. A removed citizen must be unknown until added back.
+int relocateCitizenMain() {
+	const int n = 300, citizens = 3000, rounds = 300;
+	int* results = new int[n];
+	long long* residents = new long long[citizens];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* planet = InitWithRanking(n, RankingType(ranking));
+		PlanetModel model(n, citizens);
+		for (int i = 0; i < citizens; i++) {
+			int city = rand() % n;
+			AddCitizen(planet, i);
+			MoveToCity(planet, i, city);
+			model.move(i, city);
+		}
+		for (int i = 0; i < n / 2; i++) {
+			int city1 = model.capital(rand() % n);
+			int city2 = model.capital(rand() % n);
+			if (model.kingdom[city1] != model.kingdom[city2]) {
+				JoinKingdoms(planet, city1, city2);
+				model.join(city1, city2);
+			}
+		}
+		bool ok = true;
+		for (int round = 0; round < rounds && ok; round++) {
+			for (int i = 0; i < 20 && ok; i++) {
+				int citizen = rand() % citizens, city = rand() % n;
+				if (rand() % 2) { // a citizen of a capital, if any
+					int capital = model.capital(rand() % n);
+					for (int j = 0; j < citizens; j++) {
+						citizen = model.home[j] == capital ? j : citizen;
+					}
+				}
+				switch (rand() % 3) {
+				case 0:
+					ok = MoveToCity(planet, citizen, city)
+							== model.move(citizen, city);
+					break;
+				case 1:
+					ok = RelocateCitizen(planet, citizen, city) == SUCCESS;
+					model.relocate(citizen, city);
+					break;
+				default:
+					ok = RemoveCitizen(planet, citizen) == SUCCESS
+							&& RemoveCitizen(planet, citizen) == FAILURE
+							&& MoveToCity(planet, citizen, city) == FAILURE
+							&& RelocateCitizen(planet, citizen, city)
+									== FAILURE
+							&& AddCitizen(planet, citizen) == SUCCESS;
+					model.leave(citizen);
+				}
+			}
+			for (int i = 0; i < citizens && ok; i++) {
+				int capital = -1, home = model.home[i];
+				ok = GetCapital(planet, i, &capital)
+						== (home == -1 ? FAILURE : SUCCESS)
+						&& (home == -1 || capital == model.capital(home));
+			}
+			// the k-th city is the one of which k cities are smaller
+			GetCitiesBySize(planet, results);
+			for (int k = 0; k < n && ok; k++) {
+				int c = results[k], rank = 0;
+				ok = c >= 0 && c < n;
+				for (int d = 0; d < n && ok; d++) {
+					rank += model.size[d] < model.size[c]
+							|| (model.size[d] == model.size[c] && d < c);
+				}
+				ok = ok && rank == k;
+			}
+			int city = rand() % n, population = -1, count = -1;
+			ok = ok && GetKingdomPopulation(planet, city, &population)
+					== SUCCESS && population == model.population(city)
+					&& GetCityResidents(planet, city, 0, residents, citizens,
+							&count) == SUCCESS && count == model.size[city];
+			for (int i = 0; i < count && ok; i++) {
+				ok = residents[i] >= 0 && residents[i] < citizens
+						&& model.home[residents[i]] == city;
+			}
+		}
+		cout << "relocations (" << (ranking == RANKING_TREE ? "tree" : "buckets")
+				<< "): " << (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&planet);
+	}
+	delete[] results;
+	delete[] residents;
+	return 0;
+}
+
+// starts from a single city and adds cities one by one between random moves
+// and joins, and checks after every addition that the new city is a kingdom
+// of its own and can be moved into, and the ranking of the cities and the
+// capitals against the model, with every ranking engine
+int addCityMain() {
+	const int n = 300, citizens = 3000;
+	int* results = new int[n];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* planet = InitWithRanking(1, RankingType(ranking));
+		PlanetModel model(1, citizens);
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(planet, i);
+		}
+		bool ok = true;
+		while (model.n < n && ok) {
+			int city = -1, kingdoms = 0, size = -1;
+			ok = MoveToCity(planet, 0, model.n) == INVALID_INPUT
+					&& AddCity(planet, &city) == SUCCESS
+					&& city == model.addCity()
+					&& GetKingdomSize(planet, city, &size) == SUCCESS
+					&& size == 1;
+			for (int i = 0; i < 10 && ok; i++) {
+				int citizen = rand() % citizens;
+				city = rand() % 4 ? rand() % model.n : model.n - 1;
+				ok = MoveToCity(planet, citizen, city)
+						== model.move(citizen, city);
+			}
+			int city1 = model.capital(rand() % model.n);
+			int city2 = model.capital(rand() % model.n);
+			if (rand() % 2 && model.kingdom[city1] != model.kingdom[city2]) {
+				ok = ok && JoinKingdoms(planet, city1, city2) == SUCCESS;
+				model.join(city1, city2);
+			}
+			for (int c = 0; c < model.n; c++) {
+				kingdoms += model.capital(c) == c;
+			}
+			ok = ok && GetNumberOfKingdoms(planet, &size) == SUCCESS
+					&& size == kingdoms
+					&& SelectCity(planet, model.n, &city) == FAILURE;
+			// the k-th city is the one of which k cities are smaller
+			GetCitiesBySize(planet, results);
+			for (int k = 0; k < model.n && ok; k++) {
+				int c = results[k], rank = 0;
+				ok = c >= 0 && c < model.n
+						&& SelectCity(planet, k, &city) == SUCCESS && city == c;
+				for (int d = 0; d < model.n && ok; d++) {
+					rank += model.size[d] < model.size[c]
+							|| (model.size[d] == model.size[c] && d < c);
+				}
+				ok = ok && rank == k;
+			}
+			for (int i = 0; i < citizens && ok; i++) {
+				int capital = -1, home = model.home[i];
+				ok = GetCapital(planet, i, &capital)
+						== (home == -1 ? FAILURE : SUCCESS)
+						&& (home == -1 || capital == model.capital(home));
+			}
+		}
+		cout << "added cities (" << (ranking == RANKING_TREE ? "tree" : "buckets")
+				<< "): " << (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&planet);
+	}
+	delete[] results;
+	return 0;
+}
+
+// makes a random update of every kind between rounds of repeated reads, so
+// that the reads hit the cached ranking and SelectCity answers as well as
+// miss them, and checks SelectCity, GetCitiesBySize, GetTopCities and
+// GetCitiesInRankRange against the model. The second half of the rounds is
+// made thread-safe, where SelectCity does not cache its answers.
+int rankingCacheMain() {
+	const int n = 300, citizens = 3000, rounds = 400, moves = 20;
+	int* expected = new int[n];
+	int* results = new int[n];
+	int citizenIDs[moves], cities[moves];
+	StatusType statuses[moves];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* planet = InitWithRanking(n, RankingType(ranking));
+		PlanetModel model(n, citizens);
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(planet, i);
+		}
+		bool ok = true;
+		for (int round = 0; round < rounds && ok; round++) {
+			int citizen = rand() % citizens, city = rand() % n;
+			switch (round % 5) {
+			case 0:
+				ok = MoveToCity(planet, citizen, city)
+						== model.move(citizen, city);
+				break;
+			case 1:
+				ok = RelocateCitizen(planet, citizen, city) == SUCCESS;
+				model.relocate(citizen, city);
+				break;
+			case 2:
+				ok = RemoveCitizen(planet, citizen) == SUCCESS
+						&& AddCitizen(planet, citizen) == SUCCESS;
+				model.leave(citizen);
+				break;
+			case 3:
+				for (int i = 0; i < moves; i++) {
+					citizenIDs[i] = rand() % citizens;
+					cities[i] = rand() % n;
+				}
+				ok = MoveToCityBatch(planet, citizenIDs, cities, moves,
+						statuses) == SUCCESS;
+				for (int i = 0; i < moves && ok; i++) {
+					ok = statuses[i] == model.move(citizenIDs[i], cities[i]);
+				}
+				break;
+			default: // which changes no city
+				ok = BeginTransaction(planet) == SUCCESS
+						&& JoinKingdoms(planet, model.capital(0),
+								model.capital(city)) != ALLOCATION_ERROR
+						&& RollbackTransaction(planet) == SUCCESS;
+			}
+			if (round == rounds / 2) {
+				ok = ok && MakeThreadSafe(planet) == SUCCESS;
+			}
+			// the ranking of the model, where k cities are smaller than
+			// the k-th city
+			for (int c = 0; c < n; c++) {
+				int rank = 0;
+				for (int d = 0; d < n; d++) {
+					rank += model.size[d] < model.size[c]
+							|| (model.size[d] == model.size[c] && d < c);
+				}
+				expected[rank] = c;
+			}
+			for (int read = 0; read < 3 && ok; read++) {
+				ok = GetCitiesBySize(planet, results) == SUCCESS;
+				for (int k = 0; k < n && ok; k++) {
+					ok = results[k] == expected[k]
+							&& SelectCity(planet, k, &city) == SUCCESS
+							&& city == expected[k];
+				}
+				int k = rand() % n;
+				ok = ok && GetTopCities(planet, k, results) == SUCCESS;
+				for (int i = 0; i < k && ok; i++) {
+					ok = results[i] == expected[n - 1 - i];
+				}
+				ok = ok && GetCitiesInRankRange(planet, k, n - 1, 1, results)
+						== SUCCESS;
+				for (int i = k; i < n && ok; i++) {
+					ok = results[i - k] == expected[i];
+				}
+			}
+		}
+		cout << "ranking cache (" << (ranking == RANKING_TREE ? "tree" : "buckets")
+				<< "): " << (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&planet);
+	}
+	delete[] expected;
+	delete[] results;
+	return 0;
+}
+
+// keeps a mirror of the sizes and capitals of the cities up to date by
+// GetChangesSince alone, between random updates of every kind, and checks
+// that every city whose size or capital changed is returned, once, so the
+// mirror matches the model. A version that is too old must fail.
+int changeFeedMain() {
+	const int n = 300, citizens = 3000, rounds = 300;
+	int* mirrorSizes = new int[n];
+	int* mirrorCapitals = new int[n];
+	int* cities = new int[n];
+	int* seen = new int[n];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* planet = InitWithRanking(n, RankingType(ranking));
+		PlanetModel model(n, citizens);
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(planet, i);
+		}
+		long long version = -1;
+		int count = -1;
+		bool ok = GetChangesSince(planet, -1, cities, &count, &version)
+				== SUCCESS && count == 0;
+		long long first = version;
+		for (int c = 0; c < n; c++) {
+			mirrorSizes[c] = 0;
+			mirrorCapitals[c] = c;
+		}
+		for (int round = 0; round < rounds && ok; round++) {
+			for (int i = rand() % 10; i > 0 && ok; i--) {
+				int citizen = rand() % citizens, city = rand() % n;
+				int city1 = model.capital(rand() % n);
+				int city2 = model.capital(rand() % n);
+				switch (rand() % 5) {
+				case 0:
+					ok = MoveToCity(planet, citizen, city)
+							== model.move(citizen, city);
+					break;
+				case 1:
+					ok = RelocateCitizen(planet, citizen, city) == SUCCESS;
+					model.relocate(citizen, city);
+					break;
+				case 2:
+					ok = RemoveCitizen(planet, citizen) == SUCCESS
+							&& AddCitizen(planet, citizen) == SUCCESS;
+					model.leave(citizen);
+					break;
+				case 3:
+					if (model.kingdom[city1] != model.kingdom[city2]) {
+						ok = JoinKingdoms(planet, city1, city2) == SUCCESS;
+						model.join(city1, city2);
+					}
+					break;
+				default: // a join that is rolled back changes nothing
+					ok = BeginTransaction(planet) == SUCCESS
+							&& JoinKingdoms(planet, city1, city2)
+									!= ALLOCATION_ERROR
+							&& RollbackTransaction(planet) == SUCCESS;
+				}
+			}
+			long long newVersion = -1;
+			ok = ok && GetChangesSince(planet, version, cities, &count,
+					&newVersion) == SUCCESS && newVersion >= version;
+			for (int c = 0; c < n; c++) {
+				seen[c] = 0;
+			}
+			for (int i = 0; i < count && ok; i++) {
+				int c = cities[i];
+				ok = c >= 0 && c < n && !seen[c]++;
+				if (ok) {
+					mirrorSizes[c] = model.size[c];
+					mirrorCapitals[c] = model.capital(c);
+				}
+			}
+			for (int c = 0; c < n && ok; c++) {
+				ok = mirrorSizes[c] == model.size[c]
+						&& mirrorCapitals[c] == model.capital(c);
+			}
+			version = newVersion;
+			ok = ok && GetChangesSince(planet, version, cities, &count,
+					&newVersion) == SUCCESS && count == 0
+					&& newVersion == version
+					&& GetChangesSince(planet, version + 1, cities, &count,
+							&newVersion) == INVALID_INPUT
+					&& GetChangesSince(planet, -2, cities, &count,
+							&newVersion) == INVALID_INPUT;
+		}
+		// more changes than are kept
+		for (int i = 0; i < 70000 && ok; i++) {
+			ok = RelocateCitizen(planet, rand() % citizens, rand() % n)
+					== SUCCESS;
+		}
+		long long newVersion = -1;
+		ok = ok && GetChangesSince(planet, first, cities, &count, &newVersion)
+				== FAILURE;
+		cout << "change feed (" << (ranking == RANKING_TREE ? "tree" : "buckets")
+				<< "): " << (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&planet);
+	}
+	delete[] mirrorSizes;
+	delete[] mirrorCapitals;
+	delete[] cities;
+	delete[] seen;
+	return 0;
+}
+
+// the capital changes received by a subscriber of capitalChangesMain
+class CapitalChanges {
+public:
+	static const int MAX = 1000;
+	int count;
+	int kingdoms[MAX], oldCapitals[MAX], newCapitals[MAX];
+	long long versions[MAX];
+	CapitalChanges() :
+			count(0) {
+	}
+	static void record(void* context, int kingdom, int oldCapital,
+			int newCapital, long long version) {
+		CapitalChanges* changes = (CapitalChanges*) context;
+		if (changes->count < MAX) {
+			changes->kingdoms[changes->count] = kingdom;
+			changes->oldCapitals[changes->count] = oldCapital;
+			changes->newCapitals[changes->count] = newCapital;
+			changes->versions[changes->count] = version;
+		}
+		changes->count++;
+	}
+};
+
+// keeps a mirror of the capital of every city up to date by the capital
+// changes alone, between random updates of every kind (including joins
+// that are rolled back), and checks it against the model after every
+// update. Every change must change the capital and carry a version of the
+// update, in order, a batch must make at most one change for every city it moves
+// into, a rollback one for every join it undoes, and a cancelled
+// subscription must get no more changes.
+int capitalChangesMain() {
+	const int n = 200, citizens = 2000, rounds = 2000, moves = 50;
+	int* mirror = new int[n];
+	int* cities = new int[n];
+	int* grown = new int[n];
+	int citizenIDs[moves], batchCities[moves];
+	StatusType statuses[moves];
+	for (int ranking = RANKING_TREE; ranking <= RANKING_BUCKETS; ranking++) {
+		void* planet = InitWithRanking(n, RankingType(ranking));
+		PlanetModel model(n, citizens);
+		// the kingdoms before every join of the transaction, which are
+		// those of the changes of its rollback, from the last join
+		int* history = new int[n * n];
+		int joins = 0;
+		CapitalChanges changes, cancelled;
+		int subscription = -1, other = -1, count = -1;
+		bool ok = SubscribeCapitalChanges(planet, CapitalChanges::record,
+				&changes, &subscription) == SUCCESS
+				&& SubscribeCapitalChanges(planet, CapitalChanges::record,
+						&cancelled, &other) == SUCCESS;
+		for (int i = 0; i < citizens; i++) {
+			AddCitizen(planet, i);
+		}
+		for (int c = 0; c < n; c++) {
+			mirror[c] = c;
+		}
+		bool transaction = false;
+		long long version = -1; // the version after the last update
+		GetChangesSince(planet, -1, cities, &count, &version);
+		for (int round = 0; round < rounds && ok; round++) {
+			int citizen = rand() % citizens, city = rand() % n;
+			int city1 = model.capital(rand() % n);
+			int city2 = model.capital(rand() % n);
+			int distinct = -1; // the cities a batch moved into
+			bool rollback = false;
+			changes.count = 0;
+			if (transaction) {
+				if (rand() % 3) {
+					if (model.kingdom[city1] != model.kingdom[city2]) {
+						for (int c = 0; c < n; c++) {
+							history[joins * n + c] = model.kingdom[c];
+						}
+						joins++;
+						ok = JoinKingdoms(planet, city1, city2) == SUCCESS;
+						model.join(city1, city2);
+					}
+				} else if (rand() % 2) {
+					ok = RollbackTransaction(planet) == SUCCESS;
+					for (int c = 0; c < n && joins > 0; c++) {
+						model.kingdom[c] = history[c];
+					}
+					rollback = true;
+					transaction = false;
+				} else {
+					ok = CommitTransaction(planet) == SUCCESS;
+					transaction = false;
+				}
+			} else {
+				switch (rand() % 6) {
+				case 0:
+					ok = MoveToCity(planet, citizen, city)
+							== model.move(citizen, city);
+					break;
+				case 1:
+					ok = RelocateCitizen(planet, citizen, city) == SUCCESS;
+					model.relocate(citizen, city);
+					break;
+				case 2:
+					ok = RemoveCitizen(planet, citizen) == SUCCESS
+							&& AddCitizen(planet, citizen) == SUCCESS;
+					model.leave(citizen);
+					break;
+				case 3: // into a few cities, which grow many times
+					distinct = 0;
+					for (int c = 0; c < n; c++) {
+						grown[c] = 0;
+					}
+					for (int i = 0; i < moves; i++) {
+						citizenIDs[i] = rand() % citizens;
+						batchCities[i] = (city + rand() % 5) % n;
+					}
+					ok = MoveToCityBatch(planet, citizenIDs, batchCities, moves,
+							statuses) == SUCCESS;
+					for (int i = 0; i < moves && ok; i++) {
+						ok = statuses[i]
+								== model.move(citizenIDs[i], batchCities[i]);
+						distinct += statuses[i] == SUCCESS
+								&& !grown[batchCities[i]]++;
+					}
+					break;
+				case 4:
+					if (model.kingdom[city1] != model.kingdom[city2]) {
+						ok = JoinKingdoms(planet, city1, city2) == SUCCESS;
+						model.join(city1, city2);
+					}
+					break;
+				default:
+					ok = BeginTransaction(planet) == SUCCESS;
+					joins = 0;
+					transaction = true;
+				}
+			}
+			long long before = version, previous = version;
+			ok = ok && GetChangesSince(planet, -1, cities, &count, &version)
+					== SUCCESS && changes.count <= CapitalChanges::MAX
+					&& (distinct == -1 || changes.count <= distinct)
+					&& (!rollback || changes.count == joins);
+			for (int i = 0; i < changes.count && ok; i++) {
+				int kingdom = changes.kingdoms[i];
+				const int* labels = rollback ?
+						history + (joins - 1 - i) * n : model.kingdom;
+				ok = kingdom >= 0 && kingdom < n
+						&& changes.oldCapitals[i] != changes.newCapitals[i]
+						&& changes.versions[i] > before
+						&& changes.versions[i] >= previous
+						&& changes.versions[i] <= version;
+				previous = changes.versions[i];
+				for (int c = 0; c < n && ok; c++) {
+					if (labels[c] == labels[kingdom]
+							&& mirror[c] == changes.oldCapitals[i]) {
+						mirror[c] = changes.newCapitals[i];
+					}
+				}
+			}
+			for (int c = 0; c < n && ok; c++) {
+				ok = mirror[c] == model.capital(c);
+			}
+			if (round == rounds / 2) {
+				ok = ok && cancelled.count > 0
+						&& UnsubscribeCapitalChanges(planet, other) == SUCCESS
+						&& UnsubscribeCapitalChanges(planet, other)
+								== INVALID_INPUT;
+				cancelled.count = 0;
+			}
+		}
+		ok = ok && cancelled.count == 0;
+		cout << "capital changes ("
+				<< (ranking == RANKING_TREE ? "tree" : "buckets") << "): "
+				<< (ok ? "SUCCESS" : "FAILURE") << endl;
+		Quit(&planet);
+		delete[] history;
+	}
+	delete[] mirror;
+	delete[] cities;
+	delete[] grown;
+	return 0;
+}
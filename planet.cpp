@@ -1,102 +1,892 @@
 #include "planet.h"
+#include "lazyArray.h"
+#include "citizenCsv.h"
+#include <new> // std::bad_alloc
+#include <cstring> // memcpy
+#include <thread> // std::thread::hardware_concurrency
 
-class FillTree {
-	Planet::City* cities;
-	int index;
-public:
-	FillTree(Planet::City* cities) :
-			cities(cities), index(0) {
-	}
-	void operator()(Planet::City& city) {
-		city = cities[index++];
+inline int Planet::internal(int city) const {
+	return _internal ? _internal[city] : city;
+}
+
+inline int Planet::external(int index) const {
+	return _external ? _external[index] : index;
+}
+
+inline Planet::City& Planet::cityAt(int index) {
+	City& city = _cities[index];
+	// only City(0) has the ID 0 and there are no unused cities after a
+	// compaction, which makes them all
+	if (city._id == 0 && index != 0 && !_internal) {
+		city = City(index);
 	}
-};
+	return city;
+}
 
-Planet::Planet(int n) :
-		_size(n), _citiesTree(n), _kingdoms(n) {
-	City* cities = new City[n];
-	_cities = cities;
+Planet::Planet(int n, RankingType ranking) :
+		_size(n), _capacity(n), _rankingType(ranking), _citiesRanking(NULL), _kingdomsRanking(NULL), _kingdoms(n), _capitals(n), _internal(
+				NULL), _external(NULL), _scattered(0), _scatteredBefore(0), _compactionThreshold(
+				0), _rankings(NULL), _marks(NULL), _residents(NULL), _version(0), _rankingVersion(
+				0), _bySize(NULL), _bySizeCapacity(0), _bySizeVersion(-1), _changes(
+				CHANGE_LOG), _changesFloor(0), _log(NULL), _lsn(0), _lock(NULL), _publishInterval(
+				0), _publishedRanking(-1) {
+	for (int i = 0; i < SELECT_CACHE; ++i) {
+		_selectVersions[i] = -1;
+	}
+	_citizens.setStats(&_citizensStats);
+	_kingdoms.setStats(&_kingdomsStats);
+	_cities = newLazyArray<City>(n); // see cityAt
+	try {
+		_rankings = newLazyArray<Tree<KingdomCity>*>(n);
+		_marks = newLazyArray<int>(n);
+		_residents = newLazyArray<Residents>(n);
+		_kingdomsRanking = new TreeRanking(n);
+		if (ranking == RANKING_BUCKETS) {
+			_citiesRanking = new BucketRanking(n);
+		} else {
+			_citiesRanking = new TreeRanking(n);
+		}
+	} catch (std::bad_alloc& e) {
+		delete _kingdomsRanking;
+		deleteLazyArray(_residents);
+		deleteLazyArray(_marks);
+		deleteLazyArray(_rankings);
+		deleteLazyArray(_cities);
+		throw;
+	}
+	_kingdomsRanking->setStats(&_rankingsStats);
+	_citiesRanking->setStats(&_rankingsStats);
+}
 
+Planet::Planet(const Snapshot& snapshot) :
+		_size(snapshot.cities()), _capacity(snapshot.cities()), _rankingType(
+				RankingType(snapshot.ranking())), _citiesRanking(NULL), _kingdomsRanking(
+				NULL), _citizens(snapshot.citizens()), _kingdoms(
+				snapshot.cities()), _capitals(snapshot.cities()), _cities(NULL), _internal(
+				NULL), _external(NULL), _scattered(0), _scatteredBefore(0), _compactionThreshold(
+				0), _rankings(NULL), _marks(NULL), _residents(NULL), _version(0), _rankingVersion(
+				0), _bySize(NULL), _bySizeCapacity(0), _bySizeVersion(-1), _changes(
+				CHANGE_LOG), _changesFloor(0), _log(NULL), _lsn(snapshot.lsn()), _lock(
+				NULL), _publishInterval(0), _publishedRanking(-1) {
+	for (int i = 0; i < SELECT_CACHE; ++i) {
+		_selectVersions[i] = -1;
+	}
+	int n = _size;
+	const int* sizes = snapshot.section(Snapshot::SIZES);
+	const int* kingdoms = snapshot.section(Snapshot::KINGDOMS);
+	const int* capitals = snapshot.section(Snapshot::CAPITALS);
+	const int* bySize = snapshot.section(Snapshot::BY_SIZE);
+	const int* citizens = snapshot.section(Snapshot::CITIZENS);
+	_citizens.setStats(&_citizensStats);
+	_kingdoms.setStats(&_kingdomsStats);
+	_residents = newLazyArray<Residents>(n);
+	try {
+		for (int j = 0; j < snapshot.citizens(); ++j) {
+			Citizen citizen(Snapshot::citizenID(citizens + 3 * j));
+			if (citizens[3 * j + 2] != -1) {
+				addResident(citizens[3 * j + 2], citizen);
+				citizen.joinCity(citizens[3 * j + 2]);
+			}
+			_citizens.insert(citizen);
+		}
+	} catch (std::bad_alloc& e) {
+		deleteResidents();
+		throw;
+	}
+	_kingdoms.Restore(kingdoms, snapshot.section(Snapshot::NEXT));
+	_capitals.Restore(kingdoms, capitals);
+	const int* byPopulation = snapshot.section(Snapshot::BY_POPULATION);
+	int* populations = NULL; // of the kingdoms by their capitals
+	_cities = newLazyArray<City>(n);
+	try {
+		_rankings = newLazyArray<Tree<KingdomCity>*>(n);
+		_marks = newLazyArray<int>(n);
+		_bySize = new int[n];
+		populations = new int[n];
+	} catch (std::bad_alloc& e) {
+		delete[] _bySize;
+		deleteResidents();
+		deleteLazyArray(_marks);
+		deleteLazyArray(_rankings);
+		deleteLazyArray(_cities);
+		throw;
+	}
+	for (int i = 0; i < n; ++i) {
+		_bySize[i] = bySize[i];
+		_cities[i] = City(i, sizes[i]);
+	}
 	for (int i = 0; i < n; ++i) {
-		cities[i] = City(i);
+		City& root = _cities[kingdoms[i]];
+		root._capital = capitals[i];
+		if (kingdoms[i] != i) {
+			root._population += sizes[i];
+			root._first = root._first < i ? root._first : i;
+			root._last = root._last > i ? root._last : i;
+		}
+	}
+	for (int j = 0; j < snapshot.kingdoms(); ++j) {
+		int capital = byPopulation[j];
+		populations[capital] = _cities[kingdoms[capital]]._population;
+	}
+	try {
+		_kingdomsRanking = new TreeRanking(snapshot.kingdoms(), byPopulation,
+				populations);
+		if (_rankingType == RANKING_BUCKETS) {
+			_citiesRanking = new BucketRanking(n, bySize, sizes);
+		} else {
+			_citiesRanking = new TreeRanking(n, bySize, sizes);
+		}
+	} catch (std::bad_alloc& e) {
+		delete _kingdomsRanking;
+		delete[] populations;
+		delete[] _bySize;
+		deleteResidents();
+		deleteLazyArray(_marks);
+		deleteLazyArray(_rankings);
+		deleteLazyArray(_cities);
+		throw;
+	}
+	_kingdomsRanking->setStats(&_rankingsStats);
+	_citiesRanking->setStats(&_rankingsStats);
+	delete[] populations;
+	_bySizeCapacity = n;
+	_bySizeVersion = _rankingVersion;
+}
+
+StatusType Planet::AddCity(int* city) {
+	assert(city);
+	if (_kingdoms.InCheckpoint()) {
+		return FAILURE;
 	}
-	FillTree func(cities);
-	_citiesTree.inOrder(func);
+	if (_size == _capacity) {
+		grow();
+	}
+	int id = _size;
+	_kingdoms.Add();
+	_capitals.Add();
+	City newCity(id);
+	newCity._first = newCity._last = _size; // the new internal index
+	_citiesRanking->insert(id, 0);
+	_kingdomsRanking->insert(id, 0);
+	_cities[_size] = newCity;
+	_rankings[_size] = NULL;
+	if (_internal) {
+		_internal[id] = _size;
+		_external[_size] = id;
+	}
+	_size++;
+	_rankingVersion = ++_version;
+	logChange(id, false);
+	*city = id;
+	publishIfDue();
+	return recordUpdate(WriteAheadLog::ADD_CITY, id, 0) ? SUCCESS : FAILURE;
 }
 
-StatusType Planet::AddCitizen(int citizenID) {
+void Planet::grow() {
+	int capacity = _capacity ? _capacity * 2 : 1;
+	City* newCities = NULL;
+	Tree<KingdomCity>** newRankings = NULL;
+	int* newMarks = NULL;
+	Residents* newResidents = NULL;
+	int* newInternal = NULL;
+	int* newExternal = NULL;
+	try {
+		newCities = newLazyArray<City>(capacity);
+		newRankings = newLazyArray<Tree<KingdomCity>*>(capacity);
+		newMarks = newLazyArray<int>(capacity);
+		newResidents = newLazyArray<Residents>(capacity);
+		if (_internal) {
+			newInternal = new int[capacity];
+			newExternal = new int[capacity];
+		}
+	} catch (std::bad_alloc& e) {
+		delete[] newInternal;
+		deleteLazyArray(newResidents);
+		deleteLazyArray(newMarks);
+		deleteLazyArray(newRankings);
+		deleteLazyArray(newCities);
+		throw;
+	}
+	for (int i = 0; i < _size; ++i) { // the unused cities stay unused
+		newCities[i] = _cities[i];
+		newRankings[i] = _rankings[i];
+		newResidents[i] = _residents[i];
+		if (_internal) {
+			newInternal[i] = _internal[i];
+			newExternal[i] = _external[i];
+		}
+	}
+	deleteLazyArray(_cities);
+	deleteLazyArray(_rankings);
+	deleteLazyArray(_marks);
+	deleteLazyArray(_residents);
+	delete[] _internal;
+	delete[] _external;
+	_cities = newCities;
+	_rankings = newRankings;
+	_marks = newMarks;
+	_residents = newResidents;
+	_internal = newInternal;
+	_external = newExternal;
+	_capacity = capacity;
+}
+
+StatusType Planet::AddCitizen(long long citizenID) {
 	if (citizenID < 0) {
 		return INVALID_INPUT;
 	}
+	if (_kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
 	_citizens.insert(citizenID);
-	return SUCCESS;
+	return recordUpdate(WriteAheadLog::ADD_CITIZEN, citizenID, 0) ?
+			SUCCESS : FAILURE;
 }
 
-StatusType Planet::MoveToCity(int citizenID, int city) {
+StatusType Planet::MoveToCity(long long citizenID, int city) {
 	if (citizenID < 0 || city < 0 || city >= _size) {
 		return INVALID_INPUT;
 	}
 	Citizen* citizen = _citizens.find(Citizen(citizenID));
-	if (citizen == NULL
+	if (citizen == NULL || _kingdoms.InCheckpoint()
 			|| (citizen->inCity() != -1 && citizen->inCity() != city)) {
 		return FAILURE;
 	}
-	if (citizen->inCity() == city) {
-		return SUCCESS;
+	if (citizen->inCity() != city) {
+		addResident(city, *citizen);
+		try {
+			resizeCity(city, 1);
+		} catch (std::bad_alloc& e) {
+			removeResident(city, *citizen);
+			throw;
+		}
+		citizen->joinCity(city);
+		publishIfDue();
 	}
+	return recordUpdate(WriteAheadLog::MOVE_TO_CITY, citizenID, city) ?
+			SUCCESS : FAILURE;
+}
 
-	City& c2 = _cities[city];
-	_citiesTree.remove(c2);
-	c2._size++;
-	int kingdom = _kingdoms.Find(city);
-	int cap = _cities[kingdom]._capital;
+StatusType Planet::RemoveCitizen(long long citizenID) {
+	if (citizenID < 0) {
+		return INVALID_INPUT;
+	}
+	Citizen* citizen = _citizens.find(Citizen(citizenID));
+	if (citizen == NULL || _kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
+	if (citizen->inCity() != -1) {
+		resizeCity(citizen->inCity(), -1);
+		removeResident(citizen->inCity(), *citizen);
+		publishIfDue();
+	}
+	_citizens.remove(Citizen(citizenID));
+	return recordUpdate(WriteAheadLog::REMOVE_CITIZEN, citizenID, 0) ?
+			SUCCESS : FAILURE;
+}
 
-	if (_cities[cap]._size < c2._size || (_cities[cap]._size == c2._size
-			&& _cities[cap]._id > city)) {
-		_cities[kingdom]._capital = city;
+template<class ID>
+StatusType Planet::moveToCityBatch(const ID citizenIDs[], const int cities[],
+		int count, StatusType statuses[]) {
+	assert(citizenIDs && cities && statuses);
+	for (int i = 0; i < count; ++i) {
+		statuses[i] = ALLOCATION_ERROR;
+	}
+	int* touched = new int[count > 0 ? count : 1]; // cities moved into
+	bool* moved = NULL; // the citizens who moved, until their city is resized
+	try {
+		moved = new bool[count > 0 ? count : 1];
+	} catch (std::bad_alloc& e) {
+		delete[] touched;
+		throw;
+	}
+	int touchedCount = 0, resized = 0;
+	for (int i = 0; i < count; ++i) {
+		moved[i] = false;
 	}
+	try {
+		for (int i = 0; i < count; ++i) {
+			int city = cities[i];
+			if (citizenIDs[i] < 0 || city < 0 || city >= _size) {
+				statuses[i] = INVALID_INPUT;
+				continue;
+			}
+			Citizen* citizen = _citizens.find(Citizen(citizenIDs[i]));
+			if (citizen == NULL || _kingdoms.InCheckpoint()
+					|| (citizen->inCity() != -1 && citizen->inCity() != city)) {
+				statuses[i] = FAILURE;
+				continue;
+			}
+			if (citizen->inCity() != city) {
+				addResident(city, *citizen);
+				citizen->joinCity(city);
+				moved[i] = true;
+				if (_marks[city]++ == 0) {
+					touched[touchedCount++] = city;
+				}
+			}
+			statuses[i] = SUCCESS;
+		}
+		// cities only grow, so resizing each city once by its total gives the
+		// same capitals as resizing it once per citizen
+		for (; resized < touchedCount; ++resized) {
+			resizeCity(touched[resized], _marks[touched[resized]]);
+			_marks[touched[resized]] = 0;
+		}
+	} catch (std::bad_alloc& e) {
+		// the citizens of the cities which were not resized move back, and
+		// are marked by the city -2 until every move of theirs is failed
+		for (int i = count - 1; i >= 0; --i) {
+			if (moved[i] && _marks[cities[i]] > 0) {
+				Citizen* citizen = _citizens.find(Citizen(citizenIDs[i]));
+				removeResident(cities[i], *citizen);
+				citizen->joinCity(-2);
+			}
+		}
+		for (int i = 0; i < count; ++i) {
+			if (statuses[i] == SUCCESS || statuses[i] == FAILURE) {
+				Citizen* citizen = _citizens.find(Citizen(citizenIDs[i]));
+				if (citizen && citizen->inCity() == -2) {
+					statuses[i] = ALLOCATION_ERROR;
+				}
+			}
+		}
+		for (int i = 0; i < count; ++i) {
+			if (moved[i] && _marks[cities[i]] > 0) {
+				_citizens.find(Citizen(citizenIDs[i]))->joinCity(-1);
+			}
+		}
+		for (int i = resized; i < touchedCount; ++i) {
+			_marks[touched[i]] = 0;
+		}
+		delete[] moved;
+		delete[] touched;
+		if (resized > 0) {
+			publishIfDue();
+		}
+		// the moves which were made are still logged
+		recordMoves(citizenIDs, cities, count, statuses);
+		throw;
+	}
+	delete[] moved;
+	delete[] touched;
+	if (touchedCount > 0) {
+		publishIfDue();
+	}
+	return recordMoves(citizenIDs, cities, count, statuses) ?
+			SUCCESS : FAILURE;
+}
 
-	_citiesTree.insert(c2);
-	citizen->joinCity(city);
-	return SUCCESS;
+template<class ID>
+bool Planet::recordMoves(const ID citizenIDs[], const int cities[], int count,
+		const StatusType statuses[]) {
+	bool logged = true;
+	for (int i = 0; i < count; ++i) {
+		if (statuses[i] == SUCCESS) {
+			logged = recordUpdate(WriteAheadLog::MOVE_TO_CITY, citizenIDs[i],
+					cities[i]) && logged;
+		}
+	}
+	return logged;
 }
 
-StatusType Planet::JoinKingdoms(int city1, int city2) {
+StatusType Planet::MoveToCityBatch(const int citizenIDs[], const int cities[],
+		int count, StatusType statuses[]) {
+	return moveToCityBatch(citizenIDs, cities, count, statuses);
+}
+
+StatusType Planet::MoveToCityBatch(const long long citizenIDs[],
+		const int cities[], int count, StatusType statuses[]) {
+	return moveToCityBatch(citizenIDs, cities, count, statuses);
+}
+
+StatusType Planet::RelocateCitizen(long long citizenID, int city) {
+	if (citizenID < 0 || city < 0 || city >= _size) {
+		return INVALID_INPUT;
+	}
+	Citizen* citizen = _citizens.find(Citizen(citizenID));
+	if (citizen == NULL || _kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
+	if (citizen->inCity() != city) {
+		Citizen before = *citizen; // its slot, which addResident changes
+		addResident(city, *citizen);
+		// the lists are left last, since only adding to them allocates
+		try {
+			if (before.inCity() != -1) {
+				resizeCities(before.inCity(), city);
+			} else {
+				resizeCity(city, 1);
+			}
+		} catch (std::bad_alloc& e) {
+			removeResident(city, *citizen);
+			citizen->_slot = before._slot;
+			throw;
+		}
+		if (before.inCity() != -1) {
+			removeResident(before.inCity(), before);
+		}
+		citizen->joinCity(city);
+		publishIfDue();
+	}
+	return recordUpdate(WriteAheadLog::RELOCATE_CITIZEN, citizenID, city) ?
+			SUCCESS : FAILURE;
+}
+
+StatusType Planet::ImportCitizens(const char* path, long long* rows) {
+	assert(path && rows);
+	if (_kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
+	try {
+		CitizenCsv csv(path, std::thread::hardware_concurrency());
+		*rows = csv.count();
+		_citizens.reserve(_citizens.size() + csv.count());
+		// what every row did, which is logged once the cities are resized
+		char* done = new char[csv.count() > 0 ? csv.count() : 1];
+		memset(done, 0, csv.count());
+		DynamicArray<int> touched; // cities moved into
+		DynamicArray<int> capitals; // of their kingdoms before the resizes
+		bool rebuild = false;
+		int resized = 0;
+		try {
+			for (long long r = 0; r < csv.count(); ++r) {
+				long long citizenID = csv.rows()[r]._citizen;
+				int city = csv.rows()[r]._city;
+				if (citizenID < 0) { // AddCitizen and MoveToCity would fail
+					continue;
+				}
+				Citizen* citizen = _citizens.find(Citizen(citizenID));
+				if (citizen == NULL) {
+					_citizens.insert(Citizen(citizenID));
+					done[r] |= ROW_ADDED;
+					if (city < 0 || city >= _size) {
+						continue;
+					}
+					citizen = _citizens.find(Citizen(citizenID));
+				}
+				if (city < 0 || city >= _size || (citizen->inCity() != -1
+						&& citizen->inCity() != city)) {
+					continue;
+				}
+				if (citizen->inCity() != city) {
+					if (_marks[city] == 0) {
+						touched.pushBack(city);
+					}
+					addResident(city, *citizen);
+					citizen->joinCity(city);
+					done[r] |= ROW_JOINED;
+					++_marks[city];
+				}
+				done[r] |= ROW_MOVED;
+			}
+			// cities only grow, so resizing each city once by its total
+			// gives the same capitals as the rows one by one (see
+			// MoveToCityBatch)
+			rebuild = touched.size() > _size / REBUILD_RANKING;
+			for (; resized < touched.size(); ++resized) {
+				int city = touched[resized];
+				int kingdom = _kingdoms.Find(internal(city));
+				capitals.pushBack(cityAt(kingdom)._capital);
+				resizeCity(city, _marks[city], !rebuild);
+			}
+			if (rebuild) {
+				rankCities();
+			}
+		} catch (std::bad_alloc& e) {
+			// the ranking was not updated by the resizes, so if it is not
+			// rebuilt they are all undone
+			for (int i = resized - 1; rebuild && i >= 0; --i) {
+				unresizeCity(touched[i], _marks[touched[i]], capitals[i]);
+			}
+			for (int i = 0; !rebuild && i < resized; ++i) {
+				_marks[touched[i]] = 0;
+			}
+			// the citizens of the cities which were not resized move back,
+			// and their moves are not logged
+			for (long long r = csv.count() - 1; r >= 0; --r) {
+				int city = csv.rows()[r]._city;
+				if ((done[r] & ROW_JOINED) && _marks[city] > 0) {
+					Citizen* citizen = _citizens.find(
+							Citizen(csv.rows()[r]._citizen));
+					removeResident(city, *citizen);
+					citizen->joinCity(-1);
+				}
+			}
+			for (long long r = 0; r < csv.count(); ++r) {
+				const CitizenCsv::Row& row = csv.rows()[r];
+				if ((done[r] & ROW_MOVED) && _citizens.find(
+						Citizen(row._citizen))->inCity() != row._city) {
+					done[r] &= ~ROW_MOVED;
+				}
+			}
+			for (int i = rebuild ? 0 : resized; i < touched.size(); ++i) {
+				_marks[touched[i]] = 0;
+			}
+			if (resized > 0) {
+				publishIfDue();
+			}
+			recordRows(csv, done);
+			delete[] done;
+			throw;
+		}
+		for (int i = 0; i < touched.size(); ++i) {
+			_marks[touched[i]] = 0;
+		}
+		if (touched.size() > 0) {
+			publishIfDue();
+		}
+		bool logged = recordRows(csv, done);
+		delete[] done;
+		return logged ? SUCCESS : FAILURE;
+	} catch (CitizenCsv::IOError& e) {
+		return FAILURE;
+	} catch (CitizenCsv::BadCsv& e) {
+		return FAILURE;
+	}
+}
 
-	int root1 = _kingdoms.Find(city1);
-	int root2 = _kingdoms.Find(city2);
+bool Planet::recordRows(const CitizenCsv& csv, const char done[]) {
+	bool logged = true;
+	for (long long r = 0; r < csv.count(); ++r) {
+		long long citizenID = csv.rows()[r]._citizen;
+		if (done[r] & ROW_ADDED) {
+			logged = recordUpdate(WriteAheadLog::ADD_CITIZEN, citizenID, 0)
+					&& logged;
+		}
+		if (done[r] & ROW_MOVED) {
+			logged = recordUpdate(WriteAheadLog::MOVE_TO_CITY, citizenID,
+					csv.rows()[r]._city) && logged;
+		}
+	}
+	return logged;
+}
 
-	City& cap1 = _cities[_cities[root1]._capital];
-	City& cap2 = _cities[_cities[root2]._capital];
+void Planet::unresizeCity(int city, int delta, int capital) {
+	int kingdom = _kingdoms.Find(internal(city));
+	City& root = cityAt(kingdom);
+	City& c = cityAt(internal(city));
+	int size = c._size - delta, population = root._population - delta;
+	if (_rankings[kingdom]) {
+		_rankings[kingdom]->replace(KingdomCity(city, c._size),
+				KingdomCity(city, size));
+	}
+	// a kingdom's old entry is put back in its node, or among the empty
+	_kingdomsRanking->replace(root._capital, root._population, capital,
+			population);
+	c._size = size;
+	root._population = population;
+	_rankingVersion = ++_version;
+	logChange(city, false);
+	if (capital != root._capital) {
+		int oldCapital = root._capital;
+		root._capital = capital;
+		_capitals.SetLabel(city, capital);
+		logChange(city, true);
+		notifyCapital(city, oldCapital, capital);
+	}
+}
+
+void Planet::rankCities() {
+	int* sizes = new int[_size > 0 ? _size : 1];
+	int largest = 0;
+	for (int i = 0; i < _size; ++i) {
+		sizes[i] = _cities[internal(i)]._size;
+		largest = sizes[i] > largest ? sizes[i] : largest;
+	}
+	int* order = NULL;
+	int* starts = NULL; // of every size in order
+	CityRanking* ranking = NULL;
+	try {
+		order = new int[_capacity];
+		starts = new int[largest + 1];
+		// a counting sort by size, where the cities of a size are ranked by
+		// their IDs as they are visited in the order of their IDs
+		for (int size = 0; size <= largest; ++size) {
+			starts[size] = 0;
+		}
+		for (int i = 0; i < _size; ++i) {
+			++starts[sizes[i]];
+		}
+		for (int size = 0, start = 0; size <= largest; ++size) {
+			int count = starts[size];
+			starts[size] = start;
+			start += count;
+		}
+		for (int i = 0; i < _size; ++i) {
+			order[starts[sizes[i]]++] = i;
+		}
+		if (_rankingType == RANKING_BUCKETS) {
+			ranking = new BucketRanking(_size, order, sizes);
+		} else {
+			ranking = new TreeRanking(_size, order, sizes);
+		}
+		ranking->setStats(&_rankingsStats);
+	} catch (std::bad_alloc& e) {
+		delete[] starts;
+		delete[] order;
+		delete[] sizes;
+		throw;
+	}
+	delete[] starts;
+	delete[] sizes;
+	delete _citiesRanking;
+	_citiesRanking = ranking;
+	delete[] _bySize;
+	_bySize = order;
+	_bySizeCapacity = _capacity;
+	_bySizeVersion = _rankingVersion;
+}
+
+void Planet::resizeCity(int city, int delta, bool ranked) {
+	int kingdom = _kingdoms.Find(internal(city));
+	City& root = cityAt(kingdom);
+	if (delta < 0 && city == root._capital) {
+		ranking(kingdom); // the new capital is found in the ranking
+	}
+	City& c = cityAt(internal(city));
+	int size = c._size + delta, population = root._population + delta;
+	Tree<KingdomCity>* cities = _rankings[kingdom];
+	if (cities) {
+		cities->replace(KingdomCity(city, c._size), KingdomCity(city, size));
+	}
+	int oldCapital = root._capital, capital = oldCapital;
+	if (delta > 0) {
+		City& cap = cityAt(internal(root._capital));
+		if (cap._size < size || (cap._size == size && cap._id > city)) {
+			capital = city;
+		}
+	} else if (city == root._capital) {
+		capital = cities->select(cities->size())._id;
+	}
+	// a failed allocation changes nothing: the kingdoms' ranking allocates
+	// only for a kingdom's first citizen, and is then undone without
+	// allocating, so it is changed first if the city grows and last if it
+	// shrinks
+	try {
+		if (delta > 0) {
+			_kingdomsRanking->replace(oldCapital, root._population, capital,
+					population);
+		}
+		try {
+			if (ranked) {
+				_citiesRanking->resize(city, c._size, size);
+			}
+		} catch (std::bad_alloc& e) {
+			if (delta > 0) {
+				_kingdomsRanking->replace(capital, population, oldCapital,
+						root._population);
+			}
+			throw;
+		}
+		if (delta < 0) {
+			_kingdomsRanking->replace(oldCapital, root._population, capital,
+					population);
+		}
+	} catch (std::bad_alloc& e) {
+		if (cities) {
+			cities->replace(KingdomCity(city, size),
+					KingdomCity(city, c._size));
+		}
+		throw;
+	}
+	c._size = size;
+	root._population = population;
+	_rankingVersion = ++_version;
+	logChange(city, false);
+	if (capital != oldCapital) {
+		root._capital = capital;
+		_capitals.SetLabel(city, capital);
+		logChange(city, true);
+		notifyCapital(city, oldCapital, capital);
+	}
+}
+
+void Planet::resizeCities(int from, int to) {
+	int fromSize = cityAt(internal(from))._size;
+	int toSize = cityAt(internal(to))._size;
+	int fromKingdom = _kingdoms.Find(internal(from));
+	int toCapital = cityAt(_kingdoms.Find(internal(to)))._capital;
+	if (from == cityAt(fromKingdom)._capital) {
+		ranking(fromKingdom); // see resizeCity, built before any change
+	}
+	// the city that grows and the cities' ranking may allocate, and are
+	// undone without allocating, while the city that shrinks allocates
+	// nothing once its kingdom's ranking is built
+	resizeCity(to, 1, false);
+	try {
+		_citiesRanking->resize(from, fromSize, fromSize - 1, to, toSize,
+				toSize + 1);
+	} catch (std::bad_alloc& e) {
+		unresizeCity(to, 1, toCapital);
+		throw;
+	}
+	resizeCity(from, -1, false);
+}
+
+StatusType Planet::JoinKingdoms(int city1, int city2) {
+	if (city1 < 0 || city1 >= _size || city2 < 0 || city2 >= _size) {
+		return INVALID_INPUT;
+	}
+	int root1 = _kingdoms.Find(internal(city1));
+	int root2 = _kingdoms.Find(internal(city2));
+
+	City& cap1 = cityAt(internal(cityAt(root1)._capital));
+	City& cap2 = cityAt(internal(cityAt(root2)._capital));
 
 	if (city1 != cap1._id || city2 != cap2._id || cap1._id == cap2._id) {
 		return FAILURE;
 	}
+	int population = cityAt(root1)._population + cityAt(root2)._population;
+	int size1 = _kingdoms.Size(root1), size2 = _kingdoms.Size(root2);
+	int first = cityAt(root1)._first < cityAt(root2)._first ?
+			cityAt(root1)._first : cityAt(root2)._first;
+	int last = cityAt(root1)._last > cityAt(root2)._last ?
+			cityAt(root1)._last : cityAt(root2)._last;
+	Tree<KingdomCity>* ranking1 = _rankings[root1];
+	Tree<KingdomCity>* ranking2 = _rankings[root2];
+	int capital = cap2._id;
+	if (cap1._size > cap2._size
+			|| (cap1._size == cap2._size && cap1._id < cap2._id)) {
+		capital = cap1._id;
+	}
+	// everything that allocates comes first, so a failed allocation
+	// changes nothing
+	if (_kingdoms.InCheckpoint()) {
+		// a rollback puts the other kingdom back into the ranking, with
+		// a node reserved here
+		_journal.reserve(_journal.size() + 1);
+		_kingdomsRanking->reserve(_journal.size() + 1);
+	} else {
+		mergeRankings(root1, root2, size1, size2);
+	}
 	_kingdoms.Union(root1, root2);
-	int newKingdom = _kingdoms.Find(city1);
-	if (cap1._size > cap2._size) {
-		_cities[newKingdom]._capital = cap1._id;
-	} else if (cap1._size == cap2._size) {
-		_cities[newKingdom]._capital = (cap1._id < cap2._id) ? cap1._id : cap2._id;
+	// the kingdom of the capital keeps its entry, which allocates nothing
+	// (it is of population 0 only if both kingdoms are)
+	if (capital == cap1._id) {
+		_kingdomsRanking->replace(cap1._id, cityAt(root1)._population,
+				capital, population);
+		_kingdomsRanking->remove(cap2._id, cityAt(root2)._population);
 	} else {
-		_cities[newKingdom]._capital = cap2._id;
+		_kingdomsRanking->replace(cap2._id, cityAt(root2)._population,
+				capital, population);
+		_kingdomsRanking->remove(cap1._id, cityAt(root1)._population);
 	}
-
-	return SUCCESS;
+	int newKingdom = _kingdoms.Find(root1);
+	int other = (newKingdom == root1) ? root2 : root1;
+	if (_kingdoms.InCheckpoint()) {
+		// the rankings are kept aside for a rollback, and rebuilt if needed
+		JoinRecord join(newKingdom, other, cityAt(newKingdom));
+		join._rootRanking = (newKingdom == root1) ? ranking1 : ranking2;
+		join._otherRanking = (newKingdom == root1) ? ranking2 : ranking1;
+		join._city1 = city1;
+		join._city2 = city2;
+		_journal.pushBack(join);
+		_rankings[root1] = _rankings[root2] = NULL;
+	} else if (newKingdom != root1) {
+		_rankings[newKingdom] = _rankings[root1];
+		_rankings[root1] = NULL;
+	}
+	cityAt(newKingdom)._first = first;
+	cityAt(newKingdom)._last = last;
+	if (last - first + 1 != size1 + size2) {
+		_scattered += size1 < size2 ? size1 : size2;
+	}
+	cityAt(newKingdom)._capital = capital;
+	cityAt(newKingdom)._population = population;
+	++_version;
+	// the cities of the kingdom whose capital lost changed their capital
+	int lost = cityAt(newKingdom)._capital == cap1._id ? cap2._id : cap1._id;
+	logChange(lost, true);
+	notifyCapital(lost, lost, cityAt(newKingdom)._capital);
+	if (_kingdoms.InCheckpoint()) {
+		_journal.back()._joinedCapital = cityAt(newKingdom)._capital;
+		return SUCCESS;
+	}
+	_capitals.Union(city1, city2, cityAt(newKingdom)._capital);
+	if (_compactionThreshold > 0
+			&& _scattered >= (double) _size * _compactionThreshold / 100) {
+		try {
+			compact();
+		} catch (std::bad_alloc& e) {
+			// the storage of the cities is only a matter of locality, so
+			// a failed allocation keeps it until the next join
+		}
+	}
+	return recordUpdate(WriteAheadLog::JOIN_KINGDOMS, city1, city2) ?
+			SUCCESS : FAILURE;
 }
 
-StatusType Planet::GetCapital(int citizenID, int* capital) {
+StatusType Planet::GetCapital(long long citizenID, int* capital) {
 	assert(capital);
 	Citizen* citizen = _citizens.find(Citizen(citizenID));
 	if (citizen == NULL) {
 		return FAILURE;
 	}
 	int city = citizen->inCity();
-	int kingdom = _kingdoms.Find(city);
-	*capital = _cities[kingdom]._capital;
+	if (city == -1) {
+		return FAILURE;
+	}
+	if (_kingdoms.InCheckpoint()) { // the mirror holds committed kingdoms only
+		*capital = cityAt(_kingdoms.Find(internal(city)))._capital;
+	} else {
+		*capital = _capitals.Label(city);
+	}
 	return SUCCESS;
 }
 
+template<class ID>
+StatusType Planet::getCapitalBatch(const ID citizenIDs[], int count,
+		int capitals[], StatusType statuses[]) {
+	assert(citizenIDs && capitals && statuses);
+	const int group = 16;	// lookups whose cache misses overlap
+	int cities[group];
+	for (int first = 0; first < count; first += group) {
+		int last = (first + group < count) ? first + group : count;
+		if (_kingdoms.InCheckpoint()) {
+			for (int i = first; i < last; ++i) {
+				statuses[i] = citizenIDs[i] < 0 ? INVALID_INPUT :
+						GetCapital(citizenIDs[i], capitals + i);
+			}
+			continue;
+		}
+		for (int level = 0; level < 2; ++level) {
+			for (int i = first; i < last; ++i) {
+				if (citizenIDs[i] >= 0) {
+					_citizens.prefetch(Citizen(citizenIDs[i]), level);
+				}
+			}
+		}
+		for (int i = first; i < last; ++i) {
+			Citizen* citizen = citizenIDs[i] < 0 ? NULL :
+					_citizens.find(Citizen(citizenIDs[i]));
+			cities[i - first] = citizen ? citizen->inCity() : -1;
+			_capitals.Prefetch(cities[i - first]);
+		}
+		for (int i = first; i < last; ++i) {
+			if (citizenIDs[i] < 0) {
+				statuses[i] = INVALID_INPUT;
+			} else if (cities[i - first] == -1) {
+				statuses[i] = FAILURE;
+			} else {
+				capitals[i] = _capitals.Label(cities[i - first]);
+				statuses[i] = SUCCESS;
+			}
+		}
+	}
+	return SUCCESS;
+}
+
+StatusType Planet::GetCapitalBatch(const int citizenIDs[], int count,
+		int capitals[], StatusType statuses[]) {
+	return getCapitalBatch(citizenIDs, count, capitals, statuses);
+}
+
+StatusType Planet::GetCapitalBatch(const long long citizenIDs[], int count,
+		int capitals[], StatusType statuses[]) {
+	return getCapitalBatch(citizenIDs, count, capitals, statuses);
+}
+
 StatusType Planet::SelectCity(int k, int* city) {
 	assert(city);
 	if (k < 0) {
@@ -105,39 +895,943 @@ StatusType Planet::SelectCity(int k, int* city) {
 	if (k >= _size) {
 		return FAILURE;
 	}
-	*city = _citiesTree.select(k + 1)._id;
+	if (_bySizeVersion == _rankingVersion) {
+		*city = _bySize[k];
+		return SUCCESS;
+	}
+	if (_lock) { // the slots would be written by concurrent readers
+		*city = _citiesRanking->select(k);
+		return SUCCESS;
+	}
+	int slot = k % SELECT_CACHE;
+	if (_selectVersions[slot] != _rankingVersion || _selectKeys[slot] != k) {
+		_selectKeys[slot] = k;
+		_selectCities[slot] = _citiesRanking->select(k);
+		_selectVersions[slot] = _rankingVersion;
+	}
+	*city = _selectCities[slot];
+	return SUCCESS;
+}
+
+const int* Planet::citiesBySize() {
+	if (_bySizeVersion != _rankingVersion) {
+		// concurrent readers build the ranking once, see MakeThreadSafe
+		std::lock_guard<std::mutex> guard(_bySizeMutex);
+		if (_bySizeVersion != _rankingVersion) {
+			if (_bySizeCapacity < _size) {
+				int* bySize = new int[_capacity];
+				delete[] _bySize;
+				_bySize = bySize;
+				_bySizeCapacity = _capacity;
+			}
+			if (_size > 0) {
+				_citiesRanking->parallelRange(0, _size - 1, true, _bySize,
+						std::thread::hardware_concurrency());
+			}
+			_bySizeVersion = _rankingVersion;
+		}
+	}
+	return _bySize;
+}
+
+StatusType Planet::GetCitiesBySize(int results[]) {
+	assert(results);
+	if (_size > 0) {
+		memcpy(results, citiesBySize(), _size * sizeof(int));
+	}
 	return SUCCESS;
 }
 
-class TreeToArray {
+StatusType Planet::GetTopCities(int k, int results[]) {
+	assert(results);
+	if (k < 0) {
+		return INVALID_INPUT;
+	}
+	if (k > _size) {
+		return FAILURE;
+	}
+	if (_bySizeVersion == _rankingVersion) {
+		for (int i = 0; i < k; ++i) {
+			results[i] = _bySize[_size - 1 - i];
+		}
+	} else if (k > 0) {
+		_citiesRanking->parallelRange(0, k - 1, false, results,
+				std::thread::hardware_concurrency());
+	}
+	return SUCCESS;
+}
+
+StatusType Planet::GetCitiesInRankRange(int from, int to, bool ascending,
+		int results[]) {
+	assert(results);
+	if (from < 0 || to < from) {
+		return INVALID_INPUT;
+	}
+	if (to >= _size) {
+		return FAILURE;
+	}
+	if (_bySizeVersion != _rankingVersion) {
+		_citiesRanking->parallelRange(from, to, ascending, results,
+				std::thread::hardware_concurrency());
+	} else if (ascending) {
+		memcpy(results, _bySize + from, (to - from + 1) * sizeof(int));
+	} else {
+		for (int i = from; i <= to; ++i) {
+			results[i - from] = _bySize[_size - 1 - i];
+		}
+	}
+	return SUCCESS;
+}
+
+template<class Function>
+void Planet::forEachKingdomCity(int root, Function& function) {
+	const City& kingdom = cityAt(root);
+	if (kingdom._last - kingdom._first + 1 == _kingdoms.Size(root)) {
+		for (int i = kingdom._first; i <= kingdom._last; ++i) { // contiguous
+			function(cityAt(i));
+		}
+	} else {
+		int current = root;
+		do {
+			function(cityAt(current));
+			current = _kingdoms.Next(current);
+		} while (current != root);
+	}
+}
+
+class CitiesToArray {
 	int* results;
 	int index;
 public:
-	TreeToArray(int results[]) :
+	CitiesToArray(int results[]) :
 			results(results), index(0) {
 	}
-	void operator()(const Planet::City& data) {
-		results[index++] = data._id;
+	void operator()(const Planet::City& city) {
+		results[index++] = city._id;
+	}
+	int count() const {
+		return index;
 	}
 };
 
-StatusType Planet::GetCitiesBySize(int results[]) {
-	assert(results);
-	TreeToArray convert(results);
-	_citiesTree.inOrder(convert);
+StatusType Planet::GetKingdomCities(int city, int cities[], int* count) {
+	assert(cities && count);
+	if (city < 0 || city >= _size) {
+		return INVALID_INPUT;
+	}
+	CitiesToArray convert(cities);
+	forEachKingdomCity(_kingdoms.Find(internal(city)), convert);
+	*count = convert.count();
+	return SUCCESS;
+}
+
+StatusType Planet::GetKingdomSize(int city, int* size) {
+	assert(size);
+	if (city < 0 || city >= _size) {
+		return INVALID_INPUT;
+	}
+	*size = _kingdoms.Size(internal(city));
+	return SUCCESS;
+}
+
+StatusType Planet::GetKingdomPopulation(int city, int* population) {
+	assert(population);
+	if (city < 0 || city >= _size) {
+		return INVALID_INPUT;
+	}
+	*population = cityAt(_kingdoms.Find(internal(city)))._population;
+	return SUCCESS;
+}
+
+StatusType Planet::GetCityResidents(int city, int offset,
+		long long residents[], int max, int* count) {
+	assert(residents && count);
+	if (city < 0 || city >= _size || offset < 0 || max < 0) {
+		return INVALID_INPUT;
+	}
+	const Residents& list = _residents[city];
+	int n = 0;
+	for (int i = offset; i < list._size && n < max; ++i) {
+		residents[n++] = list._ids[i];
+	}
+	*count = n;
+	return SUCCESS;
+}
+
+StatusType Planet::GetNumberOfKingdoms(int* count) {
+	assert(count);
+	*count = _kingdomsRanking->size();
+	return SUCCESS;
+}
+
+StatusType Planet::SelectKingdom(int k, int* capital) {
+	assert(capital);
+	if (k < 0) {
+		return INVALID_INPUT;
+	}
+	if (k >= _kingdomsRanking->size()) {
+		return FAILURE;
+	}
+	*capital = _kingdomsRanking->select(k);
+	return SUCCESS;
+}
+
+StatusType Planet::GetKingdomsByPopulation(int results[], int* count) {
+	assert(results && count);
+	*count = _kingdomsRanking->size();
+	if (*count > 0) {
+		_kingdomsRanking->parallelRange(0, *count - 1, true, results,
+				std::thread::hardware_concurrency());
+	}
+	return SUCCESS;
+}
+
+class InsertToRanking {
+	Tree<Planet::KingdomCity>& ranking;
+public:
+	InsertToRanking(Tree<Planet::KingdomCity>& ranking) :
+			ranking(ranking) {
+	}
+	void operator()(const Planet::City& city) {
+		ranking.insert(Planet::KingdomCity(city._id, city._size));
+	}
+	void operator()(const Planet::KingdomCity& city) {
+		ranking.insert(city);
+	}
+};
+
+Tree<Planet::KingdomCity>& Planet::ranking(int root) {
+	if (!_rankings[root]) {
+		Tree<KingdomCity>* ranking = new Tree<KingdomCity>();
+		ranking->setStats(&_rankingsStats);
+		try {
+			InsertToRanking insert(*ranking);
+			forEachKingdomCity(root, insert);
+		} catch (std::bad_alloc& e) {
+			delete ranking;
+			throw;
+		}
+		_rankings[root] = ranking;
+	}
+	return *_rankings[root];
+}
+
+void Planet::mergeRankings(int root, int other, int rootSize, int otherSize) {
+	int large = (rootSize >= otherSize) ? root : other;
+	int small = (rootSize >= otherSize) ? other : root;
+	if (_rankings[large]) {
+		try {
+			InsertToRanking insert(*_rankings[large]);
+			if (_rankings[small]) {
+				_rankings[small]->inOrder(insert);
+			} else {
+				forEachKingdomCity(small, insert);
+			}
+		} catch (std::bad_alloc& e) { // will be rebuilt if needed
+			delete _rankings[large];
+			_rankings[large] = NULL;
+		}
+	}
+	delete _rankings[small]; // merged, or rebuilt if needed
+	_rankings[small] = NULL;
+	_rankings[root] = _rankings[large];
+	if (large != root) {
+		_rankings[large] = NULL;
+	}
+}
+
+StatusType Planet::SelectCityInKingdom(int city, int k, int* result) {
+	assert(result);
+	if (city < 0 || city >= _size || k < 0) {
+		return INVALID_INPUT;
+	}
+	Tree<KingdomCity>& kingdom = ranking(_kingdoms.Find(internal(city)));
+	if (k >= (int) kingdom.size()) {
+		return FAILURE;
+	}
+	*result = kingdom.select(kingdom.size() - k)._id;
+	return SUCCESS;
+}
+
+class KingdomCitiesToArray {
+	int* results;
+	int index;
+public:
+	KingdomCitiesToArray(int results[], int count) :
+			results(results), index(count) {
+	}
+	void operator()(const Planet::KingdomCity& data) {
+		results[--index] = data._id;
+	}
+};
+
+StatusType Planet::GetKingdomCitiesBySize(int city, int results[],
+		int* count) {
+	assert(results && count);
+	if (city < 0 || city >= _size) {
+		return INVALID_INPUT;
+	}
+	Tree<KingdomCity>& kingdom = ranking(_kingdoms.Find(internal(city)));
+	KingdomCitiesToArray convert(results, kingdom.size());
+	kingdom.inOrder(convert);
+	*count = kingdom.size();
+	return SUCCESS;
+}
+
+void Planet::logChange(int city, bool kingdom) {
+	if (_changes.full()) {
+		_changesFloor = _changes.front()._version;
+	}
+	_changes.pushBack(Change(_version, city, kingdom));
+}
+
+void Planet::addResident(int city, Citizen& citizen) {
+	Residents& list = _residents[city];
+	if (list._size == list._capacity) {
+		int capacity = list._capacity ? list._capacity * 2 : 1;
+		long long* ids = new long long[capacity];
+		for (int i = 0; i < list._size; ++i) {
+			ids[i] = list._ids[i];
+		}
+		delete[] list._ids;
+		list._ids = ids;
+		list._capacity = capacity;
+	}
+	citizen._slot = list._size;
+	list._ids[list._size++] = citizen._id;
+}
+
+void Planet::removeResident(int city, const Citizen& citizen) {
+	Residents& list = _residents[city];
+	long long last = list._ids[--list._size];
+	if (last != citizen._id) {
+		list._ids[citizen._slot] = last;
+		_citizens.find(Citizen(last))->_slot = citizen._slot;
+	}
+	if (list._size == 0) {
+		delete[] list._ids;
+		list._ids = NULL;
+		list._capacity = 0;
+	} else if (list._size <= list._capacity / 4) {
+		// shrinking is optional, so a failed allocation keeps the array
+		long long* ids = new (std::nothrow) long long[list._capacity / 2];
+		if (ids) {
+			for (int i = 0; i < list._size; ++i) {
+				ids[i] = list._ids[i];
+			}
+			delete[] list._ids;
+			list._ids = ids;
+			list._capacity /= 2;
+		}
+	}
+}
+
+void Planet::deleteResidents() {
+	for (int i = 0; i < _size; ++i) {
+		delete[] _residents[i]._ids;
+	}
+	deleteLazyArray(_residents);
+}
+
+void Planet::notifyCapital(int city, int oldCapital, int newCapital) {
+	for (int i = 0; i < _subscribers.size(); ++i) {
+		const Subscriber& subscriber = _subscribers[i];
+		if (subscriber._callback) {
+			subscriber._callback(subscriber._context, city, oldCapital,
+					newCapital, _version);
+		}
+	}
+}
+
+StatusType Planet::SubscribeCapitalChanges(CapitalCallback callback,
+		void* context, int* subscription) {
+	assert(callback && subscription);
+	for (int i = 0; i < _subscribers.size(); ++i) {
+		if (!_subscribers[i]._callback) { // the slot of a cancelled one
+			_subscribers[i] = Subscriber(callback, context);
+			*subscription = i;
+			return SUCCESS;
+		}
+	}
+	_subscribers.pushBack(Subscriber(callback, context));
+	*subscription = _subscribers.size() - 1;
+	return SUCCESS;
+}
+
+StatusType Planet::UnsubscribeCapitalChanges(int subscription) {
+	if (subscription < 0 || subscription >= _subscribers.size()
+			|| !_subscribers[subscription]._callback) {
+		return INVALID_INPUT;
+	}
+	_subscribers[subscription] = Subscriber();
+	return SUCCESS;
+}
+
+class ChangesToArray {
+	int* marks;
+	int* results;
+	int index;
+public:
+	ChangesToArray(int marks[], int results[]) :
+			marks(marks), results(results), index(0) {
+	}
+	void operator()(const Planet::City& city) {
+		if (!marks[city._id]) {
+			marks[city._id] = 1;
+			results[index++] = city._id;
+		}
+	}
+	int count() const {
+		return index;
+	}
+};
+
+StatusType Planet::GetChangesSince(long long version, int cities[],
+		int* count, long long* newVersion) {
+	assert(cities && count && newVersion);
+	if (version < -1 || version > _version) {
+		return INVALID_INPUT;
+	}
+	if (version != -1 && version < _changesFloor) {
+		return FAILURE;
+	}
+	ChangesToArray convert(_marks, cities);
+	if (version != -1) {
+		int first = _changes.size();
+		while (first > 0 && _changes[first - 1]._version > version) {
+			--first;
+		}
+		for (int i = first; i < _changes.size(); ++i) {
+			const Change& change = _changes[i];
+			if (!change._kingdom) {
+				convert(cityAt(internal(change._city)));
+				continue;
+			}
+			// every kingdom is returned once, and is marked by its root
+			int root = _kingdoms.Find(internal(change._city));
+			if (_marks[external(root)] != 2) {
+				forEachKingdomCity(root, convert);
+				_marks[external(root)] = 2;
+			}
+		}
+	}
+	for (int i = 0; i < convert.count(); ++i) {
+		_marks[cities[i]] = 0;
+	}
+	*count = convert.count();
+	*newVersion = _version;
+	return SUCCESS;
+}
+
+class CitizensToSnapshot {
+	Snapshot::Writer& writer;
+public:
+	CitizensToSnapshot(Snapshot::Writer& writer) :
+			writer(writer) {
+	}
+	void operator()(const Planet::Citizen& citizen) {
+		writer.write(citizen._id);
+		writer.write(citizen._city);
+	}
+};
+
+StatusType Planet::SaveSnapshot(const char* path) {
+	assert(path);
+	if (_kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
+	try {
+		Snapshot::Writer writer(path, _rankingType, _size,
+				_kingdomsRanking->size(), _citizens.size(), _lsn);
+		for (int i = 0; i < _size; ++i) {
+			writer.write(_cities[internal(i)]._size);
+		}
+		for (int i = 0; i < _size; ++i) {
+			writer.write(external(_kingdoms.Find(internal(i))));
+		}
+		for (int i = 0; i < _size; ++i) {
+			writer.write(external(_kingdoms.Next(internal(i))));
+		}
+		for (int i = 0; i < _size; ++i) {
+			writer.write(_capitals.Label(i));
+		}
+		const int* bySize = citiesBySize();
+		for (int i = 0; i < _size; ++i) {
+			writer.write(bySize[i]);
+		}
+		int capitals[1024]; // the kingdoms are written a part at a time
+		for (int from = 0; from < _kingdomsRanking->size(); from += 1024) {
+			int to = from + 1023 < _kingdomsRanking->size() ?
+					from + 1023 : _kingdomsRanking->size() - 1;
+			_kingdomsRanking->range(from, to, true, capitals);
+			for (int j = 0; j <= to - from; ++j) {
+				writer.write(capitals[j]);
+			}
+		}
+		CitizensToSnapshot citizens(writer);
+		_citizens.forEach(citizens);
+		writer.commit();
+	} catch (Snapshot::IOError& e) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+StatusType Planet::StartLog(const char* path, int groupSize,
+		int groupMilliseconds) {
+	assert(path);
+	if (_log) {
+		return FAILURE;
+	}
+	try {
+		_log = new WriteAheadLog(path, _lsn, groupSize, groupMilliseconds);
+	} catch (WriteAheadLog::IOError& e) {
+		return FAILURE;
+	} catch (WriteAheadLog::BadLog& e) {
+		return FAILURE;
+	}
 	return SUCCESS;
 }
 
+StatusType Planet::FlushLog() {
+	if (!_log) {
+		return FAILURE;
+	}
+	try {
+		_log->flush();
+	} catch (WriteAheadLog::IOError& e) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+StatusType Planet::StopLog() {
+	StatusType status = FlushLog();
+	delete _log;
+	_log = NULL;
+	return status;
+}
+
+bool Planet::recordUpdate(WriteAheadLog::RecordType type, long long first,
+		int second) {
+	++_lsn;
+	if (!_log) {
+		return true;
+	}
+	if (_log->lsn() != _lsn - 1) { // a record was lost, see append
+		return false;
+	}
+	try {
+		_log->append(type, first, second);
+	} catch (WriteAheadLog::IOError& e) {
+		return false;
+	} catch (std::bad_alloc& e) {
+		return false;
+	}
+	return true;
+}
+
+StatusType Planet::applyRecord(const WriteAheadLog::Record& record) {
+	int city;
+	switch (record._type) {
+	case WriteAheadLog::ADD_CITY:
+		if (AddCity(&city) != SUCCESS || city != record._first) {
+			return FAILURE;
+		}
+		return SUCCESS;
+	case WriteAheadLog::ADD_CITIZEN:
+		if (record._first >= 0 && _citizens.find(Citizen(record._first))) {
+			return FAILURE;
+		}
+		return AddCitizen(record._first);
+	case WriteAheadLog::MOVE_TO_CITY:
+		return MoveToCity(record._first, record._second);
+	case WriteAheadLog::REMOVE_CITIZEN:
+		return RemoveCitizen(record._first);
+	case WriteAheadLog::RELOCATE_CITIZEN:
+		return RelocateCitizen(record._first, record._second);
+	case WriteAheadLog::JOIN_KINGDOMS:
+		if (record._first != (int) record._first) { // not a city
+			return FAILURE;
+		}
+		return JoinKingdoms(record._first, record._second);
+	default:
+		return FAILURE;
+	}
+}
+
+StatusType Planet::ReplayLog(const char* path) {
+	assert(path);
+	if (_log || _kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
+	try {
+		WriteAheadLog::Reader reader(path);
+		WriteAheadLog::Record record;
+		long long lsn;
+		while (reader.next(record, lsn)) {
+			if (lsn <= _lsn) { // already in the planet
+				continue;
+			}
+			if (lsn != _lsn + 1 || applyRecord(record) != SUCCESS
+					|| _lsn != lsn) {
+				return FAILURE;
+			}
+		}
+	} catch (WriteAheadLog::IOError& e) {
+		return FAILURE;
+	} catch (WriteAheadLog::BadLog& e) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+void Planet::publish() {
+	const int* bySize = citiesBySize();
+	int* sizes = new int[_size > 0 ? _size : 1];
+	for (int i = 0; i < _size; ++i) {
+		sizes[i] = _cities[internal(i)]._size;
+	}
+	RankingView* view = NULL;
+	try {
+		view = new RankingView(_version, _size, bySize, sizes);
+	} catch (std::bad_alloc& e) {
+		delete[] sizes;
+		throw;
+	}
+	delete[] sizes;
+	_published.publish(view);
+	_publishedRanking = _rankingVersion;
+}
+
+void Planet::publishIfDue() {
+	if (_publishInterval > 0
+			&& _rankingVersion - _publishedRanking >= _publishInterval) {
+		publish();
+	}
+}
+
+StatusType Planet::PublishRanking(long long* version) {
+	assert(version);
+	publish();
+	*version = _version;
+	return SUCCESS;
+}
+
+StatusType Planet::SetPublishInterval(int interval) {
+	if (interval < 0) {
+		return INVALID_INPUT;
+	}
+	_publishInterval = interval;
+	if (interval > 0) {
+		publish();
+	}
+	return SUCCESS;
+}
+
+StatusType Planet::SelectPublishedCity(int k, int* city, long long* version) {
+	assert(city && version);
+	if (k < 0) {
+		return INVALID_INPUT;
+	}
+	EpochPointer<RankingView>::Reader reader(_published);
+	const RankingView* view = reader.get();
+	if (!view || k >= view->size()) {
+		return FAILURE;
+	}
+	*city = view->cities()[k];
+	*version = view->version();
+	return SUCCESS;
+}
+
+StatusType Planet::GetPublishedCitiesBySize(int results[], int* count,
+		long long* version) {
+	assert(results && count && version);
+	EpochPointer<RankingView>::Reader reader(_published);
+	const RankingView* view = reader.get();
+	if (!view) {
+		return FAILURE;
+	}
+	if (view->size() > 0) {
+		memcpy(results, view->cities(), view->size() * sizeof(int));
+	}
+	*count = view->size();
+	*version = view->version();
+	return SUCCESS;
+}
+
+StatusType Planet::GetPublishedRank(int city, int* rank, long long* version) {
+	assert(rank && version);
+	if (city < 0) {
+		return INVALID_INPUT;
+	}
+	EpochPointer<RankingView>::Reader reader(_published);
+	const RankingView* view = reader.get();
+	if (!view || city >= view->size()) {
+		return FAILURE;
+	}
+	*rank = view->rank(city);
+	*version = view->version();
+	return SUCCESS;
+}
+
+StatusType Planet::CountPublishedCitiesBelow(int size, int* count,
+		long long* version) {
+	assert(count && version);
+	if (size < 0) {
+		return INVALID_INPUT;
+	}
+	EpochPointer<RankingView>::Reader reader(_published);
+	const RankingView* view = reader.get();
+	if (!view) {
+		return FAILURE;
+	}
+	*count = view->countBelow(size);
+	*version = view->version();
+	return SUCCESS;
+}
+
+StatusType Planet::MakeThreadSafe() {
+	if (_lock) {
+		return FAILURE;
+	}
+	_lock = new ReadWriteLock();
+	return SUCCESS;
+}
+
+ReadWriteLock* Planet::GetLock() const {
+	return _lock;
+}
+
+// helping function of GetStats to read the tree counters of @counters
+static void readTreeStats(const ContainerStats& counters, TreeStats* stats) {
+	stats->rotations = counters._treeRotations.value();
+	stats->finds = counters._treeFinds.value();
+	stats->findDepth = counters._treeFindDepth.value();
+	stats->maxFindDepth = counters._treeMaxFindDepth.value();
+}
+
+StatusType Planet::GetStats(PlanetStats* stats) {
+	assert(stats);
+#ifdef WET2_STATS
+	stats->countersEnabled = 1;
+#else
+	stats->countersEnabled = 0;
+#endif
+	readTreeStats(_citizensStats, &stats->citizensTrees);
+	readTreeStats(_rankingsStats, &stats->rankingTrees);
+	const TreeStats& citizens = stats->citizensTrees;
+	const TreeStats& rankings = stats->rankingTrees;
+	stats->treeRotations = citizens.rotations + rankings.rotations;
+	stats->treeFinds = citizens.finds + rankings.finds;
+	stats->treeFindDepth = citizens.findDepth + rankings.findDepth;
+	stats->treeMaxFindDepth =
+			citizens.maxFindDepth > rankings.maxFindDepth ?
+					citizens.maxFindDepth : rankings.maxFindDepth;
+	stats->hashReallocations = _citizensStats._hashReallocations.value();
+	stats->hashReallocationNanoseconds =
+			_citizensStats._hashReallocationNanoseconds.value();
+	stats->unionFinds = _kingdomsStats._unionFinds.value();
+	stats->unionFindPathLength = _kingdomsStats._unionFindPathLength.value();
+	stats->unionFindMaxPathLength =
+			_kingdomsStats._unionFindMaxPathLength.value();
+	stats->citizensBytes = _citizens.memory();
+	long long cities = (long long) _capacity
+			* (sizeof(City) + sizeof(int) + sizeof(Residents));
+	if (_internal) {
+		cities += 2 * (long long) _capacity * sizeof(int);
+	}
+	{ // concurrent readers build the ranking, see MakeThreadSafe
+		std::lock_guard<std::mutex> guard(_bySizeMutex);
+		cities += (long long) _bySizeCapacity * sizeof(int);
+	}
+	for (int i = 0; i < _size; ++i) {
+		cities += (long long) _residents[i]._capacity * sizeof(long long);
+	}
+	stats->citiesBytes = cities;
+	long long kingdoms = _kingdoms.memory() + _capitals.memory()
+			+ (long long) _capacity * sizeof(Tree<KingdomCity>*);
+	for (int i = 0; i < _size; ++i) {
+		if (_rankings[i]) {
+			kingdoms += sizeof(Tree<KingdomCity>) + _rankings[i]->memory();
+		}
+	}
+	stats->kingdomsBytes = kingdoms;
+	stats->citiesRankingBytes = _citiesRanking->memory();
+	stats->kingdomsRankingBytes = _kingdomsRanking->memory();
+	return SUCCESS;
+}
+
+StatusType Planet::BeginTransaction() {
+	if (_kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
+	_kingdoms.Checkpoint();
+	_scatteredBefore = _scattered;
+	return SUCCESS;
+}
+
+StatusType Planet::CommitTransaction() {
+	if (!_kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
+	_kingdoms.Commit();
+	for (int i = 0; i < _journal.size(); ++i) {
+		JoinRecord& join = _journal[i];
+		_capitals.Union(external(join._kingdom), external(join._other),
+				join._joinedCapital);
+		delete join._rootRanking;
+		delete join._otherRanking;
+	}
+	// the joins are logged only once they are committed
+	bool logged = true;
+	for (int i = 0; i < _journal.size(); ++i) {
+		logged = recordUpdate(WriteAheadLog::JOIN_KINGDOMS, _journal[i]._city1,
+				_journal[i]._city2) && logged;
+	}
+	_journal.clear();
+	return logged ? SUCCESS : FAILURE;
+}
+
+StatusType Planet::RollbackTransaction() {
+	if (!_kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
+	++_version;
+	while (_journal.size() > 0) {
+		JoinRecord& join = _journal.back();
+		City& kingdom = cityAt(join._kingdom);
+		City& other = cityAt(join._other);
+		int capital = kingdom._capital, population = kingdom._population;
+		kingdom = join._root;
+		delete _rankings[join._kingdom];
+		_rankings[join._kingdom] = join._rootRanking;
+		_rankings[join._other] = join._otherRanking;
+		// the node of the joined kingdom is reused, and the other kingdom
+		// takes a node reserved by JoinKingdoms, so nothing is allocated
+		_kingdomsRanking->replace(capital, population, kingdom._capital,
+				kingdom._population);
+		_kingdomsRanking->insert(other._capital, other._population);
+		logChange(kingdom._capital, true);
+		logChange(other._capital, true);
+		if (join._joinedCapital != kingdom._capital) {
+			notifyCapital(kingdom._capital, join._joinedCapital,
+					kingdom._capital);
+		}
+		if (join._joinedCapital != other._capital) {
+			notifyCapital(other._capital, join._joinedCapital,
+					other._capital);
+		}
+		_journal.popBack(false);
+	}
+	_kingdoms.Rollback();
+	_scattered = _scatteredBefore;
+	return SUCCESS;
+}
+
+StatusType Planet::CompactCities() {
+	if (_kingdoms.InCheckpoint()) {
+		return FAILURE;
+	}
+	compact();
+	return SUCCESS;
+}
+
+StatusType Planet::SetCompactionThreshold(int percent) {
+	if (percent < 0) {
+		return INVALID_INPUT;
+	}
+	_compactionThreshold = percent;
+	return SUCCESS;
+}
+
+void Planet::compact() {
+	int* newIndex = NULL;
+	int* newInternal = NULL;
+	int* newExternal = NULL;
+	City* newCities = NULL;
+	Tree<KingdomCity>** newRankings = NULL;
+	try {
+		newIndex = new int[_size];
+		newInternal = new int[_size];
+		newExternal = new int[_size];
+		newCities = newLazyArray<City>(_size);
+		newRankings = newLazyArray<Tree<KingdomCity>*>(_size);
+		// every kingdom takes the next block, ordered by its circular list
+		int next = 0;
+		for (int i = 0; i < _size; ++i) {
+			if (_kingdoms.Find(i) != i) {
+				continue;
+			}
+			int current = i;
+			do {
+				newIndex[current] = next++;
+				current = _kingdoms.Next(current);
+			} while (current != i);
+		}
+		_kingdoms.Relabel(newIndex);
+	} catch (std::bad_alloc& e) {
+		deleteLazyArray(newRankings);
+		deleteLazyArray(newCities);
+		delete[] newExternal;
+		delete[] newInternal;
+		delete[] newIndex;
+		throw;
+	}
+	for (int i = 0; i < _size; ++i) {
+		newCities[newIndex[i]] = cityAt(i);
+		newRankings[newIndex[i]] = _rankings[i];
+		newExternal[newIndex[i]] = external(i);
+		newInternal[external(i)] = newIndex[i];
+	}
+	for (int i = 0; i < _size; ++i) {
+		City& root = newCities[_kingdoms.Find(i)];
+		if (i == 0 || _kingdoms.Find(i - 1) != _kingdoms.Find(i)) {
+			root._first = i;
+		}
+		root._last = i;
+	}
+	deleteLazyArray(_cities);
+	deleteLazyArray(_rankings);
+	delete[] _internal;
+	delete[] _external;
+	delete[] newIndex;
+	_cities = newCities;
+	_rankings = newRankings;
+	_internal = newInternal;
+	_external = newExternal;
+	_capacity = _size;
+	_scattered = 0;
+}
+
 Planet::~Planet() {
-	delete[] _cities;
+	delete _log;
+	delete _lock;
+	delete[] _bySize;
+	delete _citiesRanking;
+	delete _kingdomsRanking;
+	for (int i = 0; i < _size; ++i) {
+		delete _rankings[i];
+	}
+	for (int i = 0; i < _journal.size(); ++i) {
+		delete _journal[i]._rootRanking;
+		delete _journal[i]._otherRanking;
+	}
+	deleteLazyArray(_rankings);
+	deleteLazyArray(_marks);
+	deleteResidents();
+	deleteLazyArray(_cities);
+	delete[] _internal;
+	delete[] _external;
 }
 
 Planet::City::City() :
-		_id(-1), _size(0), _capital(-1) {
+		_id(-1), _size(0), _capital(-1), _population(0), _first(-1), _last(-1) {
 }
 
 Planet::City::City(int id, int size) :
-		_id(id), _size(size), _capital(_id) {
+		_id(id), _size(size), _capital(_id), _population(size), _first(id), _last(
+				id) {
 }
 
 bool operator<(const Planet::City& city1, const Planet::City& city2) {
@@ -163,8 +1857,8 @@ bool operator!=(const Planet::City& city1, const Planet::City& city2) {
 	return !(city1 == city2);
 }
 
-Planet::Citizen::Citizen(int id) :
-		_id(id), _city(-1) {
+Planet::Citizen::Citizen(long long id) :
+		_id(id), _city(-1), _slot(-1) {
 }
 
 int Planet::Citizen::inCity() const {
@@ -192,9 +1886,73 @@ bool operator!=(const Planet::Citizen& citizen1,
 }
 
 int Planet::Citizen::operator %(int i) const {
-	return _id % i;
+	unsigned long long hash = _id;
+	if (hash >> 31) { // a 64-bit ID, whose low bits may all be alike
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+	}
+	return hash % i;
 }
 
 void Planet::Citizen::joinCity(int city) {
 	_city = city;
 }
+
+Planet::JoinRecord::JoinRecord() :
+		_kingdom(-1), _other(-1), _joinedCapital(-1), _city1(-1), _city2(-1), _rootRanking(
+				NULL), _otherRanking(NULL) {
+}
+
+Planet::JoinRecord::JoinRecord(int kingdom, int other, const City& root) :
+		_kingdom(kingdom), _other(other), _root(root), _joinedCapital(
+				root._capital), _city1(-1), _city2(-1), _rootRanking(NULL), _otherRanking(
+				NULL) {
+}
+
+Planet::Change::Change() :
+		_version(-1), _city(-1), _kingdom(false) {
+}
+
+Planet::Change::Change(long long version, int city, bool kingdom) :
+		_version(version), _city(city), _kingdom(kingdom) {
+}
+
+Planet::Subscriber::Subscriber() :
+		_callback(NULL), _context(NULL) {
+}
+
+Planet::Subscriber::Subscriber(CapitalCallback callback, void* context) :
+		_callback(callback), _context(context) {
+}
+
+Planet::KingdomCity::KingdomCity() :
+		_id(-1), _size(0) {
+}
+
+Planet::KingdomCity::KingdomCity(int id, int size) :
+		_id(id), _size(size) {
+}
+
+bool operator<(const Planet::KingdomCity& city1,
+		const Planet::KingdomCity& city2) {
+	if (city1._size != city2._size) {
+		return city1._size < city2._size;
+	}
+	return city1._id > city2._id;
+}
+
+bool operator>(const Planet::KingdomCity& city1,
+		const Planet::KingdomCity& city2) {
+	return city2 < city1;
+}
+
+bool operator==(const Planet::KingdomCity& city1,
+		const Planet::KingdomCity& city2) {
+	return city1._id == city2._id;
+}
+
+bool operator!=(const Planet::KingdomCity& city1,
+		const Planet::KingdomCity& city2) {
+	return !(city1 == city2);
+}
@@ -5,17 +5,65 @@
 #include "tree.h"
 #include "hashTable.h"
 #include "unionFind.h"
+#include "concurrentUnionFind.h"
+#include "dynamicArray.h"
+#include "cityRanking.h"
+#include "ringBuffer.h"
+#include "snapshot.h"
+#include "writeAheadLog.h"
+#include "readWriteLock.h"
+#include "epochPointer.h"
+#include "rankingView.h"
+#include <atomic>	// std::atomic
+#include <mutex>	// std::mutex
+
+class CitizenCsv;
 
 class Planet {
 public:
 	/* Empty constructor :
 	 * Description:   Initializes the planet with n cities.
 	 * Input:         n - Number of cities in the planet.
+	 *                ranking - The engine ranking the cities by size (see
+	 *                CityRanking). RANKING_BUCKETS suits planets whose
+	 *                cities change by few citizens at a time.
 	 * Output:        None.
 	 * Return Values: A new object of the data structure.
-	 * Time Complexity: O(n).
+	 * Time Complexity: O(n/64), which builds the bitmaps of the cities and
+	 * 					the kingdoms of size 0 (see TreeRanking). The other
+	 * 					arrays are lazy (see lazyArray.h), and a city is made
+	 * 					on its first use.
+	 */
+	explicit Planet(int n, RankingType ranking = RANKING_TREE);
+
+	/* Snapshot constructor :
+	 * Description:   Restores the planet saved in a snapshot (see
+	 *                SaveSnapshot). The kingdoms and their capitals are
+	 *                copied from the snapshot as they are, and the rankings
+	 *                are built from the ranked arrays of the snapshot.
+	 * Input:         snapshot - An open snapshot.
+	 * Output:        None.
+	 * Return Values: A new object of the data structure.
+	 * Time Complexity: O(n + m) in average, whereas m is the number of the
+	 * 					citizens (the RANKING_BUCKETS engine takes
+	 * 					O(n log n) at most).
+	 */
+	explicit Planet(const Snapshot& snapshot);
+
+	/* Description:   A new city is added to the planet, as a kingdom of its
+	 *                own. The cities are stored in arrays that grow by
+	 *                doubling.
+	 * Input:         None.
+	 * Output:        city - The ID of the new city, which is the number of
+	 *                cities in the planet before the addition.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                INVALID_INPUT - If city==NULL.
+	 *                FAILURE - If a transaction is in progress or in case of
+	 *                any other error.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(log n) amortized.
 	 */
-	explicit Planet(int n);
+	StatusType AddCity(int* city);
 
 	/* Description:   A citizen was added to the planet.
 	 * Input:         citizenID - The ID of the citizen.
@@ -27,7 +75,7 @@ public:
 	 *                SUCCESS - Otherwise.
 	 * Time Complexity: O(1) in amortized average.
 	 */
-	StatusType AddCitizen(int citizenID);
+	StatusType AddCitizen(long long citizenID);
 
 	/* Description:   A citizen with ID citizenID decides to live in city.
 	 * Input:         citizenID - The ID of the citizen.
@@ -42,7 +90,93 @@ public:
 	 *                SUCCESS - Otherwise.
 	 * Time Complexity: O(log n) in average.
 	 */
-	StatusType MoveToCity(int citizenID, int city);
+	StatusType MoveToCity(long long citizenID, int city);
+
+	/* Description:   A citizen with ID citizenID leaves the planet. If the
+	 *                citizen lives in a city, the city shrinks and the
+	 *                capital of its kingdom is updated.
+	 * Input:         citizenID - The ID of the citizen.
+	 * Output:        None.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                INVALID_INPUT - If citizenID<0.
+	 *                FAILURE - If there is no citizen in the planet with this
+	 *                ID, a transaction is in progress or in case of any other
+	 *                error.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(log n) amortized, see SelectCityInKingdom: finding
+	 * 					the new capital when a capital shrinks uses the ranking
+	 * 					of its kingdom.
+	 */
+	StatusType RemoveCitizen(long long citizenID);
+
+	/* Description:   Moves count citizens to cities, as if MoveToCity was
+	 *                called for each one in order. The moves are validated
+	 *                first while counting the citizens moved into every
+	 *                city, and then every city that grew is repositioned and
+	 *                its kingdom's capital is updated once, however many
+	 *                citizens moved into it. Thus the subscribers and
+	 *                GetChangesSince see one net change of the capital per
+	 *                city, not the changes of the moves one by one.
+	 * Input:         citizenIDs - The identifiers of the citizens.
+	 *                cities - The city of the i-th citizen.
+	 *                count - The number of moves.
+	 * Output:        statuses - An array of size count where the result of
+	 *                the i-th move will be written, as MoveToCity returns it.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                INVALID_INPUT - If count<0 or any array is NULL.
+	 *                SUCCESS - Otherwise.
+	 * The identifiers are given either as ints or as 64-bit long longs.
+	 * Time Complexity: O(count + t*log n) in average, whereas t is the
+	 * 					number of distinct cities moved into.
+	 */
+	StatusType MoveToCityBatch(const int citizenIDs[], const int cities[],
+			int count, StatusType statuses[]);
+	StatusType MoveToCityBatch(const long long citizenIDs[],
+			const int cities[], int count, StatusType statuses[]);
+
+	/* Description:   A citizen with ID citizenID moves to live in city,
+	 *                leaving the city in which the citizen lived, if any.
+	 * Input:         citizenID - The ID of the citizen.
+	 *                city - The ID of the city.
+	 * Output:        None.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                INVALID_INPUT - If citizenID<0 or city is an illegal city
+	 *                number.
+	 *                FAILURE - If there is no citizen in the planet with this
+	 *                ID, a transaction is in progress or in case of any other
+	 *                error.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(log n) amortized, as in RemoveCitizen.
+	 */
+	StatusType RelocateCitizen(long long citizenID, int city);
+
+	/* Description:   Imports the citizens of the CSV at path (see
+	 *                citizenCsv.h), as if AddCitizen(citizenID) and then
+	 *                MoveToCity(citizenID, city) were called for every row in
+	 *                order, ignoring their errors. The file is parsed by a
+	 *                thread per core, and every city that grows is resized
+	 *                once by its total. If more than 1/REBUILD_RANKING of the
+	 *                cities grow, the ranking of the cities is rebuilt rather
+	 *                than updated city by city. The rows are logged once
+	 *                the cities are resized. After an allocation error the
+	 *                citizens who joined the cities which were not resized
+	 *                yet move back (all of them if the ranking is rebuilt,
+	 *                as the resizes are then undone), and only the rest is
+	 *                logged.
+	 * Input:         path - The path of the CSV.
+	 * Output:        rows - The number of rows in the file.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                FAILURE - If the file cannot be read or has a line which
+	 *                is not a row, in which case nothing is imported, if a
+	 *                transaction is in progress or in case of any other error.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(L/t + r) in average, whereas L is the length of the
+	 * 					file, t the number of cores and r the number of rows,
+	 * 					plus O(n + s) to rebuild the ranking, whereas s is the
+	 * 					largest size of a city, or O(g*log n) otherwise,
+	 * 					whereas g is the number of cities that grow.
+	 */
+	StatusType ImportCitizens(const char* path, long long* rows);
 
 	/* Description:   Joins two kingdoms of city1 and city2 together.
 	 *				  This can happen only if the cities are the kingdoms' capitals.
@@ -56,7 +190,7 @@ public:
 	 *                both cities belong to the same capital, or in case of any
 	 *                other error.
 	 *                SUCCESS - Otherwise.
-	 * Time Complexity: O(log* n) amortized.
+	 * Time Complexity: O(log n).
 	 */
 	StatusType JoinKingdoms(int city1, int city2);
 
@@ -73,9 +207,35 @@ public:
 	 *                FAILURE - If there is no citizen in the planet with this
 	 *                ID or in case of any other error.
 	 *                SUCCESS - Otherwise.
-	 * Time Complexity: O(log* n) in amortized average.
+	 * Outside of a transaction, the capital is read from a lock-free mirror
+	 * of the kingdoms, so GetCapital may run concurrently with other
+	 * GetCapital calls and with JoinKingdoms.
+	 * Time Complexity: O(log n) expected in average.
 	 */
-	StatusType GetCapital(int citizenID, int* capital);
+	StatusType GetCapital(long long citizenID, int* capital);
+
+	/* Description:   Returns the capitals of the kingdoms in which count
+	 *                citizens live, as if GetCapital was called for each one.
+	 *                The lookups are processed in groups whose memory is
+	 *                prefetched level by level, so that the cache misses of
+	 *                the group's lookups overlap instead of following each
+	 *                other.
+	 * Input:         citizenIDs - The identifiers of the citizens.
+	 *                count - The number of citizens.
+	 * Output:        capitals - An array of size count where the capital of
+	 *                the i-th citizen will be written.
+	 *                statuses - An array of size count where the result of
+	 *                the i-th lookup will be written, as GetCapital returns
+	 *                it.
+	 * Return Values: INVALID_INPUT - If count<0 or any array is NULL.
+	 *                SUCCESS - Otherwise.
+	 * The identifiers are given either as ints or as 64-bit long longs.
+	 * Time Complexity: O(count * log n) expected in average.
+	 */
+	StatusType GetCapitalBatch(const int citizenIDs[], int count,
+			int capitals[], StatusType statuses[]);
+	StatusType GetCapitalBatch(const long long citizenIDs[], int count,
+			int capitals[], StatusType statuses[]);
 
 	/* Description:   Returns the city ranked in the k-th place when all the
 	 * cities in the planet are ordered by size.
@@ -85,7 +245,10 @@ public:
 	 *                FAILURE - If there is no city in the required rank or in
 	 *                case of any other error.
 	 *                SUCCESS - Otherwise.
-	 * Time Complexity: O(log n).
+	 * Time Complexity: O(log n), or O(1) if the answer is cached: until the
+	 * 					size of a city changes, the answers are read from the
+	 * 					array cached by GetCitiesBySize, or else from a cache
+	 * 					of recent answers.
 	 */
 	StatusType SelectCity(int k, int* city);
 
@@ -96,10 +259,471 @@ public:
 	 *                INVALID_INPUT - If results==NULL.
 	 *                FAILURE - In case of an error.
 	 *                SUCCESS - Otherwise.
-	 * Time Complexity: O(n).
+	 * Time Complexity: O(n). The ranking is cached until the size of a city
+	 * 					changes, so repeated calls only copy it. It is
+	 * 					built by a thread per core, each writing the slice
+	 * 					of ranks it found in the ranking (see parallelRange).
 	 */
 	StatusType GetCitiesBySize(int results[]);
 
+	/* Description:   Returns the k largest cities, from the largest one, that
+	 *                is the last k cities of GetCitiesBySize in reverse order.
+	 * Input:         k - The number of cities.
+	 * Output:        results - An array of size k where the cities will be
+	 *                written.
+	 * Return Values: INVALID_INPUT - If k<0 or results==NULL.
+	 *                FAILURE - If k>n or in case of any other error.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(log n + k).
+	 */
+	StatusType GetTopCities(int k, int results[]);
+
+	/* Description:   Returns the cities ranked from-th to to-th by size. If
+	 *                ascending is true the cities are ranked from the
+	 *                smallest, as in SelectCity, otherwise from the largest,
+	 *                as in GetTopCities. Either way the from-th city is the
+	 *                first to be written.
+	 * Input:         from, to - The range of ranks (0-based, inclusive).
+	 *                ascending - The direction of the ranking.
+	 * Output:        results - An array of size to-from+1 where the cities
+	 *                will be written.
+	 * Return Values: INVALID_INPUT - If from<0, to<from or results==NULL.
+	 *                FAILURE - If to>=n or in case of any other error.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(log n + k) whereas k=to-from+1.
+	 */
+	StatusType GetCitiesInRankRange(int from, int to, bool ascending,
+			int results[]);
+
+	/* Description:   Returns the cities of the kingdom to which city belongs.
+	 *                If the kingdom's cities are stored contiguously (see
+	 *                CompactCities) they are read sequentially, otherwise the
+	 *                kingdom's circular list is followed.
+	 * Input:         city - The identifier of a city in the kingdom.
+	 * Output:        cities - An array of size n where the cities of the
+	 *                kingdom will be written, in no particular order.
+	 *                count - The number of cities written to cities.
+	 * Return Values: INVALID_INPUT - If cities==NULL, count==NULL or city is
+	 *                an illegal city number.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(k) whereas k is the number of cities in the kingdom.
+	 */
+	StatusType GetKingdomCities(int city, int cities[], int* count);
+
+	/* Description:   Returns the number of cities in the kingdom to which
+	 *                city belongs.
+	 * Input:         city - The identifier of a city in the kingdom.
+	 * Output:        size - The number of cities in the kingdom.
+	 * Return Values: INVALID_INPUT - If size==NULL or city is an illegal
+	 *                city number.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(log* n) amortized.
+	 */
+	StatusType GetKingdomSize(int city, int* size);
+
+	/* Description:   Returns the number of citizens living in the kingdom to
+	 *                which city belongs.
+	 * Input:         city - The identifier of a city in the kingdom.
+	 * Output:        population - The number of citizens in the kingdom.
+	 * Return Values: INVALID_INPUT - If population==NULL or city is an
+	 *                illegal city number.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(log* n) amortized.
+	 */
+	StatusType GetKingdomPopulation(int city, int* population);
+
+	/* Description:   Returns a page of the citizens living in city: the
+	 *                citizens from the offset-th to the (offset+max-1)-th
+	 *                of the city's resident list. The list is in no
+	 *                particular order, but it only changes when a citizen
+	 *                joins or leaves the city, so the pages read between
+	 *                such changes make up the whole list.
+	 * Input:         city - The identifier of the city.
+	 *                offset - The place in the list of the first citizen to
+	 *                return.
+	 *                max - The number of citizens that fit in residents.
+	 * Output:        residents - The IDs of the citizens.
+	 *                count - The number of citizens written to residents,
+	 *                less than max once the list's end is reached.
+	 * Return Values: INVALID_INPUT - If residents==NULL, count==NULL,
+	 *                offset<0, max<0 or city is an illegal city number.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(k) whereas k is the number of citizens returned.
+	 */
+	StatusType GetCityResidents(int city, int offset, long long residents[],
+			int max, int* count);
+
+	/* Description:   Returns the number of kingdoms in the planet.
+	 * Input:         None.
+	 * Output:        count - The number of kingdoms.
+	 * Return Values: INVALID_INPUT - If count==NULL.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(1).
+	 */
+	StatusType GetNumberOfKingdoms(int* count);
+
+	/* Description:   Returns the capital of the kingdom ranked in the k-th
+	 *                place when all the kingdoms in the planet are ordered by
+	 *                population (and by the capitals' IDs for equal
+	 *                populations).
+	 * Input:         k - The rank.
+	 * Output:        capital - The identifier of the k-th kingdom's capital.
+	 * Return Values: INVALID_INPUT - If k<0 or capital==NULL.
+	 *                FAILURE - If there is no kingdom in the required rank.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(log n).
+	 */
+	StatusType SelectKingdom(int k, int* capital);
+
+	/* Description:   Returns the capitals of all the kingdoms ranked by the
+	 *                kingdoms' populations.
+	 * Input:         None.
+	 * Output:        results - An array of size n where the capitals will be
+	 *                written.
+	 *                count - The number of capitals written to results.
+	 * Return Values: INVALID_INPUT - If results==NULL or count==NULL.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(k) whereas k is the number of kingdoms.
+	 */
+	StatusType GetKingdomsByPopulation(int results[], int* count);
+
+	/* Description:   Returns the city ranked in the k-th place when the cities
+	 *                of the kingdom to which city belongs are ordered from the
+	 *                largest to the smallest, where cities of equal size are
+	 *                ordered by their IDs. Thus the kingdom's capital is ranked
+	 *                in the 0-th place.
+	 * Input:         city - The identifier of a city in the kingdom.
+	 *                k - The rank.
+	 * Output:        result - The identifier of the k-th city.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                INVALID_INPUT - If k<0, result==NULL or city is an
+	 *                illegal city number.
+	 *                FAILURE - If there is no city in the required rank.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(log n) amortized, see below.
+	 * The ranking of a kingdom is built on its first use, in O(k log k)
+	 * whereas k is the number of cities in the kingdom, and is then kept up to
+	 * date by MoveToCity and JoinKingdoms (which merges the ranking of the
+	 * smaller kingdom into the larger one's).
+	 */
+	StatusType SelectCityInKingdom(int city, int k, int* result);
+
+	/* Description:   Returns the cities of the kingdom to which city belongs,
+	 *                ordered from the largest to the smallest as in
+	 *                SelectCityInKingdom.
+	 * Input:         city - The identifier of a city in the kingdom.
+	 * Output:        results - An array of size n where the cities will be
+	 *                written.
+	 *                count - The number of cities written to results.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                INVALID_INPUT - If results==NULL, count==NULL or city is
+	 *                an illegal city number.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(k) amortized whereas k is the number of cities in the
+	 * 					kingdom.
+	 */
+	StatusType GetKingdomCitiesBySize(int city, int results[], int* count);
+
+	/* Description:   Returns the cities whose size or capital changed since
+	 *                version, so that a copy of the ranking can be kept up
+	 *                to date without reading all of it. The changes are
+	 *                kept in a log of the last CHANGE_LOG changes. When the
+	 *                capital of a kingdom changes, all the cities of the
+	 *                kingdom (as it is when the changes are read) are
+	 *                returned, which may include cities joined to it whose
+	 *                capital stayed the same.
+	 * Input:         version - The version returned by the previous call,
+	 *                or -1 to only read the current version (e.g. right
+	 *                after reading the whole ranking).
+	 * Output:        cities - An array of size n where the changed cities
+	 *                will be written, each one once, in no particular order.
+	 *                count - The number of cities written to cities.
+	 *                newVersion - The current version, to be passed to the
+	 *                next call.
+	 * Return Values: INVALID_INPUT - If version<-1, version is newer than
+	 *                the current version, or any pointer is NULL.
+	 *                FAILURE - If some of the changes since version were
+	 *                dropped from the log, in which case the whole ranking
+	 *                should be read again.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(e + k) whereas e is the number of changes since
+	 * 					version and k is the number of cities written.
+	 */
+	StatusType GetChangesSince(long long version, int cities[], int* count,
+			long long* newVersion);
+
+	/* Description:   Writes the planet to a snapshot file, from which the
+	 *                planet can be restored (see the snapshot constructor).
+	 *                The snapshot is written to a temporary file which
+	 *                replaces the file at path once it is complete.
+	 * Input:         path - The path of the snapshot file.
+	 * Output:        None.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                FAILURE - If a transaction is in progress or the file
+	 *                cannot be written.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(n + m) whereas m is the number of the citizens.
+	 */
+	StatusType SaveSnapshot(const char* path);
+
+	/* Description:   Starts logging the updates of the planet to a
+	 *                write-ahead log (see WriteAheadLog), so that the planet
+	 *                can be recovered by replaying the log on a snapshot
+	 *                (see ReplayLog). Every successful update is recorded
+	 *                (the joins of a transaction once it is committed), and
+	 *                the records are flushed to the disk in groups of
+	 *                groupSize records, or once the first record of a group
+	 *                is groupMilliseconds old. If the log exists, it must
+	 *                end with the last update of the planet (e.g. a log that
+	 *                was replayed by ReplayLog), and the records are added
+	 *                to it.
+	 * Input:         path - The path of the log.
+	 *                groupSize - The number of records flushed together, or
+	 *                1 to flush every record.
+	 *                groupMilliseconds - The time a record may wait to be
+	 *                flushed, or 0 for no limit.
+	 * Output:        None.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                FAILURE - If a log is already open, or the log cannot
+	 *                be opened or does not end with the last update.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(1), or O(l) to read an existing log of length l.
+	 * If a record cannot be written, the update is made but returns FAILURE.
+	 * The record is kept and written again by the next flush, unless it could
+	 * not be kept, after which every update returns FAILURE until StopLog.
+	 */
+	StatusType StartLog(const char* path, int groupSize, int groupMilliseconds);
+
+	/* Description:   Flushes the records of the log to the disk.
+	 * Input:         None.
+	 * Output:        None.
+	 * Return Values: FAILURE - If no log is open or the records cannot be
+	 *                written.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(groupSize) plus the time of the disk.
+	 */
+	StatusType FlushLog();
+
+	/* Description:   Flushes the log and stops logging the updates.
+	 * Input:         None.
+	 * Output:        None.
+	 * Return Values: FAILURE - If no log is open or the records cannot be
+	 *                written, in which case they are lost.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(groupSize) plus the time of the disk.
+	 */
+	StatusType StopLog();
+
+	/* Description:   Applies the updates recorded in a log after the last
+	 *                update of the planet (e.g. of a planet restored from a
+	 *                snapshot), up to the end of the log or a group of
+	 *                records that was not written completely. The updates are
+	 *                numbered by their order since the planet was
+	 *                initialized, and snapshots save the number of the last
+	 *                one, so the log may begin before the planet's last
+	 *                update.
+	 * Input:         path - The path of the log.
+	 * Output:        None.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                FAILURE - If a log is open, a transaction is in
+	 *                progress, the log cannot be read, it misses updates
+	 *                after the last update of the planet, or an update
+	 *                fails. The updates applied before the failure are
+	 *                kept.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(l log n) in average, whereas l is the number of
+	 * 					records.
+	 */
+	StatusType ReplayLog(const char* path);
+
+	/* Description:   Publishes an immutable copy of the ranking of the
+	 *                cities by size (see RankingView), which the
+	 *                Published queries read without locks, while the
+	 *                planet keeps changing. The copy replaces the previous
+	 *                one, which is deleted once its last reader is done
+	 *                (see EpochPointer).
+	 * Input:         None.
+	 * Output:        version - The version of the planet which the copy
+	 *                holds (see GetChangesSince).
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(n).
+	 */
+	StatusType PublishRanking(long long* version);
+
+	/* Description:   Makes the updates publish the ranking by themselves
+	 *                once the sizes of the cities changed interval times
+	 *                since it was last published, and publishes it now.
+	 * Input:         interval - The number of changes, or 0 to publish
+	 *                only by PublishRanking (the default).
+	 * Output:        None.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                INVALID_INPUT - If interval<0.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(n) if interval>0, O(1) otherwise. The updates then
+	 * 					take O(n/interval) more amortized.
+	 */
+	StatusType SetPublishInterval(int interval);
+
+	/* Description:   The queries of the published ranking, which may run
+	 *                concurrently with any other call (but Quit), as they
+	 *                only read the published copy: the city ranked in the
+	 *                k-th place, as SelectCity; all the cities ranked by
+	 *                size, as GetCitiesBySize; the rank of city; and the
+	 *                number of cities of less than size citizens.
+	 * Input:         k, city, size - As described above.
+	 * Output:        city, results, rank, count - The answer, where count
+	 *                is the number of cities written to results.
+	 *                version - The version of the copy, so that its
+	 *                staleness can be told (see GetChangesSince).
+	 * Return Values: INVALID_INPUT - If k<0, city<0, size<0 or a pointer
+	 *                is NULL.
+	 *                FAILURE - If no ranking was published, or k or city
+	 *                are not in the published ranking.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(1) for SelectPublishedCity, O(k) for
+	 * 					GetPublishedCitiesBySize whereas k is the number of
+	 * 					cities, and O(log n) otherwise.
+	 */
+	StatusType SelectPublishedCity(int k, int* city, long long* version);
+	StatusType GetPublishedCitiesBySize(int results[], int* count,
+			long long* version);
+	StatusType GetPublishedRank(int city, int* rank, long long* version);
+	StatusType CountPublishedCitiesBelow(int size, int* count,
+			long long* version);
+
+	/* Description:   Makes the planet thread-safe: the planet gets a lock
+	 *                (see GetLock) which the calls take as readers or as the
+	 *                writer. SelectCity, GetCitiesBySize, GetTopCities,
+	 *                GetCitiesInRankRange, GetCapital and GetCapitalBatch only
+	 *                read the planet, so they may take the lock as readers
+	 *                and run concurrently: the ranking cached by
+	 *                GetCitiesBySize is built by one reader at a time, and the
+	 *                cache of SelectCity's answers is not used.
+	 *                The other calls change the planet (including its
+	 *                caches) and must take the lock as the writer.
+	 * Input:         None.
+	 * Output:        None.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                FAILURE - If the planet is already thread-safe.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(1).
+	 */
+	StatusType MakeThreadSafe();
+
+	/* Description:   Returns the lock of the planet, or NULL if it is not
+	 *                thread-safe (see MakeThreadSafe).
+	 * Time Complexity: O(1).
+	 */
+	ReadWriteLock* GetLock() const;
+
+	/* Description:   Returns the counters of the containers of the planet
+	 *                (see stats.h) and the bytes allocated by every part of
+	 *                it, see GetStats in library2.h. Like GetCapital, it
+	 *                only reads the planet.
+	 * Input:         None.
+	 * Output:        stats - The statistics.
+	 * Return Values: SUCCESS.
+	 * Time Complexity: O(n + t) whereas t is the size of the hash table of
+	 * 					the citizens.
+	 */
+	StatusType GetStats(PlanetStats* stats);
+
+	/* Description:   Registers @callback to be called whenever the capital
+	 *                of a kingdom changes: when a city overtakes its
+	 *                kingdom's capital or the capital shrinks below another
+	 *                city (MoveToCity, RemoveCitizen and the like), when a
+	 *                kingdom is joined into another (JoinKingdoms), and when
+	 *                a transaction is rolled back. The callback gets
+	 *                @context, a city of the kingdom, the old and the new
+	 *                capital and the version after the change (see
+	 *                GetChangesSince). It is called during the update, so
+	 *                it must not call the planet.
+	 * Input:         callback - The function to call.
+	 *                context - Passed to the callback as is.
+	 * Output:        subscription - The identifier of the subscription.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(s) amortized whereas s is the number of
+	 * 					subscriptions.
+	 */
+	StatusType SubscribeCapitalChanges(CapitalCallback callback,
+			void* context, int* subscription);
+
+	/* Description:   Cancels a subscription of SubscribeCapitalChanges.
+	 * Input:         subscription - The identifier of the subscription.
+	 * Output:        None.
+	 * Return Values: INVALID_INPUT - If there is no such subscription.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(1).
+	 */
+	StatusType UnsubscribeCapitalChanges(int subscription);
+
+	/* Description:   Starts a what-if transaction. Until it is committed or
+	 *                rolled back, JoinKingdoms calls are recorded so they can
+	 *                be undone, and all the queries reflect them. The other
+	 *                updates (e.g. AddCitizen) fail during a transaction.
+	 * Input:         None.
+	 * Output:        None.
+	 * Return Values: FAILURE - If a transaction is already in progress.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(1) amortized.
+	 */
+	StatusType BeginTransaction();
+
+	/* Description:   Ends the current transaction while keeping all the
+	 *                kingdoms joined during it.
+	 * Input:         None.
+	 * Output:        None.
+	 * Return Values: FAILURE - If there is no transaction in progress.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(1) amortized.
+	 */
+	StatusType CommitTransaction();
+
+	/* Description:   Ends the current transaction and undoes all the kingdoms
+	 *                joined during it, restoring their capitals and
+	 *                populations. It allocates nothing, as the joins made
+	 *                room for their undoing.
+	 * Input:         None.
+	 * Output:        None.
+	 * Return Values: FAILURE - If there is no transaction in progress.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(k log n) whereas k is the number of kingdoms joined
+	 * 					during the transaction.
+	 */
+	StatusType RollbackTransaction();
+
+	/* Description:   Renumbers the cities internally so that the cities of
+	 *                every kingdom are stored contiguously, in the order of
+	 *                the kingdom's circular list. The identifiers of the
+	 *                cities seen by the user do not change.
+	 * Input:         None.
+	 * Output:        None.
+	 * Return Values: ALLOCATION_ERROR - In case of an allocation error.
+	 *                FAILURE - If a transaction is in progress.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(n).
+	 */
+	StatusType CompactCities();
+
+	/* Description:   Sets the fragmentation at which JoinKingdoms compacts the
+	 *                cities by itself. The fragmentation is the number of
+	 *                cities joined into a kingdom that did not stay
+	 *                contiguous since the last compaction (counting the
+	 *                smaller kingdom of each join), in percents of n.
+	 * Input:         percent - The threshold, or 0 to never compact
+	 *                automatically (the default).
+	 * Output:        None.
+	 * Return Values: INVALID_INPUT - If percent<0.
+	 *                SUCCESS - Otherwise.
+	 * Time Complexity: O(1).
+	 * Since the smaller kingdom of every join is counted, every city is
+	 * counted O(log n) times, so with a threshold of p percents the automatic
+	 * compactions cost O(log n / p) amortized per join.
+	 */
+	StatusType SetCompactionThreshold(int percent);
+
 	/* Destructor :
 	 * Description:   Deletes the database.
 	 * Input:         None.
@@ -112,13 +736,172 @@ public:
 
 	class City;
 	class Citizen;
+	class JoinRecord;
+	class KingdomCity;
+	class Change;
+	class Subscriber;
+	class Residents;
+
+	static const int CHANGE_LOG = 1 << 16;	// changes kept for GetChangesSince
 
 private:
 	int _size;
-	Tree<City> _citiesTree;
+	int _capacity;	// size of the arrays of the cities
+	RankingType _rankingType;
+	CityRanking* _citiesRanking;
+	TreeRanking* _kingdomsRanking;	// the capitals ranked by population
 	HashTable<Citizen> _citizens;
 	UnionFind<City> _kingdoms;
+	ConcurrentUnionFind _capitals;	// committed kingdoms labeled by capitals
 	City* _cities;
+	DynamicArray<JoinRecord> _journal;	// kingdoms joined in the transaction
+	/* The cities and the kingdoms are stored by internal indices, which are
+	 * changed by CompactCities. _internal maps an ID to its index and
+	 * _external maps back, both are NULL until the first compaction.
+	 */
+	int* _internal;
+	int* _external;
+	int _scattered;			// fragmentation since the last compaction
+	int _scatteredBefore;	// _scattered when the transaction began
+	int _compactionThreshold;
+	/* The ranking of the cities of every kingdom, stored by the kingdom's
+	 * root, or NULL if it was not built yet (see SelectCityInKingdom).
+	 */
+	Tree<KingdomCity>** _rankings;
+	/* Marks of every city by its ID, 0 between calls: the citizens moved into
+	 * the city by MoveToCityBatch, or whether GetChangesSince has returned
+	 * the city.
+	 */
+	int* _marks;
+	Residents* _residents;	// the citizens of every city by its ID
+	long long _version;			// bumped by every change of sizes or capitals
+	long long _rankingVersion;	// the version of the last change of sizes
+	/* The cities ranked by size as GetCitiesBySize returns them, which is
+	 * valid if _bySizeVersion is _rankingVersion. It is built by
+	 * GetCitiesBySize and serves the other ranking queries until a city's
+	 * size changes.
+	 */
+	int* _bySize;
+	int _bySizeCapacity;
+	std::atomic<long long> _bySizeVersion;	// checked by concurrent readers
+	std::mutex _bySizeMutex;	// held by the reader building _bySize
+	/* Recent answers of SelectCity, where k is cached in the slot k%64, and
+	 * a slot is valid if its version is _rankingVersion.
+	 */
+	static const int SELECT_CACHE = 64;
+	static const int REBUILD_RANKING = 8;	// see ImportCitizens
+	// what a row of ImportCitizens did: added its citizen, moved it (or
+	// found it in its city) and made it join its city
+	static const char ROW_ADDED = 1, ROW_MOVED = 2, ROW_JOINED = 4;
+	int _selectKeys[SELECT_CACHE];
+	int _selectCities[SELECT_CACHE];
+	long long _selectVersions[SELECT_CACHE];
+	RingBuffer<Change> _changes;	// the last changes, see GetChangesSince
+	long long _changesFloor;	// the newest version dropped from _changes
+	WriteAheadLog* _log;	// the log of the updates, or NULL, see StartLog
+	long long _lsn;			// the number of updates since the initialization
+	ReadWriteLock* _lock;	// NULL unless thread-safe, see MakeThreadSafe
+	EpochPointer<RankingView> _published;	// see PublishRanking
+	int _publishInterval;
+	long long _publishedRanking;	// _rankingVersion when last published
+	DynamicArray<Subscriber> _subscribers;	// see SubscribeCapitalChanges
+	/* The counters of the parts of the planet, see GetStats: the hash table
+	 * of the citizens, the rankings of the cities (by size, of the kingdoms
+	 * by population and within every kingdom) and the union-find of the
+	 * kingdoms.
+	 */
+	ContainerStats _citizensStats;
+	ContainerStats _rankingsStats;
+	ContainerStats _kingdomsStats;
+
+	// helping functions to convert between IDs and internal indices. O(1)
+	int internal(int city) const;
+	int external(int index) const;
+	// helping function to return the City at the internal @index. _cities is
+	// a lazy array, where a city that was never used is a City of zero
+	// bytes (with the right size and population), which is made from its ID
+	// here. O(1)
+	City& cityAt(int index);
+	// helping function to renumber the cities, see CompactCities. O(n)
+	void compact();
+	// helping function to double the capacity of the arrays of the cities.
+	// O(n)
+	void grow();
+	// helping function to return the cities ranked by size, see _bySize.
+	// O(n) if the ranking changed since it was last called, O(1) otherwise.
+	const int* citiesBySize();
+	// helping function to add @delta citizens to @city, which updates the
+	// cities' ranking (unless @ranked is false) and the capital and
+	// population of the city's kingdom. Nothing is changed if it throws
+	// std::bad_alloc. O(log n) amortized, see RemoveCitizen.
+	void resizeCity(int city, int delta, bool ranked = true);
+	// helping function of RelocateCitizen to move a citizen from the size
+	// of @from to that of @to, as resizeCity(@from, -1) and then
+	// resizeCity(@to, 1). Nothing is changed if it throws std::bad_alloc.
+	// O(log n) amortized
+	void resizeCities(int from, int to);
+	// helping function of ImportCitizens to record the updates of the rows
+	// of @csv, by what every row did. Returns false if a record was not
+	// written. O(r)
+	bool recordRows(const CitizenCsv& csv, const char done[]);
+	// helping function of ImportCitizens and resizeCities to undo
+	// resizeCity(@city, @delta, false), before which @capital was the
+	// capital of the city's kingdom. It allocates nothing. O(log n)
+	void unresizeCity(int city, int delta, int capital);
+	// helping function to rebuild the cities' ranking from the sizes of the
+	// cities, which also makes _bySize valid, see ImportCitizens. O(n + s)
+	// whereas s is the largest size of a city.
+	void rankCities();
+	// helping functions to publish the ranking, always or if the interval
+	// passed (see SetPublishInterval). O(n)
+	void publish();
+	void publishIfDue();
+	// helping function to log a change of the size of @city, or of the
+	// capital of its kingdom if @kingdom is true. O(1)
+	void logChange(int city, bool kingdom);
+	// helping functions to add @citizen to the resident list of @city and
+	// to remove it, where the last resident takes its slot. O(1) amortized,
+	// and O(1) in average to remove.
+	void addResident(int city, Citizen& citizen);
+	void removeResident(int city, const Citizen& citizen);
+	// helping function to free the resident lists of all the cities. O(n)
+	void deleteResidents();
+	// helping function to call the subscribers on the change of the capital
+	// of the kingdom of @city. O(s)
+	void notifyCapital(int city, int oldCapital, int newCapital);
+	// helping function to count an update and add its record to the log.
+	// Returns false if the record cannot be added. O(1) amortized, plus the
+	// time of the disk when the group is flushed.
+	bool recordUpdate(WriteAheadLog::RecordType type, long long first,
+			int second);
+	// helping function to apply the update of @record, see ReplayLog.
+	// O(log n) in average.
+	StatusType applyRecord(const WriteAheadLog::Record& record);
+	// helping functions of MoveToCityBatch and GetCapitalBatch, for citizen
+	// IDs given as ints or as long longs.
+	template<class ID>
+	StatusType moveToCityBatch(const ID citizenIDs[], const int cities[],
+			int count, StatusType statuses[]);
+	template<class ID>
+	StatusType getCapitalBatch(const ID citizenIDs[], int count,
+			int capitals[], StatusType statuses[]);
+	// helping function of moveToCityBatch to record the moves whose status
+	// is SUCCESS. Returns false if a record was not written.
+	template<class ID>
+	bool recordMoves(const ID citizenIDs[], const int cities[], int count,
+			const StatusType statuses[]);
+	// helping function to return the ranking of the kingdom of @root, which
+	// is built if needed. O(k log k) if built, O(1) otherwise.
+	Tree<KingdomCity>& ranking(int root);
+	// helping function to merge the rankings of two joined kingdoms into the
+	// ranking of @root. A failed allocation drops the rankings, which are
+	// rebuilt when needed, so it throws nothing. O(k log n) whereas k is the
+	// smaller kingdom's size.
+	void mergeRankings(int root, int other, int rootSize, int otherSize);
+	// helping function to call @function on every City of the kingdom of
+	// @root. O(k) whereas k is the number of cities in the kingdom.
+	template<class Function>
+	void forEachKingdomCity(int root, Function& function);
 
 };
 
@@ -128,9 +911,15 @@ private:
  * @_size represents the number of citizens in the city.
  * @_capital represents the capital of the kingdom to which the city belongs
  * 		this field is only valid if the city is the root in the UnionFind.
- * The implementation of operators < > == != allow the use of this class
- * in our AVL tree in such a way that the nodes will be sorted according
- * to the number of the citizens primarily and the ID secondary.
+ * @_population represents the number of citizens in the kingdom to which the
+ * 		city belongs, this field is only valid if the city is the root in the
+ * 		UnionFind.
+ * @_first and @_last represent the lowest and the highest internal indices
+ * 		of the cities in the kingdom, these fields are only valid if the city
+ * 		is the root in the UnionFind.
+ * The implementation of operators < > == != order the cities according to
+ * the number of the citizens primarily and the ID secondary, as the cities
+ * are ranked by CityRanking.
  */
 class Planet::City {
 public:
@@ -138,13 +927,18 @@ public:
 	City(int id, int size=0);
 	friend bool operator<(const City& city1, const City& city2);
 	friend bool operator==(const City& city1, const City& city2);
-	friend class TreeToArray;
+	friend class CitiesToArray;
+	friend class InsertToRanking;
+	friend class ChangesToArray;
 	friend class Planet;
 private:
 	int _id;
 	int _size;
 	//City* _capital;
 	int _capital;
+	int _population;
+	int _first;
+	int _last;
 };
 
 bool operator!=(const typename Planet::City& city1, const typename Planet::City& city2);
@@ -152,26 +946,138 @@ bool operator<(const Planet::City& city1, const Planet::City& city2);
 
 /* Class Citizen:
  * This class represents a Citizen in the Planet.
- * @_id is the ID of the citizen.
+ * @_id is the ID of the citizen, which may use all 64 bits. It makes the
+ * citizen 16 bytes rather than 8; the memory is saved in the Hash Table
+ * instead, whose slots hold their trees by value, where an empty Tree keeps
+ * its node pool behind a single pointer.
  * @_city is the city to which the citizen belongs (or -1 if he's not in a city)
+ * @_slot is the place of the citizen in the resident list of its city, which
+ * 		fills the padding after @_city.
  * The implementation of operators < > == != allow the use of this class
  * in our Hash Table in such a way that the nodes will be sorted according
  * to the ID.
  */
 class Planet::Citizen {
 public:
-	Citizen(int id);
+	Citizen(long long id);
 	int  inCity() const;
 	void joinCity(int city);
 	int operator%(int i) const;
 	friend bool operator<(const Citizen& citizen1, const Citizen& citizen2);
 	friend bool operator==(const Citizen& citizen1, const Citizen& citizen2);
+	friend class CitizensToSnapshot;
+	friend class Planet;
 private:
-	int _id;
+	long long _id;
 	int _city;
+	int _slot;
 };
 
 bool operator>(const Planet::Citizen& citizen1, const Planet::Citizen& citizen2);
 bool operator!=(const Planet::Citizen& citizen1, const Planet::Citizen& citizen2);
 
+/* Class JoinRecord:
+ * This class records a JoinKingdoms made during a transaction.
+ * @_kingdom is the root of the joined kingdom.
+ * @_other is the root of the kingdom that was joined into it.
+ * @_root is the root City of @_kingdom as it was before the join.
+ * @_rootRanking and @_otherRanking are the rankings of the two kingdoms
+ * 		before the join.
+ * @_joinedCapital is the capital of the kingdom after the join.
+ * @_city1 and @_city2 are the capitals that were joined, which are logged
+ * 		once the transaction is committed.
+ */
+class Planet::JoinRecord {
+public:
+	JoinRecord();
+	JoinRecord(int kingdom, int other, const City& root);
+	friend class Planet;
+private:
+	int _kingdom;
+	int _other;
+	City _root;
+	int _joinedCapital;
+	int _city1;
+	int _city2;
+	Tree<KingdomCity>* _rootRanking;
+	Tree<KingdomCity>* _otherRanking;
+};
+
+/* Class KingdomCity:
+ * This class represents a City in the ranking of its kingdom.
+ * @_id is the ID of the city.
+ * @_size is the number of citizens in the city.
+ * The implementation of operators < > == != allow the use of this class
+ * in our AVL tree in such a way that the nodes will be sorted according
+ * to the number of citizens primarily and the ID secondary in reverse order,
+ * so that the maximum of the tree is the capital of the kingdom.
+ */
+class Planet::KingdomCity {
+public:
+	KingdomCity();
+	KingdomCity(int id, int size);
+	friend bool operator<(const KingdomCity& city1, const KingdomCity& city2);
+	friend bool operator==(const KingdomCity& city1,
+			const KingdomCity& city2);
+	friend class KingdomCitiesToArray;
+	friend class Planet;
+private:
+	int _id;
+	int _size;
+};
+
+bool operator>(const Planet::KingdomCity& city1,
+		const Planet::KingdomCity& city2);
+bool operator!=(const Planet::KingdomCity& city1,
+		const Planet::KingdomCity& city2);
+
+/* Class Change:
+ * This class represents an entry in the log of changes of the Planet.
+ * @_version is the version of the Planet after the change.
+ * @_city is the ID of the city whose size changed, or a city of the kingdom
+ * 		whose capital changed if @_kingdom is true.
+ */
+class Planet::Change {
+public:
+	Change();
+	Change(long long version, int city, bool kingdom);
+	friend class Planet;
+private:
+	long long _version;
+	int _city;
+	bool _kingdom;
+};
+
+/* Class Subscriber:
+ * This class represents a subscription to the changes of the capitals.
+ * @_callback is the function to call, or NULL if the subscription was
+ * 		cancelled (and its slot may be reused).
+ * @_context is passed to @_callback.
+ */
+class Planet::Subscriber {
+public:
+	Subscriber();
+	Subscriber(CapitalCallback callback, void* context);
+	friend class Planet;
+private:
+	CapitalCallback _callback;
+	void* _context;
+};
+
+/* Class Residents:
+ * This class stores the citizens living in a city, as one contiguous array
+ * of their IDs which is doubled when full and halved when a quarter full, so
+ * it takes at most four times the memory of the IDs.
+ * A Residents of zero bytes is an empty list (see lazyArray.h).
+ * @_ids is the array, or NULL if it was not allocated.
+ * @_size is the number of citizens in the list.
+ * @_capacity is the size of @_ids.
+ */
+class Planet::Residents {
+	friend class Planet;
+	long long* _ids;
+	int _size;
+	int _capacity;
+};
+
 #endif /* PLANET_H_ */
@@ -0,0 +1,16 @@
+#ifndef PREFETCH_H_
+#define PREFETCH_H_
+
+/*
+ * PREFETCH(address) hints the processor to start loading the cache line of
+ * @address, so that a later access to it does not stall on a cache miss.
+ * It has no effect on the program's behavior, and compiles to nothing on
+ * compilers that do not support it.
+ */
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void) (address))
+#endif
+
+#endif /* PREFETCH_H_ */
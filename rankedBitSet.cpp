@@ -0,0 +1,171 @@
+#include "rankedBitSet.h"
+#include <new> // std::bad_alloc
+
+RankedBitSet::RankedBitSet(int n, bool full) :
+		_range(n), _size(full ? n : 0), _words(NULL), _counts(words(n),
+				full ? BITS : 0) {
+	// allocated after the counts, which are freed if this throws
+	_words = new Word[words(n) > 0 ? words(n) : 1];
+	for (int w = 0; w < words(n); ++w) {
+		_words[w] = full ? ~Word(0) : 0;
+	}
+	if (full && n % BITS != 0) { // the bits after n - 1 are not members
+		_words[n / BITS] = (Word(1) << (n % BITS)) - 1;
+		_counts.add(n / BITS, n % BITS - BITS);
+	}
+}
+
+RankedBitSet::~RankedBitSet() {
+	delete[] _words;
+}
+
+int RankedBitSet::count(Word word) {
+#if defined(__GNUC__)
+	return __builtin_popcountll(word);
+#else
+	int bits = 0;
+	for (; word; word &= word - 1) {
+		++bits;
+	}
+	return bits;
+#endif
+}
+
+int RankedBitSet::lowest(Word word) {
+#if defined(__GNUC__)
+	return __builtin_ctzll(word);
+#else
+	int bit = 0;
+	for (; !(word & 1); word >>= 1) {
+		++bit;
+	}
+	return bit;
+#endif
+}
+
+int RankedBitSet::highest(Word word) {
+#if defined(__GNUC__)
+	return BITS - 1 - __builtin_clzll(word);
+#else
+	int bit = 0;
+	for (; word >>= 1;) {
+		++bit;
+	}
+	return bit;
+#endif
+}
+
+void RankedBitSet::insert(int i) {
+	if (i < 0 || i >= _range) {
+		throw IndexOutOfBounds();
+	}
+	Word bit = Word(1) << (i % BITS);
+	if (!(_words[i / BITS] & bit)) {
+		_words[i / BITS] |= bit;
+		_counts.add(i / BITS, 1);
+		++_size;
+	}
+}
+
+void RankedBitSet::remove(int i) {
+	if (i < 0 || i >= _range) {
+		throw IndexOutOfBounds();
+	}
+	Word bit = Word(1) << (i % BITS);
+	if (_words[i / BITS] & bit) {
+		_words[i / BITS] &= ~bit;
+		_counts.add(i / BITS, -1);
+		--_size;
+	}
+}
+
+bool RankedBitSet::contains(int i) const {
+	return i >= 0 && i < _range && (_words[i / BITS] >> (i % BITS) & 1);
+}
+
+int RankedBitSet::select(int k) const {
+	if (k < 0 || k >= _size) {
+		return -1;
+	}
+	int w = _counts.find(k);
+	k -= _counts.prefix(w - 1);
+	Word word = _words[w];
+	for (; k > 0; --k) {
+		word &= word - 1; // clears the lowest member
+	}
+	return w * BITS + lowest(word);
+}
+
+int RankedBitSet::next(int i) const {
+	if (i < 0) {
+		i = 0;
+	}
+	if (i >= _range) {
+		return -1;
+	}
+	int w = i / BITS;
+	Word word = _words[w] & (~Word(0) << (i % BITS));
+	while (!word) {
+		if (++w == words(_range)) {
+			return -1;
+		}
+		word = _words[w];
+	}
+	return w * BITS + lowest(word);
+}
+
+int RankedBitSet::previous(int i) const {
+	if (i >= _range) {
+		i = _range - 1;
+	}
+	if (i < 0) {
+		return -1;
+	}
+	int w = i / BITS;
+	Word word = _words[w] & (~Word(0) >> (BITS - 1 - i % BITS));
+	while (!word) {
+		if (--w < 0) {
+			return -1;
+		}
+		word = _words[w];
+	}
+	return w * BITS + highest(word);
+}
+
+void RankedBitSet::resize(int n) {
+	Word* newWords = new Word[words(n) > 0 ? words(n) : 1];
+	try {
+		_counts.resize(words(n));
+	} catch (std::bad_alloc& e) {
+		delete[] newWords;
+		throw;
+	}
+	for (int w = 0; w < words(n); ++w) {
+		newWords[w] = w < words(_range) ? _words[w] : 0;
+	}
+	if (n < _range && n % BITS) { // drops the members beyond the new range
+		int w = n / BITS;
+		int before = count(newWords[w]);
+		newWords[w] &= ~(~Word(0) << (n % BITS));
+		_counts.add(w, count(newWords[w]) - before);
+	}
+	delete[] _words;
+	_words = newWords;
+	if (n < _range) {
+		_size = _counts.prefix(words(n) - 1);
+	}
+	_range = n;
+}
+
+int RankedBitSet::size() const {
+	return _size;
+}
+
+int RankedBitSet::range() const {
+	return _range;
+}
+
+size_t RankedBitSet::memory() const {
+	return (words(_range) > 0 ? words(_range) : 1) * sizeof(Word)
+			+ _counts.memory();
+}
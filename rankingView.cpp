@@ -0,0 +1,82 @@
+#include "rankingView.h"
+#include <stdlib.h>	// NULL
+#include <new>		// std::bad_alloc
+#include "prefetch.h"
+
+RankingView::RankingView(long long version, int n, const int bySize[],
+		const int sizes[]) :
+		_version(version), _n(n), _cities(NULL), _sizes(NULL), _keys(NULL), _ranks(
+				NULL) {
+	try {
+		_cities = new int[n > 0 ? n : 1];
+		_sizes = new int[n > 0 ? n : 1];
+		_keys = new long long[n + 1];
+		_ranks = new int[n + 1];
+	} catch (std::bad_alloc& e) {
+		delete[] _keys;
+		delete[] _sizes;
+		delete[] _cities;
+		throw;
+	}
+	for (int i = 0; i < n; ++i) {
+		_cities[i] = bySize[i];
+		_sizes[i] = sizes[i];
+	}
+	fill(1, 0);
+}
+
+RankingView::~RankingView() {
+	delete[] _ranks;
+	delete[] _keys;
+	delete[] _sizes;
+	delete[] _cities;
+}
+
+long long RankingView::key(int size, int city) {
+	return ((long long) size << 32) | (unsigned int) city;
+}
+
+int RankingView::fill(int k, int rank) {
+	if (k > _n) {
+		return rank;
+	}
+	rank = fill(2 * k, rank);
+	_keys[k] = key(_sizes[_cities[rank]], _cities[rank]);
+	_ranks[k] = rank;
+	return fill(2 * k + 1, rank + 1);
+}
+
+int RankingView::lowerBound(long long key) const {
+	long long k = 1;
+	while (k <= _n) {
+		PREFETCH(_keys + 16 * k);
+		k = 2 * k + (_keys[k] < key);
+	}
+	// the last left turn was at the lower bound: drop the right turns after
+	// it, and the left turn itself
+	while (k & 1) {
+		k >>= 1;
+	}
+	k >>= 1;
+	return k == 0 ? _n : _ranks[k];
+}
+
+long long RankingView::version() const {
+	return _version;
+}
+
+int RankingView::size() const {
+	return _n;
+}
+
+const int* RankingView::cities() const {
+	return _cities;
+}
+
+int RankingView::rank(int city) const {
+	return lowerBound(key(_sizes[city], city));
+}
+
+int RankingView::countBelow(int size) const {
+	return lowerBound(key(size, 0));
+}
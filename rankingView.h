@@ -0,0 +1,69 @@
+#ifndef RANKINGVIEW_H_
+#define RANKINGVIEW_H_
+
+/*
+ * Class Ranking View
+ * An immutable copy of the ranking of the cities by size (see
+ * GetCitiesBySize) as it was in some version of the Planet, built for
+ * reading: the cities are kept in a flat array ranked by size, and the keys
+ * (size, ID) of the ranked cities are kept in an implicit search tree in
+ * Eytzinger (BFS) layout, where the sons of the key in index k are in
+ * indices 2k and 2k+1. A search thus reads the keys of the same levels
+ * from the same few cache lines, and the keys of four levels below are
+ * prefetched while it descends.
+ */
+class RankingView {
+public:
+	/* Constructor : copies the ranking of @n cities.
+	 * @bySize - The cities ranked by size, as GetCitiesBySize returns them.
+	 * @sizes - The size of every city, by its ID.
+	 * Time complexity : O(n)
+	 */
+	RankingView(long long version, int n, const int bySize[],
+			const int sizes[]);
+	/* Destructor : deletes the arrays of the view
+	 * Time complexity : O(1)
+	 */
+	~RankingView();
+	/* Returns the version of the Planet which the view copies.
+	 * Time complexity : O(1)
+	 */
+	long long version() const;
+	/* Returns the number of cities.
+	 * Time complexity : O(1)
+	 */
+	int size() const;
+	/* Returns the cities ranked by size.
+	 * Time complexity : O(1)
+	 */
+	const int* cities() const;
+	/* Returns the rank of @city, as SelectCity ranks it.
+	 * Time complexity : O(log n)
+	 */
+	int rank(int city) const;
+	/* Returns the number of cities of less than @size citizens.
+	 * Time complexity : O(log n)
+	 */
+	int countBelow(int size) const;
+
+private:
+	long long _version;
+	int _n;
+	int* _cities;
+	int* _sizes;		// by ID
+	long long* _keys;	// the search tree, from index 1
+	int* _ranks;		// the rank of the key in every index of _keys
+
+	RankingView(const RankingView& view);
+	RankingView& operator=(const RankingView& view);
+	// helping function to return the key of @city. O(1)
+	static long long key(int size, int city);
+	// helping function to fill the subtree of index @k with the keys from
+	// @rank on, in order. Returns the rank after the subtree's keys. O(n)
+	int fill(int k, int rank);
+	// helping function to return the rank of the first key not less than
+	// @key, or n if there is none. O(log n)
+	int lowerBound(long long key) const;
+};
+
+#endif /* RANKINGVIEW_H_ */
@@ -0,0 +1,56 @@
+#include "readWriteLock.h"
+#include <thread>	// std::this_thread::yield
+
+// the slot of every thread, given to the threads in turn
+static std::atomic<int> nextSlot(0);
+static thread_local int threadSlot = -1;
+
+ReadWriteLock::ReadWriteLock() :
+		_writer(false) {
+	for (int i = 0; i < SLOTS; i++) {
+		_slots[i]._readers.store(0, std::memory_order_relaxed);
+	}
+}
+
+ReadWriteLock::Slot& ReadWriteLock::slot() {
+	if (threadSlot == -1) {
+		threadSlot = nextSlot.fetch_add(1, std::memory_order_relaxed) % SLOTS;
+	}
+	return _slots[threadSlot];
+}
+
+void ReadWriteLock::lockShared() {
+	Slot& mine = slot();
+	while (true) {
+		// counting in before checking for a writer pairs with the writer
+		// announcing itself before checking for readers (both seq_cst), so
+		// at least one of them sees the other
+		mine._readers.fetch_add(1);
+		if (!_writer.load()) {
+			return;
+		}
+		mine._readers.fetch_sub(1);
+		while (_writer.load(std::memory_order_relaxed)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void ReadWriteLock::unlockShared() {
+	slot()._readers.fetch_sub(1, std::memory_order_release);
+}
+
+void ReadWriteLock::lock() {
+	_writers.lock();
+	_writer.store(true);
+	for (int i = 0; i < SLOTS; i++) {
+		while (_slots[i]._readers.load() != 0) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void ReadWriteLock::unlock() {
+	_writer.store(false, std::memory_order_release);
+	_writers.unlock();
+}
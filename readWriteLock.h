@@ -0,0 +1,113 @@
+#ifndef READWRITELOCK_H_
+#define READWRITELOCK_H_
+
+#include <stdlib.h>		// NULL
+#include <atomic>		// std::atomic
+#include <mutex>		// std::mutex
+
+/*
+ * Class Read Write Lock
+ * A lock held either by any number of readers (lockShared) or by a single
+ * writer (lock). A writer announces itself before waiting for the readers
+ * to leave, and new readers wait for it, so a stream of readers does not
+ * starve the writers.
+ * Every reader counts itself in one of SLOTS counters, chosen by its thread,
+ * so that readers on different cores rarely write the same cache line; a
+ * writer waits until all the counters are zero.
+ */
+class ReadWriteLock {
+public:
+	class Shared;
+	class Exclusive;
+
+	/* Constructor : initializes an unlocked lock.
+	 * Time complexity : O(1)
+	 */
+	ReadWriteLock();
+	/* Takes the lock as a reader, waiting for the writer if there is one.
+	 * Time complexity : O(1) without a writer.
+	 */
+	void lockShared();
+	/* Releases the lock taken by lockShared in the same thread.
+	 * Time complexity : O(1)
+	 */
+	void unlockShared();
+	/* Takes the lock as the writer, waiting for the other writers and for
+	 * the readers to leave.
+	 * Time complexity : O(1) plus the time of the readers.
+	 */
+	void lock();
+	/* Releases the lock taken by lock.
+	 * Time complexity : O(1)
+	 */
+	void unlock();
+
+private:
+	static const int SLOTS = 16;
+	/* A counter of readers, padded to a cache line of its own. */
+	struct Slot {
+		std::atomic<int> _readers;
+		char _padding[64 - sizeof(std::atomic<int>)];
+	};
+
+	Slot _slots[SLOTS];
+	std::atomic<bool> _writer;	// a writer holds the lock or waits for it
+	std::mutex _writers;		// held by the writer
+
+	ReadWriteLock(const ReadWriteLock& lock);
+	ReadWriteLock& operator=(const ReadWriteLock& lock);
+	// helping function to return the counter of the calling thread. O(1)
+	Slot& slot();
+};
+
+/*
+ * Class Shared
+ * Holds the lock as a reader for its lifetime, or nothing if the lock is
+ * NULL.
+ */
+class ReadWriteLock::Shared {
+public:
+	explicit Shared(ReadWriteLock* lock) :
+			_lock(lock) {
+		if (_lock) {
+			_lock->lockShared();
+		}
+	}
+	~Shared() {
+		if (_lock) {
+			_lock->unlockShared();
+		}
+	}
+private:
+	ReadWriteLock* _lock;
+
+	Shared(const Shared& shared);
+	Shared& operator=(const Shared& shared);
+};
+
+/*
+ * Class Exclusive
+ * Holds the lock as the writer for its lifetime, or nothing if the lock is
+ * NULL.
+ */
+class ReadWriteLock::Exclusive {
+public:
+	explicit Exclusive(ReadWriteLock* lock) :
+			_lock(lock) {
+		if (_lock) {
+			_lock->lock();
+		}
+	}
+	~Exclusive() {
+		if (_lock) {
+			_lock->unlock();
+		}
+	}
+private:
+	ReadWriteLock* _lock;
+
+	Exclusive(const Exclusive& exclusive);
+	Exclusive& operator=(const Exclusive& exclusive);
+};
+
+#endif /* READWRITELOCK_H_ */
@@ -0,0 +1,111 @@
+#ifndef RINGBUFFER_H_
+#define RINGBUFFER_H_
+
+#include <stdlib.h>		// NULL
+#include <exception>	// std::exception
+
+/*
+ * Class Ring Buffer
+ * A queue of at most @capacity elements stored in a fixed array. Adding an
+ * element to a full buffer overwrites the oldest element, so the buffer
+ * keeps the last @capacity elements that were added to it.
+ */
+template<class T>
+class RingBuffer {
+public:
+
+	/* Exceptions thrown by the buffer */
+	class BufferIsEmpty: public std::exception {
+	};
+	class IndexOutOfBounds: public std::exception {
+	};
+
+	/* Constructor : initializes an empty buffer of @capacity elements.
+	 * Time complexity : O(capacity)
+	 */
+	explicit RingBuffer(int capacity);
+	/* Destructor : deletes the data of the buffer
+	 * Time complexity : O(capacity)
+	 */
+	~RingBuffer();
+	/* Adds @data as the newest element, overwriting the oldest element if
+	 * the buffer is full.
+	 * Time complexity : O(1)
+	 */
+	void pushBack(const T& data);
+	/* Returns the oldest element of the buffer.
+	 * @throw BufferIsEmpty
+	 * Time complexity : O(1)
+	 */
+	const T& front() const;
+	/* Returns the element in index @i, where 0 is the oldest element.
+	 * @throw IndexOutOfBounds
+	 * Time complexity : O(1)
+	 */
+	const T& operator[](int i) const;
+	/* Returns the number of elements in the buffer.
+	 * Time complexity : O(1)
+	 */
+	int size() const;
+	/* Returns true if the next pushBack will overwrite an element.
+	 * Time complexity : O(1)
+	 */
+	bool full() const;
+
+private:
+	T* _data;
+	int _capacity, _first, _size;
+
+	RingBuffer(const RingBuffer& buffer);
+	RingBuffer& operator=(const RingBuffer& buffer);
+};
+
+template<class T>
+RingBuffer<T>::RingBuffer(int capacity) :
+		_data(new T[capacity > 0 ? capacity : 1]), _capacity(
+				capacity > 0 ? capacity : 1), _first(0), _size(0) {
+}
+
+template<class T>
+RingBuffer<T>::~RingBuffer() {
+	delete[] _data;
+}
+
+template<class T>
+void RingBuffer<T>::pushBack(const T& data) {
+	if (_size == _capacity) {
+		_data[_first] = data;
+		_first = (_first + 1) % _capacity;
+	} else {
+		_data[(_first + _size) % _capacity] = data;
+		++_size;
+	}
+}
+
+template<class T>
+const T& RingBuffer<T>::front() const {
+	if (_size == 0) {
+		throw BufferIsEmpty();
+	}
+	return _data[_first];
+}
+
+template<class T>
+const T& RingBuffer<T>::operator[](int i) const {
+	if (i < 0 || i >= _size) {
+		throw IndexOutOfBounds();
+	}
+	return _data[(_first + i) % _capacity];
+}
+
+template<class T>
+inline int RingBuffer<T>::size() const {
+	return _size;
+}
+
+template<class T>
+inline bool RingBuffer<T>::full() const {
+	return _size == _capacity;
+}
+
+#endif /* RINGBUFFER_H_ */
@@ -0,0 +1,388 @@
+#include "snapshot.h"
+#include <new>		// std::bad_alloc
+#include <cstring>	// memcmp, memcpy, strlen
+#ifdef _WIN32
+#include <io.h>		// _commit
+#else
+#include <fcntl.h>		// open
+#include <unistd.h>		// close, fsync
+#include <sys/mman.h>	// mmap
+#include <sys/stat.h>	// fstat
+#endif
+
+const char Snapshot::MAGIC[8] = { 'W', 'E', 'T', '2', 'S', 'N', 'A', 'P' };
+
+Snapshot::Snapshot(const char* path) :
+		_data(NULL), _length(0), _header(NULL) {
+#ifdef _WIN32
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		throw IOError();
+	}
+	long length = -1;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		length = ftell(file);
+	}
+	if (length <= 0 || fseek(file, 0, SEEK_SET) != 0) {
+		fclose(file);
+		if (length == 0) {
+			throw BadSnapshot();
+		}
+		throw IOError();
+	}
+	char* data = NULL;
+	try {
+		data = new char[length];
+	} catch (std::bad_alloc& e) {
+		fclose(file);
+		throw;
+	}
+	if (fread(data, 1, length, file) != (size_t) length) {
+		delete[] data;
+		fclose(file);
+		throw IOError();
+	}
+	fclose(file);
+	_data = data;
+	_length = length;
+#else
+	int file = open(path, O_RDONLY);
+	if (file == -1) {
+		throw IOError();
+	}
+	struct stat status;
+	if (fstat(file, &status) == -1) {
+		close(file);
+		throw IOError();
+	}
+	if (status.st_size == 0) { // which cannot be mapped
+		close(file);
+		throw BadSnapshot();
+	}
+	void* data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED) {
+		throw IOError();
+	}
+#ifdef MADV_SEQUENTIAL
+	madvise(data, status.st_size, MADV_SEQUENTIAL);
+#endif
+	_data = (const char*) data;
+	_length = status.st_size;
+#endif
+	try {
+		_header = (const Header*) _data;
+		if (_length < sizeof(Header)
+				|| memcmp(_header->_magic, MAGIC, sizeof(MAGIC)) != 0
+				|| _header->_format != FORMAT
+				|| _header->_intSize != (int) sizeof(int)
+				|| _header->_byteOrder != INT_ORDER
+				|| _header->_ranking < 0 || _header->_ranking > 1
+				|| _header->_cities < 0 || _header->_kingdoms < 0
+				|| _header->_kingdoms > _header->_cities
+				|| (_header->_cities > 0 && _header->_kingdoms < 1)
+				|| _header->_citizens < 0 || _header->_lsn < 0) {
+			throw BadSnapshot();
+		}
+		const int* section = (const int*) (_data + sizeof(Header));
+		long long length = 0;
+		for (int s = 0; s < SECTIONS; ++s) {
+			_sections[s] = section;
+			long long sectionInts = sectionLength(Section(s), cities(),
+					kingdoms(), citizens());
+			section += sectionInts;
+			length += sectionInts;
+		}
+		if ((long long) (_length - sizeof(Header))
+				!= length * (long long) sizeof(int)) {
+			throw BadSnapshot();
+		}
+		check();
+	} catch (...) {
+#ifdef _WIN32
+		delete[] _data;
+#else
+		munmap((void*) _data, _length);
+#endif
+		throw;
+	}
+}
+
+Snapshot::~Snapshot() {
+#ifdef _WIN32
+	delete[] _data;
+#else
+	munmap((void*) _data, _length);
+#endif
+}
+
+int Snapshot::cities() const {
+	return _header->_cities;
+}
+
+int Snapshot::kingdoms() const {
+	return _header->_kingdoms;
+}
+
+int Snapshot::citizens() const {
+	return _header->_citizens;
+}
+
+int Snapshot::ranking() const {
+	return _header->_ranking;
+}
+
+long long Snapshot::lsn() const {
+	return _header->_lsn;
+}
+
+const int* Snapshot::section(Section section) const {
+	return _sections[section];
+}
+
+long long Snapshot::citizenID(const int* citizen) {
+	return (long long) ((unsigned long long) (unsigned int) citizen[1] << 32
+			| (unsigned int) citizen[0]);
+}
+
+long long Snapshot::sectionLength(Section section, int cities, int kingdoms,
+		int citizens) {
+	if (section == BY_POPULATION) {
+		return kingdoms;
+	}
+	if (section == CITIZENS) {
+		return 3 * (long long) citizens;
+	}
+	return cities;
+}
+
+/* Returns true if the sections are the sections of a Planet, using the
+ * arrays @marks and @counts of n ints.
+ */
+static bool isValid(int n, int k, int m, const int* const sections[],
+		int* marks, int* counts) {
+	const int* sizes = sections[Snapshot::SIZES];
+	const int* kingdoms = sections[Snapshot::KINGDOMS];
+	const int* next = sections[Snapshot::NEXT];
+	const int* capitals = sections[Snapshot::CAPITALS];
+	const int* bySize = sections[Snapshot::BY_SIZE];
+	const int* byPopulation = sections[Snapshot::BY_POPULATION];
+	const int* citizens = sections[Snapshot::CITIZENS];
+	// the sizes are the numbers of citizens in the cities
+	for (int i = 0; i < n; ++i) {
+		counts[i] = 0;
+	}
+	for (int j = 0; j < m; ++j) {
+		long long id = Snapshot::citizenID(citizens + 3 * j);
+		int city = citizens[3 * j + 2];
+		if (id < 0 || city < -1 || city >= n) {
+			return false;
+		}
+		if (city != -1) {
+			++counts[city];
+		}
+	}
+	for (int i = 0; i < n; ++i) {
+		if (sizes[i] != counts[i]) {
+			return false;
+		}
+	}
+	// every kingdom is a root and a circular list of its cities
+	int roots = 0;
+	for (int i = 0; i < n; ++i) {
+		int root = kingdoms[i];
+		if (root < 0 || root >= n || kingdoms[root] != root) {
+			return false;
+		}
+		roots += root == i;
+		marks[i] = counts[i] = 0;
+	}
+	if (roots != k) {
+		return false;
+	}
+	for (int i = 0; i < n; ++i) {
+		++counts[kingdoms[i]];
+		int following = next[i];
+		if (following < 0 || following >= n
+				|| kingdoms[following] != kingdoms[i] || marks[following]++) {
+			return false;
+		}
+	}
+	for (int i = 0; i < n; ++i) { // next is a permutation, so it is cycles
+		if (kingdoms[i] == i) {
+			int length = 0, current = i;
+			do {
+				++length;
+				current = next[current];
+			} while (current != i);
+			if (length != counts[i]) {
+				return false;
+			}
+		}
+	}
+	// the capitals are the largest cities of their kingdoms
+	for (int i = 0; i < n; ++i) {
+		int capital = capitals[i];
+		if (capital < 0 || capital >= n || kingdoms[capital] != kingdoms[i]
+				|| capitals[kingdoms[i]] != capital
+				|| sizes[i] > sizes[capital]
+				|| (sizes[i] == sizes[capital] && i < capital)) {
+			return false;
+		}
+	}
+	// the rankings
+	for (int i = 0; i < n; ++i) {
+		marks[i] = counts[i] = 0;
+	}
+	for (int i = 0; i < n; ++i) {
+		counts[kingdoms[i]] += sizes[i]; // at most m citizens in all
+		int city = bySize[i];
+		if (city < 0 || city >= n || marks[city]++) {
+			return false;
+		}
+		int previous = i > 0 ? bySize[i - 1] : -1;
+		if (previous != -1
+				&& (sizes[previous] > sizes[city]
+						|| (sizes[previous] == sizes[city] && previous > city))) {
+			return false;
+		}
+	}
+	for (int j = 0; j < k; ++j) {
+		int capital = byPopulation[j];
+		if (capital < 0 || capital >= n || capitals[capital] != capital
+				|| marks[capital]-- != 1) { // each capital once
+			return false;
+		}
+		int previous = j > 0 ? byPopulation[j - 1] : -1;
+		if (previous != -1) {
+			int population = counts[kingdoms[capital]];
+			int previousPopulation = counts[kingdoms[previous]];
+			if (previousPopulation > population
+					|| (previousPopulation == population && previous > capital)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void Snapshot::check() const {
+	int n = cities();
+	int* marks = new int[n];
+	int* counts = NULL;
+	try {
+		counts = new int[n];
+	} catch (std::bad_alloc& e) {
+		delete[] marks;
+		throw;
+	}
+	bool valid = isValid(n, kingdoms(), citizens(), _sections, marks, counts);
+	delete[] counts;
+	delete[] marks;
+	if (!valid) {
+		throw BadSnapshot();
+	}
+}
+
+Snapshot::Writer::Writer(const char* path, int ranking, int cities,
+		int kingdoms, int citizens, long long lsn) :
+		_path(NULL), _temporary(NULL), _file(NULL), _buffered(0), _remaining(
+				0) {
+	size_t length = strlen(path);
+	_path = new char[length + 1];
+	try {
+		_temporary = new char[length + 5];
+	} catch (std::bad_alloc& e) {
+		delete[] _path;
+		throw;
+	}
+	memcpy(_path, path, length + 1);
+	memcpy(_temporary, path, length);
+	memcpy(_temporary + length, ".tmp", 5);
+	for (int s = 0; s < SECTIONS; ++s) {
+		_remaining += sectionLength(Section(s), cities, kingdoms, citizens);
+	}
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header._magic, MAGIC, sizeof(MAGIC));
+	header._format = FORMAT;
+	header._intSize = sizeof(int);
+	header._byteOrder = INT_ORDER;
+	header._ranking = ranking;
+	header._cities = cities;
+	header._kingdoms = kingdoms;
+	header._citizens = citizens;
+	header._lsn = lsn;
+	_file = fopen(_temporary, "wb");
+	if (!_file || fwrite(&header, sizeof(header), 1, _file) != 1) {
+		if (_file) {
+			fclose(_file);
+			remove(_temporary);
+		}
+		delete[] _temporary;
+		delete[] _path;
+		throw IOError();
+	}
+}
+
+Snapshot::Writer::~Writer() {
+	if (_file) {
+		fclose(_file);
+		remove(_temporary);
+	}
+	delete[] _temporary;
+	delete[] _path;
+}
+
+void Snapshot::Writer::flush() {
+	if (_buffered > 0
+			&& fwrite(_buffer, sizeof(int), _buffered, _file)
+					!= (size_t) _buffered) {
+		throw IOError();
+	}
+	_buffered = 0;
+}
+
+void Snapshot::Writer::write(int value) {
+	if (_remaining == 0) {
+		throw BadSnapshot();
+	}
+	--_remaining;
+	_buffer[_buffered++] = value;
+	if (_buffered == BUFFER) {
+		flush();
+	}
+}
+
+void Snapshot::Writer::write(long long value) {
+	write((int) (unsigned int) value);
+	write((int) (unsigned int) ((unsigned long long) value >> 32));
+}
+
+void Snapshot::Writer::commit() {
+	if (_remaining != 0) {
+		throw BadSnapshot();
+	}
+	flush();
+	if (fflush(_file) != 0) {
+		throw IOError();
+	}
+#ifdef _WIN32
+	bool synced = _commit(_fileno(_file)) == 0;
+#else
+	bool synced = fsync(fileno(_file)) == 0;
+#endif
+	bool closed = fclose(_file) == 0;
+	_file = NULL;
+	if (!synced || !closed) {
+		remove(_temporary);
+		throw IOError();
+	}
+#ifdef _WIN32
+	remove(_path); // rename does not replace files on Windows
+#endif
+	if (rename(_temporary, _path) != 0) {
+		remove(_temporary);
+		throw IOError();
+	}
+}
@@ -0,0 +1,167 @@
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <stdio.h>		// FILE
+#include <stddef.h>		// size_t
+#include <exception>	// std::exception
+
+/*
+ * Class Snapshot
+ * A snapshot file of the Planet (see SaveSnapshot in library2.h), which is a
+ * header followed by sections of ints in the native byte order:
+ * SIZES[n]         - the number of citizens in every city.
+ * KINGDOMS[n]      - the root city of the kingdom of every city.
+ * NEXT[n]          - the next city in the circular list of every kingdom.
+ * CAPITALS[n]      - the capital of the kingdom of every city.
+ * BY_SIZE[n]       - the cities ranked by size, as GetCitiesBySize.
+ * BY_POPULATION[k] - the capitals of the k kingdoms ranked by population.
+ * CITIZENS[3m]     - the ID and the city (or -1) of every citizen, where the
+ *                    64-bit ID takes two ints, see citizenID.
+ * All the cities are given by their IDs. The header also holds the number
+ * of updates made to the Planet, see ReplayLog.
+ *
+ * Opening a snapshot maps the file into memory (or reads it where mmap is
+ * missing), and the sections are read in place, without being parsed. The
+ * contents are checked when the file is opened, so the Planet copies them
+ * into its own structures with no further checks, except for citizens
+ * that appear twice, which the Planet's hash table finds.
+ * A Snapshot::Writer writes a temporary file which replaces the snapshot
+ * only once it is complete and flushed to the disk, so a crash never leaves
+ * a partial snapshot behind.
+ */
+class Snapshot {
+public:
+	/* Exceptions thrown by the snapshot */
+	class IOError: public std::exception {
+	};
+	class BadSnapshot: public std::exception {
+	};
+
+	enum Section {
+		SIZES, KINGDOMS, NEXT, CAPITALS, BY_SIZE, BY_POPULATION, CITIZENS,
+		SECTIONS
+	};
+
+	class Writer;
+
+	/* Opens the snapshot at @path and checks it.
+	 * @throw IOError
+	 * @throw BadSnapshot
+	 * Time complexity : O(n + m), which reads the file once.
+	 */
+	explicit Snapshot(const char* path);
+	/* Destructor : unmaps the file
+	 * Time complexity : O(1)
+	 */
+	~Snapshot();
+	/* Returns the numbers of cities, kingdoms and citizens.
+	 * Time complexity : O(1)
+	 */
+	int cities() const;
+	int kingdoms() const;
+	int citizens() const;
+	/* Returns the ranking engine of the Planet (see RankingType).
+	 * Time complexity : O(1)
+	 */
+	int ranking() const;
+	/* Returns the number of updates made to the Planet since it was
+	 * initialized, which is the LSN of the last update (see WriteAheadLog).
+	 * Time complexity : O(1)
+	 */
+	long long lsn() const;
+	/* Returns the array of @section.
+	 * Time complexity : O(1)
+	 */
+	const int* section(Section section) const;
+	/* Returns the ID of the citizen whose entry in CITIZENS begins at
+	 * @citizen, that is its low and its high 32 bits.
+	 * Time complexity : O(1)
+	 */
+	static long long citizenID(const int* citizen);
+
+private:
+	/* The header of the file. @_intSize and @_byteOrder reject files written
+	 * on a machine with different ints.
+	 */
+	struct Header {
+		char _magic[8];
+		int _format;
+		int _intSize;
+		int _byteOrder;
+		int _ranking;
+		int _cities;
+		int _kingdoms;
+		int _citizens;
+		int _reserved;
+		long long _lsn;
+	};
+
+	static const char MAGIC[8];
+	static const int FORMAT = 3;
+	static const int INT_ORDER = 0x01020304;
+
+	const char* _data;
+	size_t _length;
+	const Header* _header;
+	const int* _sections[SECTIONS];
+
+	Snapshot(const Snapshot& snapshot);
+	Snapshot& operator=(const Snapshot& snapshot);
+	// helping function to return the number of ints in @section. O(1)
+	static long long sectionLength(Section section, int cities, int kingdoms,
+			int citizens);
+	// helping function to check the contents of the sections. O(n + m)
+	void check() const;
+};
+
+/*
+ * Class Snapshot Writer
+ * Writes a snapshot section by section, one int at a time, through a buffer.
+ */
+class Snapshot::Writer {
+public:
+	/* Creates the temporary file of the snapshot at @path and writes the
+	 * header.
+	 * @throw IOError
+	 * Time complexity : O(1)
+	 */
+	Writer(const char* path, int ranking, int cities, int kingdoms,
+			int citizens, long long lsn);
+	/* Destructor : removes the temporary file unless commit was called
+	 * Time complexity : O(1)
+	 */
+	~Writer();
+	/* Writes the next int of the snapshot.
+	 * @throw IOError
+	 * Time complexity : O(1) amortized
+	 */
+	void write(int value);
+	/* Writes a 64-bit value as two ints, the low 32 bits first.
+	 * @throw IOError
+	 * Time complexity : O(1) amortized
+	 */
+	void write(long long value);
+	/* Flushes the snapshot to the disk and moves it to @path.
+	 * @throw IOError
+	 * @throw BadSnapshot if the sections were not fully written.
+	 * Time complexity : O(1) plus the time of the disk.
+	 */
+	void commit();
+
+private:
+	static const int BUFFER = 1 << 14;
+
+	char* _path;
+	char* _temporary;
+	FILE* _file;
+	int _buffer[BUFFER];
+	int _buffered;
+	long long _remaining;	// ints left until the snapshot is complete
+
+	Writer(const Writer& writer);
+	Writer& operator=(const Writer& writer);
+	// helping function to write the buffer to the file. O(1)
+	void flush();
+};
+
+#endif /* SNAPSHOT_H_ */
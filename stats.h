@@ -0,0 +1,95 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <atomic>		// std::atomic
+
+/*
+ * The structural counters of the containers (see GetStats in library2.h),
+ * which are compiled in only when WET2_STATS is defined. STATS(statement)
+ * runs @statement then, and compiles to nothing otherwise, so without
+ * WET2_STATS the containers cost exactly what they did before.
+ */
+#ifdef WET2_STATS
+#define STATS(statement) statement
+#else
+#define STATS(statement)
+#endif
+
+/*
+ * Class Stats Counter
+ * A counter that is added to with a relaxed load and store rather than an
+ * atomic addition, so counting costs a plain increment. Threads that read
+ * the Planet concurrently (e.g. GetCapital) may thus lose a few counts when
+ * they count at once, which is fine for statistics.
+ */
+class StatsCounter {
+public:
+	StatsCounter() :
+			_value(0) {
+	}
+	/* Adds @n to the counter.
+	 * Time complexity : O(1)
+	 */
+	void add(long long n) {
+		_value.store(_value.load(std::memory_order_relaxed) + n,
+				std::memory_order_relaxed);
+	}
+	/* Raises the counter to @n if it is lower, for counters of maximums.
+	 * Time complexity : O(1)
+	 */
+	void raise(long long n) {
+		if (n > _value.load(std::memory_order_relaxed)) {
+			_value.store(n, std::memory_order_relaxed);
+		}
+	}
+	/* Returns the value of the counter.
+	 * Time complexity : O(1)
+	 */
+	long long value() const {
+		return _value.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<long long> _value;
+
+	StatsCounter(const StatsCounter& counter);
+	StatsCounter& operator=(const StatsCounter& counter);
+};
+
+/*
+ * Class Container Stats
+ * A block of counters shared by a group of containers, e.g. all the trees
+ * of a Planet's citizens, since the chains of a HashTable alone are millions
+ * of trees, each too small to carry counters of its own. Every Planet counts
+ * its parts in blocks of its own (see GetStats in library2.h), which the
+ * containers are given by setStats; the containers of no Planet count in
+ * the block of the process.
+ * The block is padded to cache lines of its own, so that the blocks of
+ * Planets updated by different threads are not written on the same line.
+ */
+class ContainerStats {
+	char _before[64];	// padding, see above
+public:
+	StatsCounter _treeRotations;
+	StatsCounter _treeFinds;
+	StatsCounter _treeFindDepth;		// the nodes visited by all the finds
+	StatsCounter _treeMaxFindDepth;
+	StatsCounter _hashReallocations;
+	StatsCounter _hashReallocationNanoseconds;
+	StatsCounter _unionFinds;
+	StatsCounter _unionFindPathLength;	// parents followed, before compression
+	StatsCounter _unionFindMaxPathLength;
+
+	/* Returns the counters of the containers of no Planet.
+	 * Time complexity : O(1)
+	 */
+	static ContainerStats& global() {
+		static ContainerStats stats;
+		return stats;
+	}
+
+private:
+	char _after[64];
+};
+
+#endif /* STATS_H_ */
@@ -3,7 +3,10 @@
 
 #include <stdlib.h>		// NULL and size_t
 #include <cassert>		// assert()
+#include <new>			// placement new
 #include <exception>	// std::exception
+#include "prefetch.h"
+#include "stats.h"
 
 /*
  * Class AVL Tree
@@ -27,7 +30,9 @@ public:
 	 */
 	Tree();
 	/*
-	 * Creates an empty almost-full AVL tree.
+	 * Creates an empty almost-full AVL tree. Its n nodes are allocated as a
+	 * single pool, and the nodes of the pool that are removed are kept on a
+	 * free list for the following inserts rather than deleted.
 	 * Time Complexity: O(n)
 	 */
 	explicit Tree(int n);
@@ -48,10 +53,34 @@ public:
 	 * Time complexity : O(log n)
 	 */
 	virtual void remove(const T& data);
+	/* removes @oldData from the tree and inserts @newData in its node, so
+	 * unlike remove and insert it allocates no memory
+	 * @throw TreeIsEmpty
+	 * @throw ElementNotFound
+	 * @throw ElementAlreadyExists, in which case the tree is not changed
+	 * Time complexity : O(log n)
+	 */
+	void replace(const T& oldData, const T& newData);
+	/* makes nodes for @n inserts, so that the next @n inserts allocate no
+	 * memory, e.g. to put back removed objects where nothing may fail
+	 * @throw std::bad_alloc, in which case the objects are not changed
+	 * Time complexity : O(n)
+	 */
+	void reserve(int n);
+	/* makes the tree count its work in @stats rather than in the counters
+	 * of the process (see stats.h). It does nothing without WET2_STATS.
+	 * Time complexity : O(1)
+	 */
+	void setStats(ContainerStats* stats);
 	/* returns the number of objects in the tree
 	 * Time complexity : O(1)
 	 */
 	size_t size() const;
+	/* returns the number of bytes allocated by the tree, not counting the
+	 * tree object itself
+	 * Time complexity : O(1)
+	 */
+	size_t memory() const;
 	/* A template method that calls the Function on all the objects of the tree
 	 * using pre-order traversal
 	 * Time complexity : O(n)
@@ -70,6 +99,21 @@ public:
 	 */
 	template<class Function>
 	void inOrder(Function& function) const;
+	/* A template method that calls the Function on the objects ranked
+	 * @first to @last in the tree (1-based, as in select), in-order.
+	 * Only the paths to the range and the range itself are visited.
+	 * Time complexity : O(log n + k) whereas k is the size of the range
+	 */
+	template<class Function>
+	void inOrder(unsigned int first, unsigned int last,
+			Function& function) const;
+	/* The same as the above, using reverse in-order traversal, that is the
+	 * object ranked @last is the first to be passed to the Function.
+	 * Time complexity : O(log n + k) whereas k is the size of the range
+	 */
+	template<class Function>
+	void reverseInOrder(unsigned int first, unsigned int last,
+			Function& function) const;
 	// An AVL Tree Node
 	class Node;
 	friend class Node;
@@ -89,6 +133,10 @@ public:
 	 * Time Complexity: O(log n)
 	 */
 	const T& select(unsigned int k) const;
+	/* Hints the processor to load the root of the tree into the cache.
+	 * Time Complexity: O(1)
+	 */
+	void prefetch() const;
 	/* deletes all the data stored in the tree.
 	 * Time complexity : O(n)
 	 */
@@ -98,6 +146,11 @@ private:
 
 	Node *_root; // stores a pointer to the root of the tree
 	size_t _size; // contains the number of objects in the tree
+	class Pool;
+	Pool *_pool; // the nodes allocated by Tree(int n) or reserve, or NULL
+#ifdef WET2_STATS
+	ContainerStats* _stats; // see setStats
+#endif
 
 	/* All non-recursive private functions are performed in time complexity of
 	 * O(1) unless stated otherwise.
@@ -115,6 +168,15 @@ private:
 	// and calls @Function on each object
 	template<class Function>
 	void subInOrder(Node* node, Function& function) const;
+	// recursive helping functions that traverse through the objects ranked
+	// @first to @last in the subtree of @node, where @offset is the number of
+	// objects in the tree that precede the subtree.
+	template<class Function>
+	void subRangeInOrder(Node* node, int offset, int first, int last,
+			Function& function) const;
+	template<class Function>
+	void subRangeReverseInOrder(Node* node, int offset, int first, int last,
+			Function& function) const;
 	/* A helping function that handles all the rotations needed in order to
 	 * maintain a legal AVL tree.
 	 * This function calls one of the 4 rotation methods.
@@ -154,6 +216,20 @@ private:
 	void fixSizes(Node* node, const T& data, int diff);
 	// A helping function to update the _size of @node.
 	void updateSize(Node* node);
+#ifdef WET2_STATS
+	// helping function to count a find that ended at @node, see stats.h.
+	// O(log n)
+	void countFind(const Node* node) const;
+#endif
+	// helping functions to make a node of @data, from the free list if it is
+	// not empty, and to free a node.
+	Node* newNode(const T& data);
+	void deleteNode(Node* node);
+	// helping functions of insert, remove and replace, to link @node as a
+	// son of @parent (or as the root if @parent is NULL), and to unlink the
+	// node of @data from the tree and return it. O(log n)
+	void link(Node* parent, Node* node);
+	Node* unlink(const T& data);
 	/* Recursive helping function to return the k-th element in the tree.
 	 * Time complexity : O(log n)
 	 */
@@ -183,9 +259,58 @@ private:
 	Node& operator=(const Node& node);
 };
 
+/* The pool of a tree, kept apart from the tree so that the many trees that
+ * have none (e.g. the chains of a HashTable) stay small.
+ */
+template<class T>
+class Tree<T>::Pool {
+public:
+	Node *_nodes;
+	size_t _size;
+	Node *_free; // the free nodes of the pool, linked by their _left
+	size_t _freeSize;
+	Node *_spare; // the nodes made by reserve, linked by their _left
+	size_t _spareSize;
+};
+
 template<class T>
 Tree<T>::Tree() :
-		_root(0), _size(0) {
+		_root(0), _size(0), _pool(0) {
+	STATS(_stats = &ContainerStats::global());
+}
+
+template<class T>
+typename Tree<T>::Node* Tree<T>::newNode(const T& data) {
+	if (!_pool || (!_pool->_free && !_pool->_spare)) {
+		return new Node(data);
+	}
+	Node* node;
+	if (_pool->_free) {
+		node = _pool->_free;
+		_pool->_free = node->_left;
+		--_pool->_freeSize;
+	} else {
+		node = _pool->_spare;
+		_pool->_spare = node->_left;
+		--_pool->_spareSize;
+	}
+	node->_data = data;
+	node->_left = node->_right = node->_parent = NULL;
+	node->_height = node->_balanceFactor = 0;
+	node->_size = 1;
+	return node;
+}
+
+template<class T>
+void Tree<T>::deleteNode(Node* node) {
+	if (_pool && node >= _pool->_nodes
+			&& node < _pool->_nodes + _pool->_size) {
+		node->_left = _pool->_free;
+		_pool->_free = node;
+		++_pool->_freeSize;
+	} else {
+		delete node;
+	}
 }
 
 template<class T>
@@ -196,52 +321,77 @@ void Tree<T>::clear(Node* node) {
 		clear(node->_left);
 	if (node->_right)
 		clear(node->_right);
-	delete node;
+	deleteNode(node);
 	--_size;
 }
 
 template<class T>
 Tree<T>::~Tree() {
 	clear(_root);
+	if (!_pool) {
+		return;
+	}
+	for (size_t i = 0; i < _pool->_size; i++) {
+		_pool->_nodes[i].~Node();
+	}
+	::operator delete(_pool->_nodes);
+	while (_pool->_spare) {
+		Node* node = _pool->_spare;
+		_pool->_spare = node->_left;
+		delete node;
+	}
+	delete _pool;
 }
 
 template<class T>
 void Tree<T>::insert(const T& data) {
+	if (!_root) { // not through find, as throwing TreeIsEmpty is slow
+		_root = newNode(data);
+		++_size;
+		return;
+	}
 	try {
 		Node* parent = find(data);
 		if (parent->_data == data) {
 			throw ElementAlreadyExists();
 		}
-		Node* newNode = new Node(data);
-		++_size;
-		fixSizes(_root, data, +1);
-		newNode->_parent = parent;
-		if (data < parent->_data) {
-			parent->_left = newNode;
-		} else {
-			parent->_right = newNode;
-		}
-		Node* tmpNode = newNode;
-		while (tmpNode != _root) {
-			Node* son = tmpNode;
-			tmpNode = tmpNode->_parent;
-			updateBalanceFactor(tmpNode);
-			if (tmpNode->_height >= son->_height + 1)
-				return;
-			updateHeight(tmpNode);
-			if (abs(tmpNode->_balanceFactor) > 1) {
-				rotate(tmpNode);
-				return;
-			}
-		}
+		link(parent, newNode(data));
 	} catch (TreeIsEmpty& e) {
-		Node* newNode = new Node(data);
-		_root = newNode;
+		_root = newNode(data);
 		++_size;
 	}
 
 }
 
+template<class T>
+void Tree<T>::link(Node* parent, Node* node) {
+	++_size;
+	if (!parent) {
+		_root = node;
+		return;
+	}
+	fixSizes(_root, node->_data, +1);
+	node->_parent = parent;
+	if (node->_data < parent->_data) {
+		parent->_left = node;
+	} else {
+		parent->_right = node;
+	}
+	Node* tmpNode = node;
+	while (tmpNode != _root) {
+		Node* son = tmpNode;
+		tmpNode = tmpNode->_parent;
+		updateBalanceFactor(tmpNode);
+		if (tmpNode->_height >= son->_height + 1)
+			return;
+		updateHeight(tmpNode);
+		if (abs(tmpNode->_balanceFactor) > 1) {
+			rotate(tmpNode);
+			return;
+		}
+	}
+}
+
 template<class T>
 typename Tree<T>::Node* Tree<T>::getMax() const {
 	Node* max = _root;
@@ -259,6 +409,21 @@ inline size_t Tree<T>::size() const {
 	return _size;
 }
 
+template<class T>
+size_t Tree<T>::memory() const {
+	if (!_pool) {
+		return _size * sizeof(Node);
+	}
+	size_t pooled = _pool->_size - _pool->_freeSize; // nodes in use
+	return sizeof(Pool) + (_pool->_size + _size - pooled + _pool->_spareSize)
+			* sizeof(Node);
+}
+
+template<class T>
+inline void Tree<T>::prefetch() const {
+	PREFETCH(_root);
+}
+
 template<class T>
 const T& Tree<T>::select(unsigned int k) const {
 	if (size() == 0 || size() < k) {
@@ -291,6 +456,46 @@ void Tree<T>::swapNodes(Node* node, Node* next) {
 
 template<class T>
 void Tree<T>::remove(const T& data) {
+	deleteNode(unlink(data));
+}
+
+template<class T>
+void Tree<T>::replace(const T& oldData, const T& newData) {
+	Node* node = unlink(oldData);
+	Node* parent = _root ? find(newData) : NULL;
+	bool exists = parent && parent->_data == newData;
+	node->_data = exists ? oldData : newData; // which is put back if exists
+	node->_left = node->_right = node->_parent = NULL;
+	node->_height = node->_balanceFactor = 0;
+	node->_size = 1;
+	if (exists) {
+		link(find(oldData), node);
+		throw ElementAlreadyExists();
+	}
+	link(parent, node);
+}
+
+template<class T>
+void Tree<T>::reserve(int n) {
+	if (!_pool) {
+		_pool = new Pool();
+		_pool->_nodes = NULL;
+		_pool->_size = 0;
+		_pool->_free = NULL;
+		_pool->_freeSize = 0;
+		_pool->_spare = NULL;
+		_pool->_spareSize = 0;
+	}
+	while (_pool->_freeSize + _pool->_spareSize < (size_t) n) {
+		Node* node = new Node(T());
+		node->_left = _pool->_spare;
+		_pool->_spare = node;
+		++_pool->_spareSize;
+	}
+}
+
+template<class T>
+typename Tree<T>::Node* Tree<T>::unlink(const T& data) {
 	Tree<T>::Node *node;
 	node = find(data); // throws if empty
 	if (node->_data != data) {
@@ -314,7 +519,7 @@ void Tree<T>::remove(const T& data) {
 		parent = parent->_parent;
 	}
 	--_size;
-	delete node;
+	return node;
 }
 
 template<class T>
@@ -383,9 +588,33 @@ typename Tree<T>::Node* Tree<T>::find(const T& data) const {
 	if (!_root)
 		throw TreeIsEmpty();
 	Node* node = findAux(_root, data);
+	STATS(countFind(node));
 	return node;
 }
 
+template<class T>
+void Tree<T>::setStats(ContainerStats* stats) {
+#ifdef WET2_STATS
+	_stats = stats;
+#else
+	(void) stats;
+#endif
+}
+
+#ifdef WET2_STATS
+template<class T>
+void Tree<T>::countFind(const Node* node) const {
+	ContainerStats& stats = *_stats;
+	long long depth = 1;
+	for (; node->_parent; node = node->_parent) {
+		++depth;
+	}
+	stats._treeFinds.add(1);
+	stats._treeFindDepth.add(depth);
+	stats._treeMaxFindDepth.raise(depth);
+}
+#endif
+
 template<class T>
 template<class Function>
 void Tree<T>::preOrder(Function& function) const {
@@ -404,6 +633,62 @@ void Tree<T>::inOrder(Function& function) const {
 	subInOrder(_root, function);
 }
 
+template<class T>
+template<class Function>
+void Tree<T>::inOrder(unsigned int first, unsigned int last,
+		Function& function) const {
+	if (first <= last) {
+		subRangeInOrder(_root, 0, first, last, function);
+	}
+}
+
+template<class T>
+template<class Function>
+void Tree<T>::reverseInOrder(unsigned int first, unsigned int last,
+		Function& function) const {
+	if (first <= last) {
+		subRangeReverseInOrder(_root, 0, first, last, function);
+	}
+}
+
+template<class T>
+template<class Function>
+void Tree<T>::subRangeInOrder(Node* node, int offset, int first, int last,
+		Function& function) const {
+	if (!node) {
+		return;
+	}
+	int rank = offset + (node->_left ? node->_left->_size : 0) + 1;
+	if (first < rank) {
+		subRangeInOrder(node->_left, offset, first, last, function);
+	}
+	if (first <= rank && rank <= last) {
+		function(node->_data);
+	}
+	if (rank < last) {
+		subRangeInOrder(node->_right, rank, first, last, function);
+	}
+}
+
+template<class T>
+template<class Function>
+void Tree<T>::subRangeReverseInOrder(Node* node, int offset, int first,
+		int last, Function& function) const {
+	if (!node) {
+		return;
+	}
+	int rank = offset + (node->_left ? node->_left->_size : 0) + 1;
+	if (rank < last) {
+		subRangeReverseInOrder(node->_right, rank, first, last, function);
+	}
+	if (first <= rank && rank <= last) {
+		function(node->_data);
+	}
+	if (first < rank) {
+		subRangeReverseInOrder(node->_left, offset, first, last, function);
+	}
+}
+
 template<class T>
 template<class Function>
 void Tree<T>::subPreOrder(Node* node, Function& function) const {
@@ -508,6 +793,7 @@ void Tree<T>::rotateRL(Node* node) {
 
 template<class T>
 void Tree<T>::rotate(Node* node) {
+	STATS(_stats->_treeRotations.add(1));
 	int left = node->_left ? node->_left->_balanceFactor : 0;
 	int right = node->_right ? node->_right->_balanceFactor : 0;
 	if (node->_balanceFactor == 2) {
@@ -562,30 +848,47 @@ void Tree<T>::fixSizes(Node* node, const T& data, int diff) {
 
 template<class T>
 Tree<T>::Tree(int n) :
-		_root(0), _size(n) {
-	Node** ptrs = new Node*[n];
+		_root(0), _size(n), _pool(0) {
+	STATS(_stats = &ContainerStats::global());
+	if (n == 0) {
+		return;
+	}
+	_pool = new Pool();
+	Node* ptrs;
+	try {
+		ptrs = (Node*) ::operator new(n * sizeof(Node));
+	} catch (std::bad_alloc& e) {
+		delete _pool;
+		throw;
+	}
 	for (int i = 0; i < n; i++) {
-		ptrs[i] = new Node(T());
-		ptrs[i]->_right = ptrs[i]->_left = ptrs[i]->_parent = NULL;
+		new (ptrs + i) Node(T());
 	}
-	_root = ptrs[0];
+	_pool->_nodes = ptrs;
+	_pool->_size = n;
+	_pool->_free = NULL;
+	_pool->_freeSize = 0;
+	_pool->_spare = NULL;
+	_pool->_spareSize = 0;
+	_root = ptrs;
 	_root->_size = n;
 	for (int i = n - 1; i > 0; i--) {
 		// update fields: parent left right height bf size
 		// parent
-		Node* parent = ptrs[(i - 1) / 2];
-		ptrs[i]->_parent = parent;
+		Node* parent = ptrs + (i - 1) / 2;
+		ptrs[i]._parent = parent;
 		// left & right
 		if (i % 2 == 0) {
-			parent->_right = ptrs[i];
+			parent->_right = ptrs + i;
 		} else {
-			parent->_left = ptrs[i];
+			parent->_left = ptrs + i;
 		}
-		updateBalanceFactor(ptrs[i]);
-		updateHeight(ptrs[i]);
-		updateSize(ptrs[i]);
+		updateBalanceFactor(ptrs + i);
+		updateHeight(ptrs + i);
+		updateSize(ptrs + i);
 	}
-	delete[] ptrs;
+	updateBalanceFactor(_root);
+	updateHeight(_root);
 }
 
 template<class T>
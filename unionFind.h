@@ -1,33 +1,57 @@
 #ifndef UNIONFIND_H_
 #define UNIONFIND_H_
 
+#include "dynamicArray.h"
+#include "lazyArray.h"
+#include "stats.h"
+
 /*
  * Class Union Find:
  * This class stores N unique elements and provides the following functionalities:
  * Find(x) : Given an index x, returns the set to which element[i] belongs.
  * get(x) : Given an index x, returns the element[i].
  * Union(x, y): Given two indices, merges the sets to which they belong to 1 set.
+ * Size(x) : Given an index x, returns the number of elements in its set.
+ * Next(x) : Given an index x, returns the following element in its set.
  * This class is implemented using UpTrees (as arrays), Union by size and path compression
  * Therefore, Find and Union takes O(log* n) amortized time.
+ * The nodes are stored in one array, where a node of zero bytes is a
+ * singleton (see Node), so n singletons are created in O(1) and the pages of
+ * the array are only mapped once their nodes are used (see lazyArray.h).
+ * In addition, the elements of every set are linked in a circular list, which
+ * Union splices in O(1), so a whole set can be visited in O(set size).
+ * Add() : Adds a new element as a singleton set, the array of the elements
+ * grows by doubling so Add takes O(1) amortized time.
+ * Relabel(newIndex) : Moves every element x to index newIndex[x].
+ * Restore(parents, next) : Replaces the sets by the given ones.
+ * Checkpoint() / Rollback() / Commit() : Unions made after a checkpoint are
+ * recorded in an undo stack and can be undone in O(1) each. Path compression
+ * is not performed while a checkpoint is open (so that every Union can be
+ * undone), thus Find takes O(log n) during that time thanks to union by size.
  */
 
 template<class T>
 class UnionFind {
 public:
-	/* Initializes a UnionFind class with size n using T(i).
-	 * Time Complexity: O(n).
+	/* Initializes a UnionFind class of n singletons without data.
+	 * Time Complexity: O(1).
 	 */
 	explicit UnionFind(int n);
 	/* Initializes a UnionFind class with the array data and size n
 	 * Time Complexity: O(n).
 	 */
 	UnionFind(int n, T* data);
-	/* Recursive function that returns the index of the UpTree root
-	 * to which element[x] belongs.
+	/* Returns the index of the UpTree root to which element[x] belongs, and
+	 * links the elements on the way directly to the root.
 	 * @throw IndexOutOfBounds
 	 * Time Complexity: O(log n)
 	 */
 	int Find(int x);
+	/* Makes Find count its work in @stats rather than in the counters of
+	 * the process (see stats.h). It does nothing without WET2_STATS.
+	 * Time Complexity: O(1).
+	 */
+	void setStats(ContainerStats* stats);
 	/* Given two roots, merges the sets of given roots.
 	 * Using UpTrees and union by size.
 	 * @throw IllegalUnion
@@ -35,8 +59,67 @@ public:
 	 * Time Complexity: O(1)
 	 */
 	void Union(int x, int y);
+	/* Returns the number of elements in the set to which element[x] belongs.
+	 * @throw IndexOutOfBounds
+	 * Time Complexity: O(log* n) amortized.
+	 */
+	int Size(int x);
+	/* Returns the index of the element following element[x] in the circular
+	 * list of its set. Calling Next repeatedly starting from x visits every
+	 * element of the set exactly once before returning to x.
+	 * @throw IndexOutOfBounds
+	 * Time Complexity: O(1)
+	 */
+	int Next(int x) const;
+	/* Adds a new element n without data in a set of its own, and returns its
+	 * index. The addition is not undone by Rollback.
+	 * Time Complexity: O(1) amortized.
+	 */
+	int Add();
+	/* Opens a new checkpoint. Checkpoints may be nested.
+	 * Time Complexity: O(1) amortized.
+	 */
+	void Checkpoint();
+	/* Undoes all the unions made since the last open checkpoint and closes it.
+	 * It allocates nothing, so it cannot fail on memory.
+	 * @throw NoCheckpoint
+	 * Time Complexity: O(k) whereas k is the number of undone unions.
+	 */
+	void Rollback();
+	/* Closes the last open checkpoint while keeping its unions.
+	 * @throw NoCheckpoint
+	 * Time Complexity: O(1) amortized.
+	 */
+	void Commit();
+	/* Returns true if there is an open checkpoint.
+	 * Time Complexity: O(1)
+	 */
+	bool InCheckpoint() const;
+	/* Returns the number of bytes allocated by the UnionFind, not counting
+	 * the UnionFind object itself. The nodes after the n-th take no memory
+	 * until they are used (see lazyArray.h), so this is an upper bound.
+	 * Time Complexity: O(1)
+	 */
+	size_t memory() const;
+	/* Moves every element x to index newIndex[x], where newIndex is a
+	 * permutation of 0..n-1. The sets, their sizes and the order of their
+	 * circular lists are kept, and every element becomes a direct son of its
+	 * root (i.e. the paths are fully compressed).
+	 * @throw IllegalRelabel if there is an open checkpoint.
+	 * Time Complexity: O(n) amortized.
+	 */
+	void Relabel(const int* newIndex);
+	/* Replaces the sets by the sets given by parents and next: element x
+	 * becomes a root if parents[x] is x, or a son of parents[x] otherwise, and
+	 * next[x] follows it in the circular list of its set. The arrays must
+	 * describe valid sets (every parents[x] is a root, and next is a circular
+	 * list of each set).
+	 * @throw IllegalRelabel if there is an open checkpoint.
+	 * Time Complexity: O(n).
+	 */
+	void Restore(const int* parents, const int* next);
 	/* class Destructor
-	 * Time complexity: O(n)
+	 * Time complexity: O(1)
 	 */
 	~UnionFind();
 
@@ -46,47 +129,74 @@ public:
 	};
 	class IllegalUnion: public std::exception {
 	};
+	class NoCheckpoint: public std::exception {
+	};
+	class IllegalRelabel: public std::exception {
+	};
 private:
 
 	int n;			// number of Nodes (elements)
-	Node** elements;	// array of nodes
+	int capacity;	// size of the array of nodes
+	Node* elements;	// array of nodes, the nodes after the n-th are zero
+	DynamicArray<int> undo;			// children linked since the first checkpoint
+	DynamicArray<int> undoSizes;	// sizes of these children before linking
+	DynamicArray<int> checkpoints;	// undo stack size at each open checkpoint
+#ifdef WET2_STATS
+	ContainerStats* stats;			// see setStats
+#endif
+
+	UnionFind(const UnionFind& unionFind);
+	UnionFind& operator=(const UnionFind& unionFind);
+	// helping functions to read and write the fields of the node of element
+	// x (see Node). A root is its own parent. O(1)
+	int parentOf(int x) const {
+		return elements[x].parent ^ x;
+	}
+	void setParent(int x, int parent) {
+		elements[x].parent = parent ^ x;
+	}
+	int nextOf(int x) const {
+		return elements[x].next ^ x;
+	}
+	void setNext(int x, int next) {
+		elements[x].next = next ^ x;
+	}
+	int sizeOf(int x) const {
+		return elements[x].size + 1;
+	}
+	void setSize(int x, int size) {
+		elements[x].size = size - 1;
+	}
 };
 
 /* Class Node
- * Implements a Node in the UpTree containing the data of each Node,
- * the parent of the Node (-1 if Node is a root)
- * and the size of the UpTree if Node is a root (-1 otherwise).
+ * Implements a Node in the UpTree containing the data of each Node (or NULL),
+ * the parent of the Node, the size of the UpTree if Node is a root and the
+ * next Node of the same set in the set's circular list.
+ * The fields are stored relative to the index x of the Node, so that a Node
+ * of zero bytes is the root of the singleton {x}.
  */
 template<class T>
 class UnionFind<T>::Node {
-public:
-	Node(int size, int parent, T& data) :
-			size(size), parent(parent), data(data) {
-	}
-	Node(const Node& n) :
-			size(n.size), parent(n.parent), data(n.data) {
-	}
 	friend class UnionFind;
-private:
-	int size;	// size of the Node, -1 if not root.
-	int parent;	// parent of the Node, -1 if current node is a parent.
-	T& data;
+	int size;	// size - 1 of the UpTree if the Node is a root.
+	int parent;	// parent ^ x, 0 if the Node is a root.
+	int next;	// next ^ x, for the next Node in the circular list of the set.
+	T* data;
 };
 
 template<class T>
 UnionFind<T>::UnionFind(int n) :
-		n(n), elements(new Node*[n]) {
-	for (int i = 0; i < n; i++) {
-		T t(i);
-		elements[i] = new Node(1, -1, t);
-	}
+		n(n), capacity(n), elements(newLazyArray<Node>(n)) {
+	STATS(stats = &ContainerStats::global());
 }
 
 template<class T>
 UnionFind<T>::UnionFind(int n, T* data) :
-		n(n), elements(new Node*[n]) {
+		n(n), capacity(n), elements(newLazyArray<Node>(n)) {
+	STATS(stats = &ContainerStats::global());
 	for (int i = 0; i < n; i++) {
-		elements[i] = new Node(1, -1, data[i]);
+		elements[i].data = data + i;
 	}
 }
 
@@ -95,11 +205,35 @@ int UnionFind<T>::Find(int x) {
 	if (x < 0 || x >= n) {
 		throw IndexOutOfBounds();
 	}
-	if (elements[x]->parent == -1) {
-		return x;
-	} else {
-		return elements[x]->parent = Find(elements[x]->parent);
+	int root = x;
+	STATS(long long length = 0);
+	while (parentOf(root) != root) {
+		root = parentOf(root);
+		STATS(++length);
+	}
+#ifdef WET2_STATS
+	stats->_unionFinds.add(1);
+	stats->_unionFindPathLength.add(length);
+	stats->_unionFindMaxPathLength.raise(length);
+#endif
+	if (checkpoints.size() > 0) { // no path compression, see Checkpoint()
+		return root;
+	}
+	while (x != root) {
+		int parent = parentOf(x);
+		setParent(x, root);
+		x = parent;
 	}
+	return root;
+}
+
+template<class T>
+void UnionFind<T>::setStats(ContainerStats* stats) {
+#ifdef WET2_STATS
+	this->stats = stats;
+#else
+	(void) stats;
+#endif
 }
 
 template<class T>
@@ -107,29 +241,146 @@ void UnionFind<T>::Union(int x, int y) {
 	if (x < 0 || x >= n || y < 0 || y >= n) {
 		throw IndexOutOfBounds();
 	}
-	if (elements[x]->parent != -1 || elements[x]->parent != -1) {
+	if (parentOf(x) != x || parentOf(y) != y) {
 		throw IllegalUnion();
 	}
 	if (x == y) { // x,y in same set
 		return;
 	}
-	if (elements[x]->size > elements[y]->size) {
-		elements[x]->size += elements[y]->size;
-		elements[y]->size = -1;
-		elements[y]->parent = x;
-	} else {
-		elements[y]->size += elements[x]->size;
-		elements[x]->size = -1;
-		elements[x]->parent = y;
+	// the undo records are made first, so a failed allocation changes nothing
+	if (checkpoints.size() > 0) {
+		undo.reserve(undo.size() + 1);
+		undoSizes.reserve(undoSizes.size() + 1);
 	}
+	// splice the two circular lists into one
+	int next = nextOf(x);
+	setNext(x, nextOf(y));
+	setNext(y, next);
+	int child = sizeOf(x) > sizeOf(y) ? y : x;
+	int root = child == x ? y : x;
+	if (checkpoints.size() > 0) {
+		undo.pushBack(child);
+		undoSizes.pushBack(sizeOf(child));
+	}
+	setSize(root, sizeOf(root) + sizeOf(child));
+	setParent(child, root);
 }
 
 template<class T>
-UnionFind<T>::~UnionFind() {
+int UnionFind<T>::Size(int x) {
+	return sizeOf(Find(x));
+}
+
+template<class T>
+int UnionFind<T>::Next(int x) const {
+	if (x < 0 || x >= n) {
+		throw IndexOutOfBounds();
+	}
+	return nextOf(x);
+}
+
+template<class T>
+int UnionFind<T>::Add() {
+	if (n == capacity) {
+		int newCapacity = capacity ? capacity * 2 : 1;
+		Node* newElements = newLazyArray<Node>(newCapacity);
+		for (int i = 0; i < n; i++) {
+			newElements[i] = elements[i];
+		}
+		deleteLazyArray(elements);
+		elements = newElements;
+		capacity = newCapacity;
+	}
+	return n++; // its node is zero, a singleton
+}
+
+template<class T>
+void UnionFind<T>::Checkpoint() {
+	checkpoints.pushBack(undo.size());
+}
+
+template<class T>
+void UnionFind<T>::Rollback() {
+	if (checkpoints.size() == 0) {
+		throw NoCheckpoint();
+	}
+	int mark = checkpoints.back();
+	while (undo.size() > mark) {
+		int child = undo.back();
+		int root = parentOf(child);
+		setSize(child, undoSizes.back());
+		setParent(child, child);
+		setSize(root, sizeOf(root) - sizeOf(child));
+		// swapping the successors again splits the circular lists back
+		int next = nextOf(root);
+		setNext(root, nextOf(child));
+		setNext(child, next);
+		undo.popBack(false);
+		undoSizes.popBack(false);
+	}
+	checkpoints.popBack(false);
+}
+
+template<class T>
+void UnionFind<T>::Commit() {
+	if (checkpoints.size() == 0) {
+		throw NoCheckpoint();
+	}
+	checkpoints.popBack();
+	if (checkpoints.size() == 0) {
+		undo.clear();
+		undoSizes.clear();
+	}
+}
+
+template<class T>
+bool UnionFind<T>::InCheckpoint() const {
+	return checkpoints.size() > 0;
+}
+
+template<class T>
+size_t UnionFind<T>::memory() const {
+	return capacity * sizeof(Node) + undo.memory() + undoSizes.memory()
+			+ checkpoints.memory();
+}
+
+template<class T>
+void UnionFind<T>::Relabel(const int* newIndex) {
+	if (checkpoints.size() > 0) {
+		throw IllegalRelabel();
+	}
+	for (int i = 0; i < n; i++) {
+		Find(i);
+	}
+	Node* newElements = newLazyArray<Node>(capacity);
+	for (int i = 0; i < n; i++) {
+		int j = newIndex[i];
+		newElements[j] = elements[i];
+		newElements[j].parent = newIndex[parentOf(i)] ^ j;
+		newElements[j].next = newIndex[nextOf(i)] ^ j;
+	}
+	deleteLazyArray(elements);
+	elements = newElements;
+}
+
+template<class T>
+void UnionFind<T>::Restore(const int* parents, const int* next) {
+	if (checkpoints.size() > 0) {
+		throw IllegalRelabel();
+	}
 	for (int i = 0; i < n; i++) {
-		delete elements[i];
+		setSize(i, 0);
+		setParent(i, parents[i]);
+		setNext(i, next[i]);
 	}
-	delete[] elements;
+	for (int i = 0; i < n; i++) {
+		elements[parents[i]].size++;
+	}
+}
+
+template<class T>
+UnionFind<T>::~UnionFind() {
+	deleteLazyArray(elements);
 }
 
 #endif /* UNIONFIND_H_ */
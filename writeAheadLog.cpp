@@ -0,0 +1,307 @@
+#include "writeAheadLog.h"
+#include <new>		// std::bad_alloc
+#include <cstring>	// memcmp, memcpy, memset
+#include <system_error>	// std::system_error
+#ifdef _WIN32
+#include <io.h>		// _chsize_s, _commit
+#else
+#include <unistd.h>	// ftruncate, fsync
+#endif
+
+const char WriteAheadLog::MAGIC[8] = { 'W', 'E', 'T', '2', 'L', 'O', 'G', 0 };
+
+WriteAheadLog::WriteAheadLog(const char* path, long long lsn, int groupSize,
+		int groupMilliseconds) :
+		_file(NULL), _length(0), _lsn(lsn), _group(NULL), _groupCapacity(
+				groupSize > 1 ? groupSize : 1), _buffered(0), _groupSize(
+				_groupCapacity), _groupTime(
+				std::chrono::milliseconds(
+						groupMilliseconds > 0 ? groupMilliseconds : 0)), _stopping(
+				false) {
+	long long length = 0;
+	FILE* existing = fopen(path, "rb");
+	if (existing) {
+		fclose(existing);
+		Reader reader(path);
+		Record record;
+		long long recordLsn;
+		while (reader.next(record, recordLsn)) {
+		}
+		if (reader.lastLsn() != -1 && reader.lastLsn() != lsn) {
+			throw BadLog();
+		}
+		length = reader.length();
+	}
+	if (length == 0) { // a new log
+		Header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header._magic, MAGIC, sizeof(MAGIC));
+		header._format = FORMAT;
+		header._intSize = sizeof(int);
+		header._byteOrder = INT_ORDER;
+		_file = fopen(path, "wb");
+		if (!_file) {
+			throw IOError();
+		}
+		if (fwrite(&header, sizeof(header), 1, _file) != 1
+				|| fflush(_file) != 0 || !synchronize(_file)) {
+			fclose(_file);
+			throw IOError();
+		}
+		length = sizeof(header);
+	} else { // cuts off a frame that was not completely written
+		_file = fopen(path, "r+b");
+		if (!_file) {
+			throw IOError();
+		}
+		if (!truncate(_file, length) || fseek(_file, 0, SEEK_END) != 0) {
+			fclose(_file);
+			throw IOError();
+		}
+	}
+	_length = length;
+	try {
+		_group = new Record[_groupCapacity];
+	} catch (std::bad_alloc& e) {
+		fclose(_file);
+		throw;
+	}
+	if (_groupTime.count() > 0) {
+		try {
+			_timer = std::thread(&WriteAheadLog::watchGroup, this);
+		} catch (std::system_error& e) {
+			delete[] _group;
+			fclose(_file);
+			throw IOError();
+		}
+	}
+}
+
+WriteAheadLog::~WriteAheadLog() {
+	if (_timer.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopping = true;
+		}
+		_wake.notify_one();
+		_timer.join();
+	}
+	try {
+		flush();
+	} catch (IOError& e) {
+	}
+	fclose(_file);
+	delete[] _group;
+}
+
+unsigned int WriteAheadLog::checksum(long long firstLsn, int count,
+		const Record* records) {
+	unsigned int hash = 2166136261u; // FNV-1a
+	const unsigned char* bytes = (const unsigned char*) &firstLsn;
+	for (size_t i = 0; i < sizeof(firstLsn); ++i) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	bytes = (const unsigned char*) &count;
+	for (size_t i = 0; i < sizeof(count); ++i) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	bytes = (const unsigned char*) records;
+	for (size_t i = 0; i < count * sizeof(Record); ++i) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+bool WriteAheadLog::truncate(FILE* file, long long length) {
+	if (fflush(file) != 0) {
+		return false;
+	}
+#ifdef _WIN32
+	return _chsize_s(_fileno(file), length) == 0;
+#else
+	return ftruncate(fileno(file), length) == 0;
+#endif
+}
+
+bool WriteAheadLog::synchronize(FILE* file) {
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+void WriteAheadLog::append(RecordType type, long long first, int second) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (_buffered == _groupCapacity) { // no room was made after the last one
+		try {
+			flushGroup();
+		} catch (IOError& e) {
+			reserve();
+		}
+	}
+	if (_buffered == 0 && _groupTime.count() > 0) {
+		_groupStart = std::chrono::steady_clock::now();
+		_wake.notify_one();
+	}
+	Record& record = _group[_buffered++];
+	record._type = type;
+	record._first = first;
+	record._second = second;
+	++_lsn;
+	bool failed = false;
+	if (_buffered >= _groupSize
+			|| (_groupTime.count() > 0
+					&& std::chrono::steady_clock::now() - _groupStart
+							>= _groupTime)) {
+		try {
+			flushGroup();
+		} catch (IOError& e) {
+			failed = true;
+		}
+	}
+	if (_buffered == _groupCapacity) { // the flush failed
+		try {
+			reserve();
+		} catch (std::bad_alloc& e) { // tried again by the next append
+		}
+	}
+	if (failed) {
+		throw IOError();
+	}
+}
+
+void WriteAheadLog::reserve() {
+	Record* group = new Record[2 * _groupCapacity];
+	memcpy(group, _group, _buffered * sizeof(Record));
+	delete[] _group;
+	_group = group;
+	_groupCapacity *= 2;
+}
+
+void WriteAheadLog::watchGroup() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_stopping) {
+		if (_buffered == 0) {
+			_wake.wait(lock);
+			continue;
+		}
+		std::chrono::steady_clock::time_point deadline = _groupStart
+				+ _groupTime;
+		if (std::chrono::steady_clock::now() < deadline) {
+			_wake.wait_until(lock, deadline);
+			continue;
+		}
+		try {
+			flushGroup();
+		} catch (IOError& e) { // tried again after another period
+			_groupStart = std::chrono::steady_clock::now();
+		}
+	}
+}
+
+void WriteAheadLog::flush() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	flushGroup();
+}
+
+void WriteAheadLog::flushGroup() {
+	if (_buffered == 0) {
+		return;
+	}
+	Frame frame;
+	frame._firstLsn = _lsn - _buffered + 1;
+	frame._count = _buffered;
+	frame._checksum = checksum(frame._firstLsn, frame._count, _group);
+	if (fwrite(&frame, sizeof(frame), 1, _file) != 1
+			|| fwrite(_group, sizeof(Record), _buffered, _file)
+					!= (size_t) _buffered || fflush(_file) != 0
+			|| !synchronize(_file)) {
+		// cuts off what was written of the frame, which is written again
+		clearerr(_file);
+		if (truncate(_file, _length)) {
+			fseek(_file, 0, SEEK_END);
+		}
+		throw IOError();
+	}
+	_length += sizeof(frame) + _buffered * sizeof(Record);
+	_buffered = 0;
+}
+
+long long WriteAheadLog::lsn() const {
+	return _lsn; // changed only by append, on the thread of the updates
+}
+
+WriteAheadLog::Reader::Reader(const char* path) :
+		_file(fopen(path, "rb")), _frame(NULL), _capacity(0), _count(0), _index(
+				0), _firstLsn(-1), _length(0), _lastLsn(-1), _ended(false) {
+	if (!_file) {
+		throw IOError();
+	}
+	Header header;
+	if (fread(&header, sizeof(header), 1, _file) != 1) {
+		_ended = true; // a log whose header was not written is empty
+		return;
+	}
+	if (memcmp(header._magic, MAGIC, sizeof(MAGIC)) != 0
+			|| header._format != FORMAT
+			|| header._intSize != (int) sizeof(int)
+			|| header._byteOrder != INT_ORDER) {
+		fclose(_file);
+		throw BadLog();
+	}
+	_length = sizeof(header);
+}
+
+WriteAheadLog::Reader::~Reader() {
+	fclose(_file);
+	delete[] _frame;
+}
+
+bool WriteAheadLog::Reader::readFrame() {
+	Frame frame;
+	if (fread(&frame, sizeof(frame), 1, _file) != 1 || frame._count < 1
+			|| frame._count > MAX_FRAME
+			|| (_lastLsn != -1 && frame._firstLsn != _lastLsn + 1)) {
+		return false;
+	}
+	if (frame._count > _capacity) {
+		Record* records = new Record[frame._count];
+		delete[] _frame;
+		_frame = records;
+		_capacity = frame._count;
+	}
+	if (fread(_frame, sizeof(Record), frame._count, _file)
+			!= (size_t) frame._count
+			|| checksum(frame._firstLsn, frame._count, _frame)
+					!= frame._checksum) {
+		return false;
+	}
+	_length += sizeof(frame) + frame._count * sizeof(Record);
+	_firstLsn = frame._firstLsn;
+	_lastLsn = frame._firstLsn + frame._count - 1;
+	_count = frame._count;
+	_index = 0;
+	return true;
+}
+
+bool WriteAheadLog::Reader::next(Record& record, long long& lsn) {
+	if (_index == _count) {
+		if (_ended || !readFrame()) {
+			_ended = true;
+			return false;
+		}
+	}
+	record = _frame[_index];
+	lsn = _firstLsn + _index;
+	++_index;
+	return true;
+}
+
+long long WriteAheadLog::Reader::length() const {
+	return _length;
+}
+
+long long WriteAheadLog::Reader::lastLsn() const {
+	return _lastLsn;
+}
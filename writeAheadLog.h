@@ -0,0 +1,197 @@
+#ifndef WRITEAHEADLOG_H_
+#define WRITEAHEADLOG_H_
+
+#include <stdio.h>		// FILE
+#include <exception>	// std::exception
+#include <chrono>		// std::chrono::steady_clock
+#include <mutex>		// std::mutex
+#include <condition_variable>	// std::condition_variable
+#include <thread>		// std::thread
+
+/*
+ * Class Write Ahead Log
+ * A log of the updates of the Planet (see StartLog in library2.h), so that
+ * the Planet can be recovered from a snapshot by replaying the updates made
+ * after it. Every update gets a log sequence number (LSN), which is the
+ * number of updates since the Planet was initialized.
+ *
+ * The log is a header followed by frames, each frame a group of records of
+ * consecutive LSNs:
+ * { long long firstLsn; int count; unsigned int checksum; } Record[count]
+ * A record takes 16 bytes. The records are added to a group in memory, and
+ * the group is written and flushed to the disk (fsync) as one frame once it
+ * holds @groupSize records or its first record is @groupMilliseconds old,
+ * so the cost of the fsync is shared by the whole group. The age of the group
+ * is watched by a thread of the log, which flushes the group on time even if
+ * no record follows. The records of the last group are lost in a crash.
+ * There is always room in the group for the next record, which is made
+ * after every record (see append), so a record never takes its LSN without
+ * being kept.
+ * The checksum finds a frame that was partly written in a crash, which ends
+ * the log and is cut off when the log is opened again.
+ */
+class WriteAheadLog {
+public:
+	/* Exceptions thrown by the log */
+	class IOError: public std::exception {
+	};
+	class BadLog: public std::exception {
+	};
+
+	enum RecordType {
+		ADD_CITY,
+		ADD_CITIZEN,
+		MOVE_TO_CITY,
+		REMOVE_CITIZEN,
+		RELOCATE_CITIZEN,
+		JOIN_KINGDOMS,
+		RECORD_TYPES
+	};
+
+	/* A record of an update and its two arguments (0 if unused). The first
+	 * argument is a citizen ID for the updates of citizens, so it takes 64
+	 * bits, and it comes last to leave no padding in the record.
+	 */
+	struct Record {
+		int _type;
+		int _second;
+		long long _first;
+	};
+
+	class Reader;
+
+	/* Opens the log at @path for appending the records after @lsn, or
+	 * creates it if it does not exist.
+	 * @throw IOError
+	 * @throw BadLog if the file is not a log, or its last record is not @lsn.
+	 * Time complexity : O(1), or O(l) to read an existing log of length l.
+	 */
+	WriteAheadLog(const char* path, long long lsn, int groupSize,
+			int groupMilliseconds);
+	/* Destructor : flushes the records and closes the log. Records that
+	 * cannot be written are lost.
+	 * Time complexity : O(groupSize)
+	 */
+	~WriteAheadLog();
+	/* Adds the record of the update after the last one, which flushes the
+	 * group if it is full or old enough, and then makes room for the next
+	 * record.
+	 * @throw IOError if the group cannot be flushed. The record is kept, and
+	 * the group is written again by the next flush.
+	 * @throw std::bad_alloc if there is no room for the record, since the
+	 * room could not be made after the previous record either. The record
+	 * is not added and the LSN is not changed.
+	 * Time complexity : O(1) amortized, plus the time of the disk.
+	 */
+	void append(RecordType type, long long first, int second);
+	/* Writes the group to the disk.
+	 * @throw IOError
+	 * Time complexity : O(groupSize) plus the time of the disk.
+	 */
+	void flush();
+	/* Returns the LSN of the last record.
+	 * Time complexity : O(1)
+	 */
+	long long lsn() const;
+
+private:
+	/* The header of the file, see Snapshot. */
+	struct Header {
+		char _magic[8];
+		int _format;
+		int _intSize;
+		int _byteOrder;
+		int _reserved;
+	};
+	/* The header of a frame. */
+	struct Frame {
+		long long _firstLsn;
+		int _count;
+		unsigned int _checksum;
+	};
+
+	static const char MAGIC[8];
+	static const int FORMAT = 2;
+	static const int INT_ORDER = 0x01020304;
+	static const int MAX_FRAME = 1 << 24;	// records in a frame at most
+
+	FILE* _file;
+	long long _length;		// the length of the frames written to the file
+	long long _lsn;
+	Record* _group;
+	int _groupCapacity;
+	int _buffered;			// records in the group
+	int _groupSize;
+	std::chrono::steady_clock::duration _groupTime;
+	std::chrono::steady_clock::time_point _groupStart;
+	std::mutex _mutex;		// held by append, flush and the timer
+	std::condition_variable _wake;	// wakes the timer
+	std::thread _timer;		// flushes old groups, if there is a time limit
+	bool _stopping;
+
+	WriteAheadLog(const WriteAheadLog& log);
+	WriteAheadLog& operator=(const WriteAheadLog& log);
+	// helping function to return the checksum of a frame. O(count)
+	static unsigned int checksum(long long firstLsn, int count,
+			const Record* records);
+	// helping functions to cut the file at @length, and to flush it to the
+	// disk. Return false on failure. O(1) plus the time of the disk.
+	static bool truncate(FILE* file, long long length);
+	static bool synchronize(FILE* file);
+	// helping functions of append and flush, called with _mutex held: to
+	// double the group, which makes room for the next record after a failed
+	// flush, and to write the group. O(groupSize) plus the time of the disk.
+	void reserve();
+	void flushGroup();
+	// helping function of the timer thread, which flushes the group once
+	// its first record is @_groupTime old, until the log is destroyed.
+	void watchGroup();
+};
+
+/*
+ * Class Write Ahead Log Reader
+ * Reads the records of a log in order, until its end or a frame that was
+ * not written completely.
+ */
+class WriteAheadLog::Reader {
+public:
+	/* Opens the log at @path.
+	 * @throw IOError
+	 * @throw BadLog if the file is not a log.
+	 * Time complexity : O(1)
+	 */
+	explicit Reader(const char* path);
+	/* Destructor : closes the log
+	 * Time complexity : O(1)
+	 */
+	~Reader();
+	/* Reads the next record and its LSN. Returns false at the end of the
+	 * log.
+	 * Time complexity : O(1) amortized
+	 */
+	bool next(Record& record, long long& lsn);
+	/* Returns the length of the log up to the end of the last complete frame
+	 * that was read, and its last LSN (or -1 if no frame was read).
+	 * Time complexity : O(1)
+	 */
+	long long length() const;
+	long long lastLsn() const;
+
+private:
+	FILE* _file;
+	Record* _frame;
+	int _capacity;
+	int _count;
+	int _index;
+	long long _firstLsn;
+	long long _length;
+	long long _lastLsn;
+	bool _ended;	// whether a frame was missing or incomplete
+
+	Reader(const Reader& reader);
+	Reader& operator=(const Reader& reader);
+	// helping function to read the next complete frame. O(count)
+	bool readFrame();
+};
+
+#endif /* WRITEAHEADLOG_H_ */